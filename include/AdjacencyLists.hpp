@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+// Items of every owner in one shared buffer, each owner holds a slot with room to spare
+// Adding to a full slot moves it to the end of the buffer with twice the room, so edits stay local and the
+// buffer grows with amortized capacity. Slots left behind are reclaimed by the next build.
+class AdjacencyLists
+{
+  public:
+    // ForEach: void(Emit), Emit: void(int owner, int item), called twice to count and to fill
+    template <typename ForEach> void build(int ownerCount, ForEach &&forEach)
+    {
+        start.assign(ownerCount, 0);
+        size.assign(ownerCount, 0);
+        room.assign(ownerCount, 0);
+        forEach([&](int owner, int) { room[owner]++; });
+
+        int total = 0;
+        for (int owner = 0; owner < ownerCount; owner++)
+        {
+            room[owner] += SLACK;
+            start[owner] = total;
+            total += room[owner];
+        }
+
+        items.assign(total, -1);
+        forEach([&](int owner, int item) { items[start[owner] + size[owner]++] = item; });
+    }
+    void clear();
+
+    int ownerCount() const
+    {
+        return static_cast<int>(start.size());
+    }
+    // New owner with an empty slot, returns its index
+    int addOwner();
+    void add(int owner, int item);
+    // Swaps the last item of the owner into the gap, the order of the others is not kept
+    void remove(int owner, int item);
+    void replace(int owner, int from, int to);
+    bool contains(int owner, int item) const;
+
+    const int *begin(int owner) const
+    {
+        return items.data() + start[owner];
+    }
+    const int *end(int owner) const
+    {
+        return items.data() + start[owner] + size[owner];
+    }
+    int count(int owner) const
+    {
+        return size[owner];
+    }
+
+  private:
+    static constexpr int SLACK = 2;
+
+    std::vector<int> start;
+    std::vector<int> size;
+    std::vector<int> room;
+    std::vector<int> items;
+};
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <deque>
 #include <glm/glm.hpp>
+#include <memory_resource>
 #include <string>
 #include <vector>
 
@@ -54,6 +55,7 @@ class ClothAnalysis
     void update(float deltaTime, float simulationTime);
     void recordMassPointData(int massIndex, const Mass &mass, const std::vector<Spring> &springs, float simulationTime);
     void recordSpringBreak(int springIndex, const glm::vec3 &position, float tension, float simulationTime);
+    void recordSpringBreaks(const std::vector<SpringBreakEvent> &events);
 
     float calculateKineticEnergy(const Mass &mass) const;
     float calculateAverageSpringTension(int massIndex, const std::vector<Mass> &masses,
@@ -61,9 +63,14 @@ class ClothAnalysis
     glm::vec3 calculateVelocity(const Mass &mass) const;
 
     void updateGlobalStats(const std::vector<Mass> &masses, const std::vector<Spring> &springs, float simulationTime);
+    // Tension measured outside of the spring list (structured grid)
+    void setTensionStats(float average, float max);
+    // Constraint violation after every solver iteration of the last step
+    void clearResidualCurve();
+    void recordResidual(float maxViolation, float rmsViolation);
 
     // Get history
-    const std::deque<MassPointData> &getHistoryData() const
+    const std::pmr::deque<MassPointData> &getHistoryData() const
     {
         return historyData;
     }
@@ -71,6 +78,14 @@ class ClothAnalysis
     {
         return breakEvents;
     }
+    const std::vector<float> &getResidualMax() const
+    {
+        return residualMax;
+    }
+    const std::vector<float> &getResidualRms() const
+    {
+        return residualRms;
+    }
 
     // Get stats
     float getTotalEnergy() const
@@ -116,9 +131,13 @@ class ClothAnalysis
     std::string exportToCSV() const;
 
   private:
-    // Record data
-    std::deque<MassPointData> historyData;
+    // Record data, the pool reuses the blocks the deque drops so a full history stops allocating
+    std::pmr::unsynchronized_pool_resource historyPool;
+    std::pmr::deque<MassPointData> historyData{&historyPool};
     std::vector<SpringBreakEvent> breakEvents;
+    // One entry per solver iteration, capacity is kept between steps
+    std::vector<float> residualMax;
+    std::vector<float> residualRms;
     std::chrono::steady_clock::time_point startTime;
 
     // Current stats
@@ -156,16 +175,17 @@ struct AnalysisDisplayData
     int brokenSprings;
     int connectedSprings;
 
-    // History for graphs
-    std::vector<float> timeHistory;
-    std::vector<float> energyHistory;
-    std::vector<float> tensionHistory;
-    std::vector<float> velocityHistory;
+    // History for graphs, allocated from the caller's frame memory
+    std::pmr::vector<float> timeHistory;
+    std::pmr::vector<float> energyHistory;
+    std::pmr::vector<float> tensionHistory;
+    std::pmr::vector<float> velocityHistory;
 
-    AnalysisDisplayData()
+    explicit AnalysisDisplayData(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
         : selectedMassIndex(-1), position(0.0f), velocity(0.0f), speed(0.0f), acceleration(0.0f), kineticEnergy(0.0f),
           connectedSprings(0), averageTension(0.0f), totalEnergy(0.0f), averageSystemTension(0.0f), totalSprings(0),
-          brokenSprings(0), maxTension(0.0f)
+          brokenSprings(0), maxTension(0.0f), timeHistory(memory), energyHistory(memory), tensionHistory(memory),
+          velocityHistory(memory)
     {
     }
 };
\ No newline at end of file
@@ -8,6 +8,7 @@ class Skybox;
 class ClothGUI;
 class Camera;
 class Cube;
+class InputJournal;
 
 struct AppData
 {
@@ -22,6 +23,9 @@ struct AppData
     Cube *cube;
     bool *cubeEnabled;
 
+    // Records actions for a later replay, does nothing unless recording
+    InputJournal *journal;
+
     // Performance metrics
     double fps;
 };
\ No newline at end of file
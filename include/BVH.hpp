@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "AABB.hpp"
+#include "Ray.hpp"
+
+// Bounding volume hierarchy over a set of primitive boxes
+class BVH
+{
+  public:
+    struct Node
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+        // Leaf: first slot in primIndices, inner: index of the left child (right = left + 1)
+        int start;
+        // Leaf: number of primitives, inner: -1
+        int count;
+    };
+
+    // Build tree from scratch, needed after topology changes
+    void build(const std::vector<AABB> &bounds);
+    // Update node bounds for moved primitives, keeps tree structure
+    void refit(const std::vector<AABB> &bounds);
+    // Drop primitives in the order given, each removal renames the last id to the removed one like a swap
+    // with the back of the primitive array, bounds are stale until the next refit
+    void removePrimitives(const int *removed, std::size_t count);
+    void clear();
+
+    bool empty() const
+    {
+        return nodes.empty();
+    }
+    int primitiveCount() const
+    {
+        return livePrimitives;
+    }
+
+    // Visit primitives whose box is hit by the ray before tMax
+    // Visitor: void(int primitive, float &tMax), may shrink tMax for nearest hit search
+    template <typename Visitor> void intersectRay(const Ray &ray, float &tMax, Visitor &&visit) const
+    {
+        if (nodes.empty())
+            return;
+
+        const glm::vec3 origin = ray.Origin();
+        const glm::vec3 invDir = 1.0f / ray.Direction();
+
+        int stack[64];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0)
+        {
+            const Node &node = nodes[stack[--stackSize]];
+
+            float tNear;
+            if (!slabTest(node, origin, invDir, tMax, tNear))
+                continue;
+
+            if (node.count >= 0)
+            {
+                for (int i = node.start; i < node.start + node.count; ++i)
+                    visit(primIndices[i], tMax);
+                continue;
+            }
+
+            // Push the farther child first so the nearer one is visited first
+            float tLeft, tRight;
+            bool hitLeft = slabTest(nodes[node.start], origin, invDir, tMax, tLeft);
+            bool hitRight = slabTest(nodes[node.start + 1], origin, invDir, tMax, tRight);
+
+            if (hitLeft && hitRight)
+            {
+                if (tLeft < tRight)
+                {
+                    stack[stackSize++] = node.start + 1;
+                    stack[stackSize++] = node.start;
+                }
+                else
+                {
+                    stack[stackSize++] = node.start;
+                    stack[stackSize++] = node.start + 1;
+                }
+            }
+            else if (hitLeft)
+                stack[stackSize++] = node.start;
+            else if (hitRight)
+                stack[stackSize++] = node.start + 1;
+        }
+    }
+
+    // Generic traversal
+    // NodeTest: bool(const glm::vec3 &min, const glm::vec3 &max), Visitor: void(int primitive)
+    template <typename NodeTest, typename Visitor> void traverse(NodeTest &&test, Visitor &&visit) const
+    {
+        if (nodes.empty())
+            return;
+
+        int stack[64];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0)
+        {
+            const Node &node = nodes[stack[--stackSize]];
+
+            if (!test(node.min, node.max))
+                continue;
+
+            if (node.count >= 0)
+            {
+                for (int i = node.start; i < node.start + node.count; ++i)
+                    visit(primIndices[i]);
+            }
+            else
+            {
+                stack[stackSize++] = node.start + 1;
+                stack[stackSize++] = node.start;
+            }
+        }
+    }
+
+  private:
+    static constexpr int MAX_LEAF_SIZE = 4;
+
+    std::vector<Node> nodes;
+    std::vector<int> primIndices;
+    std::vector<glm::vec3> centroids;
+    // Slot in primIndices and leaf node of every primitive id
+    std::vector<int> slotOf;
+    std::vector<int> leafOf;
+    int livePrimitives = 0;
+
+    void subdivide(int nodeIndex, const std::vector<AABB> &bounds);
+    void computeLeafBounds(Node &node, const std::vector<AABB> &bounds) const;
+
+    static bool slabTest(const Node &node, const glm::vec3 &origin, const glm::vec3 &invDir, float tMax, float &tNear)
+    {
+        glm::vec3 t1 = (node.min - origin) * invDir;
+        glm::vec3 t2 = (node.max - origin) * invDir;
+
+        glm::vec3 tSmall = glm::min(t1, t2);
+        glm::vec3 tBig = glm::max(t1, t2);
+
+        tNear = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+        float tFar = glm::min(glm::min(tBig.x, tBig.y), glm::min(tBig.z, tMax));
+
+        return tNear <= tFar;
+    }
+};
@@ -1,13 +1,33 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "AdjacencyLists.hpp"
 #include "AnalysisData.hpp"
+#include "BVH.hpp"
+#include "DihedralBending.hpp"
+#include "EmbeddedMesh.hpp"
 #include "Force.hpp"
+#include "FrameArena.hpp"
+#include "FrameGovernor.hpp"
+#include "Fracture.hpp"
+#include "Membrane.hpp"
+#include "ObjMesh.hpp"
 #include "Object.hpp"
 #include "Shader.hpp"
+#include "StructuredGrid.hpp"
+#include "SubspacePreview.hpp"
+#include "SurfaceSubdivision.hpp"
+#include "Tether.hpp"
+#include "TileSolver.hpp"
 
 extern bool trackingMode;
 extern int trackedMassIndex;
@@ -15,6 +35,17 @@ extern int trackedMassIndex;
 class AABB;
 class Ray;
 
+// Coefficients of one time corrected Verlet step, the step size may differ from the previous one
+struct VerletStep
+{
+    VerletStep(float dt, float previousDt);
+
+    // Damping per elapsed time times the ratio of the step sizes, applied to the last displacement
+    float velocityScale;
+    // dt * (dt + previousDt) / 2, equal to dt * dt while the step size is constant
+    float accelerationScale;
+};
+
 struct Mass
 {
     // Position and Verlet data
@@ -38,35 +69,279 @@ struct Mass
     }
 
     // Update functions
-    void update(float dt);
+    void update(const VerletStep &step);
+    // Verlet step without the fixed check, for callers that already skip fixed masses
+    void integrate(const VerletStep &step);
     void applyForce(const glm::vec3 &force);
 
     // Get AABB ray collision
     AABB getAABB() const;
 };
 
+// Spring families, every material belongs to one
+enum class SpringFamily : int
+{
+    STRUCTURAL,
+    SHEAR,
+    BENDING
+};
+
+const int SPRING_FAMILY_COUNT = 3;
+
+// Shared spring parameters, springs store an index into the cloth material table
+struct SpringMaterial
+{
+    float stiffness;
+    float damping;
+    SpringFamily family;
+};
+
 struct Spring
 {
     // Two points indexes
     int a, b;
     // Physical data
     float restLength;
-    float stiffness;
-    float damping;
+    int material;
 
-    // Helper
-    glm::vec3 midpoint;
+    Spring(int a, int b, float rest, int material) : a(a), b(b), restLength(rest), material(material)
+    {
+    }
+};
 
-    Spring(int a, int b, float rest, const glm::vec3 &mp, float k = 50.0f, float d = 0.01f)
-        : a(a), b(b), restLength(rest), stiffness(k), damping(d), midpoint(mp)
+// Families projected by one solver iteration and the correction factor of each one
+struct SolverPass
+{
+    explicit SolverPass(float correctionFactor)
+    {
+        for (float &familyCorrection : correction)
+            familyCorrection = correctionFactor;
+    }
+
+    bool includes(SpringFamily family) const
+    {
+        return (families >> static_cast<int>(family)) & 1u;
+    }
+
+    // Indexed by SpringFamily
+    float correction[SPRING_FAMILY_COUNT];
+    // Bit per family, springs of the other families are left alone
+    unsigned families = (1u << SPRING_FAMILY_COUNT) - 1;
+};
+
+// Position correction of one spring, returns the length before the correction
+// Pinned: some masses may be fixed, without it the fixed flags are never read
+// Both stretch cases share one update so the correction is a select instead of a branch
+template <bool Pinned = true>
+inline float projectSpring(Mass &massA, Mass &massB, float restLength, float stiffness, float correctionFactor,
+                           float maxStretchRatio)
+{
+    glm::vec3 delta = massB.position - massA.position;
+    float currentLength = glm::length(delta);
+
+    if (currentLength < 0.0001f)
+        return currentLength;
+
+    glm::vec3 direction = delta / currentLength;
+
+    // Overstretched springs are pulled back to the limit at once, others relax by the stiffness factor
+    float maxLength = restLength * maxStretchRatio;
+    float relaxed = (currentLength - restLength) * 0.5f * (correctionFactor * (stiffness / 100.0f));
+    float clamped = (currentLength - maxLength) * 0.5f;
+    glm::vec3 correction = direction * (currentLength > maxLength ? clamped : relaxed);
+
+    if constexpr (Pinned)
+    {
+        massA.position = massA.fixed ? massA.position : massA.position + correction;
+        massB.position = massB.fixed ? massB.position : massB.position - correction;
+    }
+    else
+    {
+        massA.position += correction;
+        massB.position -= correction;
+    }
+
+    return currentLength;
+}
+
+// Constraint violation seen during one solver sweep, relative to the rest length
+struct SolverResidual
+{
+    float maxViolation = 0.0f;
+    double sumSquares = 0.0;
+    int count = 0;
+
+    void add(float stretchRatio)
+    {
+        float violation = std::abs(stretchRatio - 1.0f);
+        maxViolation = std::max(maxViolation, violation);
+        sumSquares += violation * violation;
+        count++;
+    }
+    void merge(const SolverResidual &other)
     {
+        maxViolation = std::max(maxViolation, other.maxViolation);
+        sumSquares += other.sumSquares;
+        count += other.count;
     }
+    float rms() const
+    {
+        return count > 0 ? static_cast<float>(std::sqrt(sumSquares / count)) : 0.0f;
+    }
+};
+
+// Hooke and damping force of one spring
+template <bool Pinned = true>
+inline void applySpringForce(Mass &massA, Mass &massB, float restLength, const SpringMaterial &material)
+{
+    glm::vec3 delta = massB.position - massA.position;
+    float currentLength = glm::length(delta);
+
+    if (currentLength < 0.0001f)
+        return;
+
+    glm::vec3 direction = delta / currentLength;
+
+    float displacement = currentLength - restLength;
+    float springForceMagnitude = material.stiffness * displacement;
+    glm::vec3 springForce = direction * springForceMagnitude;
+
+    glm::vec3 velocityA = massA.position - massA.prevPosition;
+    glm::vec3 velocityB = massB.position - massB.prevPosition;
+    glm::vec3 relativeVelocity = velocityB - velocityA;
+    float relativeVelocityAlongSpring = glm::dot(relativeVelocity, direction);
+    glm::vec3 dampingForce = direction * (material.damping * relativeVelocityAlongSpring);
+
+    glm::vec3 totalSpringForce = springForce + dampingForce;
+
+    if (!Pinned || !massA.fixed)
+        massA.applyForce(totalSpringForce);
+    if (!Pinned || !massB.fixed)
+        massB.applyForce(-totalSpringForce);
+}
+
+// Early termination of the constraint iterations, the solver iteration count is the maximum
+struct ConvergenceParams
+{
+    bool enabled = false;
+    // Relative constraint violation that ends the iterations
+    float tolerance = 0.01f;
+    // Compare the RMS violation instead of the worst spring
+    bool useRms = false;
+    // Also stop once an iteration lowers the violation by less than this fraction, 0 disables it
+    float minImprovement = 0.0f;
+    int minIterations = 1;
+};
+
+// Projection schedule of one spring family
+struct FamilySchedule
+{
+    // Capped by the solver iteration count
+    int iterations;
+    // Multiplies the solver correction factor
+    float relaxation;
+};
+
+// Separate iteration counts per spring family, while disabled every family takes part in every iteration
+struct ScheduleParams
+{
+    bool enabled = false;
+    // Indexed by SpringFamily
+    FamilySchedule families[SPRING_FAMILY_COUNT] = {{20, 1.0f}, {3, 1.0f}, {2, 1.0f}};
+    // Bending springs are projected on every Nth step only
+    int bendingInterval = 1;
+};
+
+// Adaptive step size, every frame is split into steps no longer than the stability bound
+struct TimestepParams
+{
+    bool enabled = false;
+    // Fraction of the stability bounds actually used
+    float safety = 0.5f;
+    float minDt = 0.0005f;
+    float maxDt = 0.016f;
+    // Longer frames are clamped, the rest of the frame time is dropped
+    float maxFrameDt = 0.05f;
+    // Largest fraction of the shortest rest length a mass may travel in one step
+    float maxTravel = 0.25f;
+    // Growth of the largest stretch per second above which the step shrinks in proportion,
+    // the resting stretch next to pins is ignored
+    float strainRateLimit = 2.0f;
+    // Factor applied to the step on frames that broke springs
+    float tearingScale = 0.5f;
+    // Growth factor per frame, shrinking is immediate
+    float maxGrowth = 1.1f;
+};
+
+// Adaptive resolution rules
+struct RefinementParams
+{
+    bool enabled = false;
+    // Frames between refinement passes
+    int interval = 10;
+    // Edge stretch ratio and vertex normal cosine that split a triangle
+    float splitStrain = 1.25f;
+    float splitCurvature = 0.8f;
+    // A refined edge is merged back once its masses barely move and the surface around it is flat
+    float settleMotion = 0.005f;
+    float coarsenCurvature = 0.95f;
+    int settlePasses = 6;
+    // Shortest rest length that can still be split, as a fraction of the grid spacing
+    float minEdgeFraction = 0.5f;
+    int massBudget = 5000;
+    // Triangles around masses torn or pushed out of a collider since the last pass are split too
+    bool splitTearFront = true;
+    bool splitContacts = true;
+};
+
+// One edge bisection, kept so the edge can be restored when the region settles
+struct RefinementRecord
+{
+    int a, b, mid;
+    // Parent spring
+    float restLength;
+    int material;
+    // Mass moved from the endpoints to the new mass
+    float takenA;
+    float takenB;
+    int settledPasses;
+};
+
+// Mass and spring defaults of newly built cloth, see setPhysicalProperties
+struct PhysicalProperties
+{
+    float mass;
+    float structuralStiffness;
+    float structuralDamping;
+    float shearStiffness;
+    float shearDamping;
+    float bendingStiffness;
+    float bendingDamping;
+};
+
+// Rules of a cloth built from an OBJ mesh
+struct MeshImportParams
+{
+    // Faces of this g group pin their vertices
+    std::string pinGroup = "pin";
+    // Applied to the file positions
+    float scale = 1.0f;
+    glm::vec3 offset = glm::vec3(0.0f);
+};
+
+// What the texture buffers draw
+enum class RenderSource
+{
+    SIMULATED,
+    SUBDIVIDED,
+    EMBEDDED
 };
 
 class Cloth
 {
   public:
-    Cloth(float width, float height, int resX, int resY, float floorY);
+    // Headless cloths never touch OpenGL, for processes without a context
+    Cloth(float width, float height, int resX, int resY, float floorY, bool headless = false);
 
     enum class ClothOrientation
     {
@@ -82,6 +357,8 @@ class Cloth
     // Physic solver
     void satisfy();
     void calculateNormals();
+    // Masses and triangles whose normals the embedded render mesh reads
+    void updateNormalSubset();
     void checkSpringTension();
     void applySpringForces();
 
@@ -91,6 +368,9 @@ class Cloth
     // Cloth setup
     void resize(float newWidth, float newHeight, int newResX, int newResY);
     void setOrientation(ClothOrientation orientation);
+    // Keep the grid rows [firstRow, lastRow) and haloRows on each side, halo masses are pinned so another
+    // shard can drive them, switches to explicit springs
+    void keepRows(int firstRow, int lastRow, int haloRows);
 
     // Collision
     void addCollisionObject(Object *obj);
@@ -106,16 +386,87 @@ class Cloth
                            const glm::mat4 &projection, int screenWidth, int screenHeight);
     void checkTearingAroundPoint(int massIndex);
     int pickMassPoint(const Ray &ray);
+    // Picked mass, follows the mass when refinement renumbers masses
+    int getSelectedMassIndex() const;
 
     // Physical data
     void setSolverParameters(int iterations, float correction, float maxStretch);
+    int getSolverIterations() const;
+    float getCorrectionFactor() const;
+    float getMaxStretchRatio() const;
+    // Steps per update, each one advances dt / substeps
+    void setSubsteps(int count);
+    int getSubsteps() const;
+    // Updates between statistics passes
+    void setAnalysisInterval(int frames);
+    int getAnalysisInterval() const;
+    // Adjusts iterations, substeps and the statistics interval to the frame budget while enabled
+    FrameGovernor &getGovernor();
+    const FrameGovernor &getGovernor() const;
+    const TimestepParams &getTimestepParams() const;
+    void setTimestepParams(const TimestepParams &params);
+    // Step size and step count of the last update
+    float getTimestep() const;
+    int getStepCount() const;
+    const ConvergenceParams &getConvergenceParams() const;
+    void setConvergenceParams(const ConvergenceParams &params);
+    const ScheduleParams &getScheduleParams() const;
+    void setScheduleParams(const ScheduleParams &params);
     void setPhysicalProperties(float mass, float structStiff, float structDamp, float shearStiff, float shearDamp,
                                float bendStiff, float bendDamp);
+    PhysicalProperties getPhysicalProperties() const;
     void setCutThreshold(float threshold);
     ;
     void setTensionBreaking(float threshold);
     void setTensionBreakThreshold(float threshold);
     void setEnableTensionBreaking(bool enabled);
+    // Implicit grid topology, applied on the next reset
+    void setStructuredGrid(bool enabled);
+    bool getStructuredGrid() const;
+    // Grid solver in vectorizable row runs, takes effect at once
+    void setGridRowPasses(bool enabled);
+    bool getGridRowPasses() const;
+    // Skip springs or hinges, applied on the next reset
+    void setBendingModel(BendingModel model);
+    BendingModel getBendingModel() const;
+    const DihedralBending &getDihedralBending() const;
+    // Springs or triangle elements for stretch and shear, applied on the next reset
+    // Triangle elements drop the structural grid and always bend with hinges, skip springs would bridge
+    // the elements removed by tearing
+    void setMembraneModel(MembraneModel model);
+    MembraneModel getMembraneModel() const;
+    const MembraneParams &getMembraneParams() const;
+    void setMembraneParams(const MembraneParams &params);
+    const MembraneSystem &getMembrane() const;
+    // Solve on one tile per scheduler thread, rebuilt and rebalanced after topology changes
+    void setTiledSolver(bool enabled);
+    bool getTiledSolver() const;
+    const TileSolver &getTileSolver() const;
+    // Long range attachments to the nearest pin, rebuilt when tearing or pins change the rest mesh paths
+    const TetherParams &getTetherParams() const;
+    void setTetherParams(const TetherParams &params);
+    const TetherSystem &getTethers() const;
+    // Reduced order preview, trained on the following full steps and used while enabled and still valid
+    // Cutting, tearing, refinement or new pins fall back to the full solver until it is trained again
+    const PreviewParams &getPreviewParams() const;
+    void setPreviewParams(const PreviewParams &params);
+    void startPreviewTraining();
+    const SubspacePreview &getPreview() const;
+    // The last update was a reduced step
+    bool isPreviewRunning() const;
+    // Curved patches drawn in place of the simulated triangles, display only
+    const SubdivisionParams &getSubdivisionParams() const;
+    void setSubdivisionParams(const SubdivisionParams &params);
+    // Cloth built from the triangles of an OBJ mesh instead of the grid, kept by reset until resize
+    // Unique edges become structural springs and the vertices across every inner edge bending springs,
+    // the triangles stay the render and tearing topology like the grid cells
+    bool loadClothMesh(const std::string &path, const MeshImportParams &params = MeshImportParams());
+    bool hasClothMesh() const;
+    // OBJ mesh drawn in place of the cloth, bound to the simulated triangles in their current pose
+    bool loadRenderMesh(const std::string &path);
+    void clearRenderMesh();
+    const EmbeddedMesh &getRenderMesh() const;
+    int getRenderedTriangleCount() const;
 
     // Visual
     void changeMassesVisible();
@@ -130,16 +481,30 @@ class Cloth
     ClothAnalysis &getAnalysis();
     ForceManager &getForceManager();
     Mass &getMass(int index);
+    // Mass at a grid point of the initial layout, -1 once the point was dropped
+    int getGridMassIndex(int x, int y) const;
     const std::vector<Mass> &getMasses() const;
+    // Explicit springs, empty while the structured grid holds the topology
     const std::vector<Spring> &getSprings() const;
+    int getSpringCount() const;
+    const SpringMaterial &getSpringMaterial(const Spring &spring) const;
+    glm::vec3 getSpringMidpoint(const Spring &spring) const;
     float getCutThreshold() const;
     float getTensionBreaking() const;
     bool getEnableTensionBreaking() const;
     float getTensionBreakThreshold() const;
     AnalysisDisplayData getAnalysisDisplayData() const;
+    const RefinementParams &getRefinementParams() const;
+    void setRefinementParams(const RefinementParams &params);
+    int getRefinedEdgeCount() const;
+    // Renumber masses along a Morton curve of their rest coordinates and sort springs by first endpoint,
+    // can be run again after tearing or refinement scattered the numbering
+    void reorderForLocality();
     ClothOrientation getOrientation() const;
 
   private:
+    using StepKernel = void (Cloth::*)(float dt);
+
     // Dimension data
     int resX, resY;
     float width, height;
@@ -147,7 +512,6 @@ class Cloth
 
     // Phycis data
     float simulationTime = 0.0f;
-    float tensionBreakThreshold = 3.5f;
     float cutThresholdPixels = 10.0f;
     float correctionFactor = 0.15f;
     float maxStretchRatio = 1.2f;
@@ -163,7 +527,14 @@ class Cloth
 
     // Cloth data
     std::vector<Mass> masses;
+    // Positions the cloth was built with, copies and inserted masses take theirs from the masses they came from
+    std::vector<glm::vec3> restPositions;
     std::vector<Spring> springs;
+    std::vector<SpringMaterial> materials;
+    // Regular grid topology, used instead of springs while active
+    StructuredGrid grid;
+    bool structuredGrid = false;
+    mutable std::vector<Spring> localSprings;
     std::vector<int> massIndexMap;
     std::vector<Object *> collisionObjects;
 
@@ -171,9 +542,26 @@ class Cloth
     std::vector<float> massesVertices;
     std::vector<float> lineVertices;
     std::vector<float> textureVertices;
+    // Render triangles, built with the grid and updated by tearing
     std::vector<unsigned int> textureIndices;
+    bool indicesDirty = true;
+    SurfaceSubdivision subdivision;
+    SubdivisionParams subdivisionParams;
+    int subdivisionTopology = -1;
+    int subdivisionTriangles = -1;
+    ObjMesh clothMesh;
+    MeshImportParams meshImport;
+    EmbeddedMesh renderMesh;
+    int renderMeshTopology = -1;
+    int renderMeshTriangles = -1;
+    std::vector<int> normalMasses;
+    std::vector<int> normalTriangles;
+    int normalSubsetTopology = -1;
+    // Vertices and triangles in the texture buffers
+    RenderSource renderSource = RenderSource::SIMULATED;
 
     // Visual
+    bool headless = false;
     bool massVisible = false;
     bool springVisible = false;
     bool textureVisible = true;
@@ -185,10 +573,68 @@ class Cloth
     unsigned int VAO_lines = 0, VBO_lines = 0;
     unsigned int VAO_texture = 0, VBO_texture = 0, EBO_texture = 0;
     unsigned int textureID = 0;
+    // Allocated GPU buffer sizes in bytes
+    size_t massesBufferSize = 0;
+    size_t linesBufferSize = 0;
+    size_t textureBufferSize = 0;
+    size_t indexBufferSize = 0;
 
     int selectedMassIndex = -1;
     // Solver
     int solverIterations = 5;
+    int substeps = 1;
+    TimestepParams timestepParams;
+    float adaptiveDt = 0.016f;
+    // Size of the last step, the next Verlet step scales the displacement by the ratio
+    float previousDt = 0.0f;
+    float lastStepDt = 0.0f;
+    int lastStepCount = 0;
+    float minRestLength = 0.0f;
+    int minRestTopology = -1;
+    // Largest stretch ratio of the last adaptive step sample and its simulation time, negative before the first
+    float lastMaxStrain = 1.0f;
+    float lastStrainTime = -1.0f;
+    int lastBrokenCount = 0;
+    int analysisInterval = 1;
+    int analysisFrame = 0;
+    FrameGovernor governor;
+    ConvergenceParams convergenceParams;
+    ScheduleParams scheduleParams;
+    // Spring indices of every family, the explicit solver walks these while the schedule is enabled
+    std::vector<int> springBatches[SPRING_FAMILY_COUNT];
+    int batchesTopology = -1;
+    int batchesSpringCount = -1;
+    // Steps since the reset, selects the steps that project bending
+    int stepCounter = 0;
+    StepKernel stepKernel = nullptr;
+    int stepKernelFeatures = -1;
+    TileSolver tiles;
+    bool tiledSolver = false;
+    int tilesTopology = -1;
+    int tilesMassCount = -1;
+    BendingModel bendingModel = BendingModel::SKIP_SPRINGS;
+    // Hinges of the render triangles, rebuilt when tearing or refinement changes them
+    DihedralBending dihedral;
+    int dihedralTopology = -1;
+    int dihedralTriangles = -1;
+    MembraneModel membraneModel = MembraneModel::MASS_SPRING;
+    MembraneParams membraneParams;
+    // Elements of the render triangles, the fracture state follows them while they are active
+    MembraneSystem membrane;
+    int membraneTopology = -1;
+    int membraneTriangles = -1;
+    TetherSystem tethers;
+    TetherParams tetherParams;
+    int tethersTopology = -1;
+    int tethersMassCount = -1;
+    int tethersPins = -1;
+    // Bumped when masses are pinned or released outside of a rebuild
+    int pinsVersion = 0;
+    SubspacePreview preview;
+    PreviewParams previewParams;
+    bool previewRunning = false;
+    // Frame time not yet covered by reduced steps
+    float previewAccumulator = 0.0f;
 
     // idk
     ClothOrientation currentOrientation;
@@ -196,8 +642,75 @@ class Cloth
     ClothAnalysis analysis;
     glm::vec3 lastMouseWorldPos;
 
+    // Fracture
+    FractureSystem fracture;
+    FractureParams fractureParams;
+
+    // Scratch of one step, reset at the start of update, containers built on it must not outlive the step
+    mutable FrameArena frameArena;
+
+    // Springs and triangles around every mass, patched by tearing so an event only visits the fans it touches
+    AdjacencyLists massSpringLinks;
+    AdjacencyLists massTriangleLinks;
+    int linksTopology = -1;
+
+    // Tearing scratch, kept between events
+    std::vector<int> tornMasses;
+    // Springs or triangles removed by the last tear, in removal order
+    std::vector<int> brokenItems;
+    std::vector<int> droppedTriangles;
+    std::vector<int> fanTriangles;
+    std::vector<int> fanSprings;
+    std::vector<int> fanComponents;
+    std::vector<int> fanLabels;
+    std::vector<int> componentMasses;
+
+    // Adaptive refinement
+    RefinementParams refinementParams;
+    std::vector<RefinementRecord> refinementRecords;
+    int refinementFrame = 0;
+    // Mass per unit of rest area, used to lump mass onto inserted masses
+    float restDensity = 1.0f;
+    std::pmr::unordered_map<uint64_t, int> edgeSprings{&frameArena};
+    std::pmr::unordered_map<uint64_t, std::pair<int, int>> edgeTriangles{&frameArena};
+    std::vector<std::pair<float, int>> splitCandidates;
+    // Tear front and contact bits per mass, set between passes
+    std::vector<uint8_t> refineMarks;
+    std::vector<uint8_t> markScratch;
+    std::vector<uint8_t> triangleTouched;
+    std::vector<uint8_t> massTouched;
+    std::vector<int> massSpringStart;
+    std::vector<int> massSprings;
+    std::vector<int> massTriangleStart;
+    std::vector<int> massTriangles;
+    std::vector<int> massRemap;
+    std::vector<Mass> massScratch;
+    std::vector<glm::vec3> restScratch;
+    std::vector<std::pair<uint32_t, int>> mortonOrder;
+    std::vector<int> springOrder;
+
+    // Spatial index for picking and cutting
+    struct SpatialIndexState
+    {
+        int positions = -1;
+        int topology = -1;
+    };
+    BVH triangleBVH;
+    BVH massBVH;
+    BVH springBVH;
+    std::vector<AABB> primitiveBounds;
+    SpatialIndexState pickIndexState;
+    SpatialIndexState cutIndexState;
+    float pickRadius = 0.1f;
+    // Bumped whenever masses move or springs are removed
+    int positionsVersion = 0;
+    int topologyVersion = 0;
+
     // Setup
     void initCloth();
+    // Masses, springs and triangles of initCloth, from the grid layout or the imported mesh
+    void buildGrid();
+    void buildFromMesh();
     void applyConsts();
     void cleanupBuffers();
 
@@ -207,4 +720,59 @@ class Cloth
     bool areSpringMidpointsConnected(int springA, int springB) const;
     void rebuildTextureData();
     void rebuildGraphicsData();
+    void removeBrokenSprings();
+    // Splits the torn masses whose triangle fan fell apart, needs current links
+    void splitTornVertices();
+    void updateMassLinks();
+    bool hasSpring(int a, int b) const;
+    // Swaps triangle t with the last one and drops it, the links follow
+    void removeTriangle(int t);
+    // Tearing of triangle elements removes their triangles and splits the corners whose fan fell apart
+    void removeBrokenElements();
+    // Switch from the structured grid to explicit springs, needed for tearing and refinement
+    // Broken grid edges are left pending with spring ids equal to their edge ids
+    void useExplicitSprings();
+    // Masses of spring i, or of edge i while the grid is active
+    void springEndpoints(int spring, int &a, int &b) const;
+    const std::vector<Spring> &springsAround(int massIndex) const;
+    void adaptMesh();
+    void refineMesh();
+    void coarsenMesh();
+    bool splitEdge(int springIndex);
+    void remapMasses(const std::vector<int> &newIndex);
+    void resetFrameArena();
+    // Step kernels specialized on the enabled features, picked again only when the feature set changes
+    template <bool Collisions, bool Pinned, bool RecordStrain, bool Structured> void step(float dt);
+    int stepFeatures() const;
+    // Largest stable step from mass speed, spring stiffness and strain, smoothed over frames
+    float adaptTimestep(float previousStable, float frameDt);
+    void updateTiles();
+    void updateTethers();
+    void updateSpringBatches();
+    void updateDihedral();
+    void updateMembrane();
+    void updateSubdivision();
+    void updateRenderMesh();
+    // Triangles in the element buffer, the simulated ones or their patches
+    const std::vector<unsigned int> &renderIndices() const;
+    // Solver path and reduced path of one update, the latter returns false when the preview cannot run
+    void advanceFull(float dt);
+    bool advancePreview(float dt);
+    // External acceleration of a free mass, the forces are uniform over the cloth
+    glm::vec3 externalAcceleration() const;
+    // Membrane model in effect, imported meshes always use springs whatever the user picked
+    MembraneModel activeMembraneModel() const;
+    // Hinges are used by the dihedral bending model and by the triangle membrane
+    bool usesHinges() const;
+    // Families and corrections of one iteration, bendingDue is false on steps that skip bending
+    SolverPass schedulePass(int iteration, bool bendingDue) const;
+    // Iterations of one step, the largest family count under the schedule
+    int scheduledIterations(bool bendingDue) const;
+    static StepKernel selectStepKernel(int features);
+    void uploadBuffer(unsigned int target, unsigned int buffer, size_t &capacity, const void *data, size_t bytes);
+    // Refitted once per frame by update, queries only read it
+    void updatePickIndex();
+    // False between a topology change and the next update, queries then test every primitive
+    bool pickIndexCurrent() const;
+    void updateCutIndex();
 };
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "TaskScheduler.hpp"
+
+// Greedy coloring of constraints that each move a few masses
+// Constraints of one color share no mass, so a color can be solved in parallel and neighbouring
+// constraints in the sweep no longer wait for each other. Constraints that find no free color
+// form a last batch that runs in order.
+class ConstraintColoring
+{
+  public:
+    // Colors tracked per mass
+    static const int MAX_COLORS = 64;
+
+    // Corners: void(int constraint, Visit), Visit: void(int mass) for every mass the constraint moves
+    // Afterwards the constraints are meant to be stored in getOrder() order
+    template <typename Corners> void build(int count, int massCount, Corners &&corners)
+    {
+        usedColors.assign(massCount, 0);
+        colors.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            uint64_t used = 0;
+            corners(i, [&](int mass) { used |= usedColors[mass]; });
+
+            int color = MAX_COLORS;
+            for (int bit = 0; bit < MAX_COLORS; bit++)
+            {
+                if (!((used >> bit) & 1u))
+                {
+                    color = bit;
+                    break;
+                }
+            }
+
+            colors[i] = color;
+            if (color < MAX_COLORS)
+            {
+                uint64_t mask = uint64_t(1) << color;
+                corners(i, [&](int mass) { usedColors[mass] |= mask; });
+            }
+        }
+
+        order.resize(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) { return colors[lhs] < colors[rhs]; });
+        position.resize(count);
+        for (int i = 0; i < count; i++)
+            position[order[i]] = i;
+
+        colorEnd.assign(MAX_COLORS + 1, 0);
+        for (int i = 0; i < count; i++)
+            colorEnd[colors[order[i]]] = i + 1;
+        for (int color = 1; color <= MAX_COLORS; color++)
+            colorEnd[color] = std::max(colorEnd[color], colorEnd[color - 1]);
+    }
+
+    void clear()
+    {
+        order.clear();
+        colorEnd.clear();
+    }
+
+    // Drop a constraint the way it is swapped with the back of the constraint array, the last constraint takes
+    // its id. Masses only lose constraints, so the colors of the others stay valid.
+    void remove(int constraint)
+    {
+        // Every later color hands its last slot down, the hole ends up at the back of the order
+        int hole = position[constraint];
+        for (int color = colors[constraint]; color <= MAX_COLORS; color++)
+        {
+            int lastSlot = --colorEnd[color];
+            if (lastSlot != hole)
+            {
+                order[hole] = order[lastSlot];
+                position[order[hole]] = hole;
+            }
+            hole = lastSlot;
+        }
+        order.pop_back();
+
+        int last = static_cast<int>(colors.size()) - 1;
+        if (constraint != last)
+        {
+            order[position[last]] = constraint;
+            position[constraint] = position[last];
+            colors[constraint] = colors[last];
+        }
+        colors.pop_back();
+        position.pop_back();
+    }
+
+    // Constraint ids sorted by color
+    const std::vector<int> &getOrder() const
+    {
+        return order;
+    }
+
+    // Solve: void(int begin, int end) over positions in the sorted order, colors run one after another
+    template <typename Solve> void run(TaskScheduler &scheduler, int grain, Solve &&solve) const
+    {
+        if (colorEnd.empty())
+            return;
+
+        for (int color = 0, begin = 0; color <= MAX_COLORS; begin = colorEnd[color++])
+        {
+            int colorGrain = color < MAX_COLORS ? grain : colorEnd[color] - begin + 1;
+            scheduler.parallelFor(begin, colorEnd[color], colorGrain, solve);
+        }
+    }
+
+  private:
+    std::vector<int> order;
+    // Inverse of order, slot of every constraint
+    std::vector<int> position;
+    // colorEnd[k] ends color k, the last entry closes the uncolored constraints
+    std::vector<int> colorEnd;
+    std::vector<uint64_t> usedColors;
+    std::vector<int> colors;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+#include "ConstraintColoring.hpp"
+
+struct Mass;
+class StructuredGrid;
+
+// How the cloth resists folding, applied on the next reset
+enum class BendingModel
+{
+    // Distance springs between masses two apart
+    SKIP_SPRINGS,
+    // Angle constraints between the two triangles of every interior edge
+    DIHEDRAL
+};
+
+// Dihedral angle constraints over the render triangulation
+// Every hinge keeps the angle it had in the rest positions, so a curved mesh keeps its shape and a grid stays flat.
+// One hinge moves four masses along the exact angle gradient, which stays defined for a flat hinge.
+class DihedralBending
+{
+  public:
+    // Interior edges of the triangles become hinges, edges broken in an active grid are skipped
+    // The rest angle of every hinge is measured on restPositions, indexed like the masses
+    void build(const std::vector<unsigned int> &triangles, const std::vector<glm::vec3> &restPositions,
+               const StructuredGrid *grid = nullptr);
+    void clear();
+
+    bool active() const
+    {
+        return !hinges.empty();
+    }
+    int getHingeCount() const
+    {
+        return static_cast<int>(hinges.size());
+    }
+
+    // One Gauss-Seidel sweep color by color, stiffness is the fraction of the angle removed per hinge
+    // Pinned false skips the fixed checks, only valid when no mass is fixed
+    void solveIteration(std::vector<Mass> &masses, float stiffness, bool pinned, TaskScheduler &scheduler) const;
+    // Mean absolute difference between the hinge angles and their rest angles in radians
+    float meanAngle(const std::vector<Mass> &masses) const;
+
+  private:
+    struct Hinge
+    {
+        // Shared edge, then the opposite masses of the triangle that runs a -> b and of the other one
+        int a, b;
+        int c, d;
+        float restAngle;
+    };
+
+    template <bool Pinned> void solve(std::vector<Mass> &masses, float stiffness, int begin, int end) const;
+
+    // Sorted by color
+    std::vector<Hinge> hinges;
+    ConstraintColoring coloring;
+    // Edge key, then opposite mass and edge start of every triangle side, sorted to pair the sides
+    std::vector<std::pair<uint64_t, std::pair<int, int>>> sides;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Open addressing map from undirected mass pairs to an int
+// Keys are the ordered pair packed into 64 bits, probed linearly in a power of two table that doubles
+// at half load. Meant for building topology from large triangle lists, where a node based set spends
+// most of its time allocating.
+class EdgeHash
+{
+  public:
+    // Room for count edges without growing
+    void reserve(int count)
+    {
+        std::size_t capacity = 16;
+        while (capacity < static_cast<std::size_t>(count) * 2)
+            capacity *= 2;
+        if (capacity > keys.size())
+            rehash(capacity);
+    }
+
+    void clear()
+    {
+        keys.clear();
+        values.clear();
+        count = 0;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    // Value stored for the edge, value is inserted first when the edge is new, second tells which happened
+    std::pair<int &, bool> insert(int a, int b, int value)
+    {
+        if ((count + 1) * 2 > static_cast<int>(keys.size()))
+            rehash(keys.empty() ? 16 : keys.size() * 2);
+
+        uint64_t key = edgeKey(a, b);
+        std::size_t slot = slotOf(key);
+        while (keys[slot] != EMPTY)
+        {
+            if (keys[slot] == key)
+                return {values[slot], false};
+            slot = (slot + 1) & (keys.size() - 1);
+        }
+
+        keys[slot] = key;
+        values[slot] = value;
+        count++;
+        return {values[slot], true};
+    }
+
+    // Value of the edge, -1 when it is missing
+    int find(int a, int b) const
+    {
+        if (keys.empty())
+            return -1;
+
+        uint64_t key = edgeKey(a, b);
+        for (std::size_t slot = slotOf(key); keys[slot] != EMPTY; slot = (slot + 1) & (keys.size() - 1))
+        {
+            if (keys[slot] == key)
+                return values[slot];
+        }
+        return -1;
+    }
+
+  private:
+    static constexpr uint64_t EMPTY = ~uint64_t(0);
+
+    static uint64_t edgeKey(int a, int b)
+    {
+        uint32_t low = static_cast<uint32_t>(a < b ? a : b);
+        uint32_t high = static_cast<uint32_t>(a < b ? b : a);
+        return (uint64_t(low) << 32) | high;
+    }
+
+    // Fibonacci hashing spreads the neighbouring indices of a mesh over the table
+    std::size_t slotOf(uint64_t key) const
+    {
+        return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (keys.size() - 1);
+    }
+
+    void rehash(std::size_t capacity)
+    {
+        std::vector<uint64_t> oldKeys(capacity, EMPTY);
+        std::vector<int> oldValues(capacity);
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+
+        for (std::size_t i = 0; i < oldKeys.size(); i++)
+        {
+            if (oldKeys[i] == EMPTY)
+                continue;
+            std::size_t slot = slotOf(oldKeys[i]);
+            while (keys[slot] != EMPTY)
+                slot = (slot + 1) & (keys.size() - 1);
+            keys[slot] = oldKeys[i];
+            values[slot] = oldValues[i];
+        }
+    }
+
+    std::vector<uint64_t> keys;
+    std::vector<int> values;
+    int count = 0;
+};
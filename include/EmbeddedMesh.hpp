@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ObjMesh.hpp"
+
+struct Mass;
+class TaskScheduler;
+
+// High resolution render mesh carried by the simulated triangles
+// Every render vertex is bound once to the nearest simulated triangle: its texture space point on the
+// triangle, its distance along the normal and its normal in the frame of the triangle. Bindings live in
+// texture space, so after tearing, refinement or renumbering they are attached to whichever triangle
+// now covers their point. Vertices over a hole are hidden, and so are render triangles that would span a
+// tear, their vertices then sit on triangles that met at a corner of the texture but share no mass.
+// Bindings are cached next to the mesh file and reused while the mesh and the bind pose are unchanged.
+class EmbeddedMesh
+{
+  public:
+    // Read the render mesh, bindings are made by the next bind
+    bool load(const std::string &path);
+    void clear();
+    // Bind to the triangles in their current positions, read from the cache when it matches
+    void bind(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+              TaskScheduler &scheduler);
+    // Find the triangle under every binding again, needed whenever the simulated triangles change
+    void attach(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                TaskScheduler &scheduler);
+
+    bool active() const
+    {
+        return !bindings.empty();
+    }
+    const std::string &getPath() const
+    {
+        return path;
+    }
+    int getVertexCount() const
+    {
+        return mesh.vertexCount();
+    }
+    int getHiddenCount() const
+    {
+        return hidden;
+    }
+    bool boundFromCache() const
+    {
+        return fromCache;
+    }
+    // Render triangles whose vertices are all attached and on the same side of every tear
+    const std::vector<unsigned int> &getIndices() const
+    {
+        return indices;
+    }
+
+    // Simulated triangles carrying at least one render vertex, sorted
+    const std::vector<int> &getAttachedTriangles() const
+    {
+        return attachedTriangles;
+    }
+    // Render vertices as position, normal and the texture coordinate of the mesh, 8 floats each
+    void evaluate(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                  std::vector<float> &vertices, TaskScheduler &scheduler) const;
+
+  private:
+    // Stored in the cache file as is
+    struct Binding
+    {
+        // Texture space point on the simulated surface
+        glm::vec2 material;
+        // Distance along the interpolated normal
+        float offset;
+        // Normal in the tangent, bitangent, normal frame of the triangle
+        glm::vec3 localNormal;
+        // Most negative barycentric weight at bind, vertices beyond the border stay attached that far out
+        float outside;
+    };
+
+    // Key of the mesh and the bind pose, a cache file with another key is rebuilt
+    uint64_t bindKey(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles) const;
+    bool readCache(uint64_t key);
+    void writeCache(uint64_t key) const;
+    std::string cachePath() const;
+
+    std::string path;
+    ObjMesh mesh;
+    std::vector<Binding> bindings;
+    bool fromCache = false;
+
+    // Attachment to the current triangles, -1 for hidden vertices
+    std::vector<int> triangleOf;
+    std::vector<glm::vec3> weights;
+    std::vector<unsigned int> indices;
+    std::vector<int> attachedTriangles;
+    int hidden = 0;
+};
@@ -8,6 +8,8 @@
 
 #include "Cloth.hpp"
 
+class InputJournal;
+
 // Struct to store data from a simulation frame
 struct FrameData
 {
@@ -62,13 +64,21 @@ class ExperimentSystem
   private:
     // Experiment data
     Cloth *cloth;
+    // Every step, reset, resize and setting of the runs goes to the journal when one is recording
+    InputJournal *journal;
     ExperimentLogger logger;
 
     FrameData collectFrameData(float time, double fps);
     void runSimulation(int runNumber, float duration, int logInterval);
 
+    // Cloth changes that are written to the journal first, like the GUI does
+    void journalStep(float dt);
+    void resetCloth();
+    void resizeCloth(float width, float height, int resX, int resY);
+    void freeCloth();
+
   public:
-    ExperimentSystem(Cloth *clothPtr);
+    ExperimentSystem(Cloth *clothPtr, InputJournal *journalPtr = nullptr);
 
     // Run tests
     void exp1_thresholdImpact();
@@ -79,5 +89,9 @@ class ExperimentSystem
     void exp6_solverStability();
     void exp7_meshSizePerf();
     void exp8_springTypes();
+    // Iterations to reach the RMS tolerance with skip springs and with dihedral hinges
+    void exp9_bendingModels();
+    // Spring grid against triangle elements on a coarser grid, stretch and cost per step
+    void exp10_membraneModels();
     void runAllExp();
 };
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AnalysisData.hpp"
+
+struct Mass;
+struct Spring;
+class StructuredGrid;
+class MembraneSystem;
+class TaskScheduler;
+
+// Break rules
+struct FractureParams
+{
+    // Stretch ratio above which a spring is overloaded
+    float threshold = 3.5f;
+    // Consecutive overloaded frames before a spring breaks
+    int framesBeforeBreak = 3;
+    // Accumulated overstretch that breaks a spring even if the overload is not continuous
+    float fatigueLimit = 5.0f;
+};
+
+// Per-spring fracture state, stored as parallel arrays aligned with the spring list
+// A structured grid keeps no dense state, its broken bits live in the grid and only edges that were overloaded
+// are tracked here
+class FractureSystem
+{
+  public:
+    void reset(size_t springCount);
+    // Add intact state for springs appended after reset
+    void grow(size_t springCount);
+
+    // Stretch ratio written by the last solver iteration
+    void setStrain(int spring, float stretchRatio)
+    {
+        strain[spring] = stretchRatio;
+    }
+    float getStrain(int spring) const
+    {
+        return strain[spring];
+    }
+    float getDamage(int spring) const
+    {
+        return damage[spring];
+    }
+
+    // Flag springs from [begin, end), touches only their own slots so ranges can run in parallel
+    void detectRange(int begin, int end, const std::vector<Mass> &masses, const std::vector<Spring> &springs,
+                     const FractureParams &params);
+    void detectRange(int begin, int end, const std::vector<Mass> &masses, const MembraneSystem &membrane,
+                     const FractureParams &params);
+    // Collect flagged springs into the batched event list, returns number of new breaks
+    int collectEvents(const std::vector<Mass> &masses, const std::vector<Spring> &springs, float simulationTime);
+    int collectEvents(const std::vector<Mass> &masses, const MembraneSystem &membrane, float simulationTime);
+
+    // Measure the stretch of every intact grid edge from the positions and break edges in the grid, edges
+    // appear in the overload list the first time they are overstretched, returns number of new breaks
+    int checkGrid(const std::vector<Mass> &masses, StructuredGrid &grid, const FractureParams &params,
+                  float simulationTime, TaskScheduler &scheduler);
+    // Dense state for the springs of a grid that became explicit, overloaded edges keep their counters
+    void expandGrid(size_t springCount);
+
+    // Mark spring for removal outside of the tension check (cutting, dragging)
+    void markBroken(int spring);
+    bool isBroken(int spring) const
+    {
+        return broken[spring] != 0;
+    }
+    bool hasBroken() const
+    {
+        return !pending.empty();
+    }
+    int size() const
+    {
+        return static_cast<int>(broken.size());
+    }
+
+    // Items broken since the last removal, largest first, the pending list is emptied
+    void takeBroken(std::vector<int> &items);
+    // Pairs with a swap of item slot with the back: the state of the last item moves into slot and the last
+    // slot is dropped
+    void removeSlot(int slot);
+    // Remove flagged springs and keep the state arrays aligned
+    void compact(std::vector<Spring> &springs);
+    // Reorder springs and their state, order[i] is the old index of the new spring i
+    void permute(std::vector<Spring> &springs, const std::vector<int> &order);
+
+    const std::vector<SpringBreakEvent> &getEvents() const
+    {
+        return events;
+    }
+    void clearEvents()
+    {
+        events.clear();
+    }
+
+  private:
+    // Grid edge that has been overstretched, sorted by edge
+    struct Overload
+    {
+        int edge;
+        int tensionCounter;
+        float damage;
+    };
+    // Grid edge found above the threshold by the last measure
+    struct Stretch
+    {
+        int edge;
+        float stretchRatio;
+    };
+
+    template <typename Endpoints>
+    void detect(int begin, int end, const std::vector<Mass> &masses, Endpoints &&endpoints,
+                const FractureParams &params);
+    // Compact the first count slots, Move: void(int from, int to) for every kept item that moves down,
+    // returns the kept count
+    template <typename Move> int compactWith(int count, Move &&move);
+    template <typename Endpoints>
+    int collect(const std::vector<Mass> &masses, Endpoints &&endpoints, float simulationTime);
+
+    std::vector<float> strain;
+    std::vector<int> tensionCounter;
+    std::vector<float> damage;
+    std::vector<uint8_t> broken;
+
+    std::vector<Overload> overloads;
+    std::vector<Overload> mergedOverloads;
+    // Indexed by measured row range, each range fills its own list
+    std::vector<std::vector<Stretch>> rangeStretches;
+    std::vector<Stretch> stretches;
+
+    // Broken items not yet removed, in the order they broke
+    std::vector<int> pending;
+    std::vector<SpringBreakEvent> events;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Linear allocator for scratch data that lives for one simulation step
+// Containers use it through std::pmr allocators, deallocation is a no-op and everything is dropped by reset()
+// A frame that runs out of space spills into the heap and the block grows to the peak on the next reset,
+// so a steady simulation stops allocating after the first frames. Not thread safe.
+class FrameArena : public std::pmr::memory_resource
+{
+  public:
+    explicit FrameArena(size_t initialCapacity = 64 * 1024);
+    ~FrameArena() override;
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // Everything allocated since the last reset becomes invalid
+    void reset();
+
+    size_t getUsedBytes() const
+    {
+        return used + spilledBytes;
+    }
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+  private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    struct Spill
+    {
+        void *pointer;
+        size_t bytes;
+        size_t alignment;
+    };
+
+    std::byte *block = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    // Heap allocations made after the block was full
+    std::vector<Spill> spills;
+    size_t spilledBytes = 0;
+};
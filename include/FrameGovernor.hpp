@@ -0,0 +1,109 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+// Limits of the governor, the cloth settings never leave them
+struct GovernorParams
+{
+    bool enabled = false;
+    float budgetMs = 8.0f;
+    // Dead band around the budget as a fraction of it, nothing changes inside it
+    float hysteresis = 0.2f;
+    int minIterations = 2;
+    int maxIterations = 20;
+    int minSubsteps = 1;
+    int maxSubsteps = 4;
+    // Frames between statistics passes
+    int maxAnalysisInterval = 8;
+    // Frames to wait after an adjustment, so the averaged time reflects it
+    int cooldownFrames = 15;
+    // Frames the averaged time must stay under the band before each restore step
+    int restoreFrames = 30;
+    // Reduced settings come back highest priority first, newest first among equals. Substeps have 2 and
+    // iterations 1, so by default the statistics cadence returns last, the reverse of the reduction order
+    int analysisRestorePriority = 0;
+};
+
+enum class GovernorKnob
+{
+    ITERATIONS,
+    SUBSTEPS,
+    ANALYSIS_INTERVAL
+};
+
+struct GovernorAdjustment
+{
+    float time;
+    // Averaged step time that triggered the adjustment
+    float stepMs;
+    float budgetMs;
+    GovernorKnob knob;
+    int from;
+    int to;
+};
+
+// Cloth settings the governor may change
+struct GovernedSettings
+{
+    int iterations;
+    int substeps;
+    int analysisInterval;
+};
+
+// Keeps the step time of the cloth near a budget
+// Over the band the cheapest loss of quality comes first: statistics cadence, then iterations, then substeps.
+// Under the band each reduction is undone in reverse, after the time stayed there for a while and only when the
+// time scaled by the change still fits the budget. A restore that has to be cut again doubles the wait.
+class FrameGovernor
+{
+  public:
+    void setParams(const GovernorParams &params);
+    const GovernorParams &getParams() const
+    {
+        return params;
+    }
+
+    // Feed the duration of the last step, returns true when settings were changed
+    bool update(float stepMs, float simulationTime, GovernedSettings &settings);
+
+    float getAverageMs() const
+    {
+        return averageMs;
+    }
+    // Oldest adjustments drop off once the log is full
+    const std::deque<GovernorAdjustment> &getAdjustments() const
+    {
+        return adjustments;
+    }
+    void clearAdjustments();
+    std::string exportToCSV() const;
+
+    static const char *knobName(GovernorKnob knob);
+
+  private:
+    // Setting lowered by the governor and the value it had before
+    struct Reduction
+    {
+        GovernorKnob knob;
+        int from;
+    };
+
+    bool reduce(GovernedSettings &settings, float simulationTime);
+    bool restore(GovernedSettings &settings, float simulationTime);
+    void record(float simulationTime, GovernorKnob knob, int from, int to);
+    int restorePriority(GovernorKnob knob) const;
+
+    GovernorParams params;
+    float averageMs = 0.0f;
+    bool hasAverage = false;
+    int cooldown = 0;
+    // Frames spent under the band since the last adjustment
+    int underBand = 0;
+    // Frames since the last restore that was not cut again, -1 when there is none, and the factor on the wait
+    int sinceRestore = -1;
+    int restoreBackoff = 1;
+    std::vector<Reduction> reductions;
+    std::deque<GovernorAdjustment> adjustments;
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "Cloth.hpp"
+
+class Ray;
+
+// Scene a journal starts from, written to its header so a replay builds the same cloth
+struct JournalSetup
+{
+    float width = 4.0f;
+    float height = 4.0f;
+    int resX = 30;
+    int resY = 30;
+    float floorY = -10.0f;
+    // Collision cube, enabling it is part of the recorded settings
+    glm::vec3 cubeCenter = glm::vec3(0.0f, -2.0f, 0.0f);
+    glm::vec3 cubeSize = glm::vec3(2.0f);
+    // Empty for the grid
+    std::string clothMesh;
+    MeshImportParams meshImport;
+    int threadCount = 0;
+    bool deterministic = false;
+};
+
+// Kinds of journal records
+enum class JournalEvent : uint8_t
+{
+    STEP,
+    PICK,
+    DRAG,
+    RELEASE,
+    CUT,
+    SETTINGS,
+    RESET,
+    FREE,
+    ORIENTATION,
+    RESIZE,
+    REORDER,
+    PREVIEW_TRAINING,
+    CLOTH_MESH,
+    CHECKSUM
+};
+
+// Groups of cloth settings, one record holds the whole group when any field of it changed
+enum class SettingsBlock : uint8_t
+{
+    SOLVER,
+    PHYSICAL,
+    INTERACTION,
+    TOPOLOGY,
+    TIMESTEP,
+    CONVERGENCE,
+    SCHEDULE,
+    MEMBRANE,
+    TETHER,
+    PREVIEW,
+    REFINEMENT,
+    GOVERNOR,
+    FORCES,
+    COUNT
+};
+
+// Binary log of every input that changes the simulation, one record per event tagged with its frame
+// Interactions are written when they happen, with everything the cloth needs to repeat them. Sliders,
+// key toggles and force edits are not hooked one by one: before every record the settings of the cloth
+// are captured and the groups that differ from the last capture are written first, so a replay sees
+// each change in the order it happened whatever part of the program made it. Every CHECKSUM_INTERVAL
+// frames a hash of the mass positions goes in as well, the replay compares it to prove the run is exact.
+class InputJournal
+{
+  public:
+    static const int CHECKSUM_INTERVAL = 60;
+
+    ~InputJournal();
+
+    // Starts recording, the cloth must already be in the state the setup describes
+    bool open(const std::string &path, Cloth &cloth, const JournalSetup &setup);
+    void close();
+    bool isRecording() const
+    {
+        return cloth != nullptr;
+    }
+
+    // Called once per frame before any input is handled
+    void beginFrame();
+    void recordStep(float dt);
+    void recordPick(const Ray &ray);
+    void recordDrag(int index, const glm::vec3 &position);
+    void recordRelease(int index);
+    void recordCut(const Ray &ray, const glm::vec3 &previousMousePos, const glm::mat4 &view,
+                   const glm::mat4 &projection, int screenWidth, int screenHeight);
+    void recordReset();
+    void recordFree();
+    void recordOrientation(Cloth::ClothOrientation orientation);
+    void recordResize(float width, float height, int resX, int resY);
+    void recordReorder();
+    void recordPreviewTraining();
+    void recordClothMesh(const std::string &path, const MeshImportParams &params);
+
+    // Hash of the mass positions, the same bits give the same value
+    static uint64_t checksum(const Cloth &cloth);
+
+  private:
+    void flushSettings();
+    void write(JournalEvent event, const std::string &payload);
+
+    std::ofstream file;
+    Cloth *cloth = nullptr;
+    int frame = 0;
+    std::array<std::string, static_cast<size_t>(SettingsBlock::COUNT)> lastSettings;
+};
+
+// Timing of one replayed frame
+struct ReplayFrame
+{
+    int frame;
+    double ms;
+    int events;
+};
+
+// Runs a journal on a headless cloth and reports the time of every frame
+// Replays use the thread count and scheduling mode of the recording unless told otherwise, the frame
+// governor stays off because its decisions are already in the recorded settings.
+class JournalReplay
+{
+  public:
+    // threadCount below zero keeps the recorded one, deterministic forces the ordered scheduler
+    JournalReplay(const std::string &path, int threadCount, bool deterministic);
+
+    // Returns the process exit code, 0 when the journal ran and every checksum matched
+    int run();
+
+  private:
+    void printSummary() const;
+    bool writeCSV(const std::string &csvPath) const;
+
+    std::string path;
+    int threadCount;
+    bool deterministic;
+    std::vector<ReplayFrame> frames;
+    int checksums = 0;
+    // First frame whose checksum differed, -1 while the run is exact
+    int divergedFrame = -1;
+};
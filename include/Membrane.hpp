@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "ConstraintColoring.hpp"
+
+struct Mass;
+struct SolverPass;
+struct SolverResidual;
+struct SpringMaterial;
+class FractureSystem;
+
+// How the cloth resists stretch and shear in its plane, applied on the next reset
+enum class MembraneModel
+{
+    // Structural and shear springs along the grid
+    MASS_SPRING,
+    // Co-rotational triangle elements over the render triangulation
+    COROTATIONAL
+};
+
+// Anisotropy of the triangle elements, scales the structural stiffness along each thread direction
+struct MembraneParams
+{
+    // Along u of the texture, the rows of the grid
+    float warpScale = 1.0f;
+    // Along v of the texture, the columns of the grid
+    float weftScale = 1.0f;
+};
+
+// Co-rotational constant strain triangles solved as position constraints
+// The rest shape of every triangle is its texture triangle scaled to the cloth size, which is the layout
+// initCloth places the masses in. A projection splits the deformation gradient into a rotation and a
+// symmetric stretch, relaxes the warp, weft and shear stretch by the stiffness of their spring family
+// and moves the free corners onto the rotated target shape.
+// Element i belongs to triangle i, so the fracture state of the cloth stays aligned with the triangles.
+class MembraneSystem
+{
+  public:
+    // One element per triangle, restSize scales texture coordinates to rest lengths
+    void build(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+               const glm::vec2 &restSize);
+    void clear();
+    // Pairs with a swap of triangle element with the back of the triangle list, the rest shape of the others is
+    // kept
+    void removeElement(int element);
+    // Corner moved to a copy of its mass, the copy has the same texture coordinates
+    void replaceCorner(int element, int from, int to);
+
+    bool active() const
+    {
+        return !elements.empty();
+    }
+    int getElementCount() const
+    {
+        return static_cast<int>(elements.size());
+    }
+    // Two corners of the element, break events are placed between them
+    void endpoints(int element, int &a, int &b) const
+    {
+        a = elements[element].a;
+        b = elements[element].b;
+    }
+
+    // One Gauss-Seidel sweep color by color, materials indexed by SpringFamily give the stiffness
+    // Pinned false skips the fixed checks, only valid when no mass is fixed
+    // Fracture receives the largest principal stretch of every element before its correction
+    void solveIteration(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                        const SolverPass &pass, const MembraneParams &params, float maxStretchRatio,
+                        FractureSystem *fracture, bool pinned, TaskScheduler &scheduler,
+                        SolverResidual *residualOut = nullptr) const;
+    // Largest principal stretch of one element, 1 at rest and for collapsed elements
+    float principalStretch(const std::vector<Mass> &masses, int element) const;
+
+  private:
+    struct Element
+    {
+        int a, b, c;
+        // Inverse of the rest edge matrix [b - a, c - a] in rest coordinates
+        glm::mat2 restInverse;
+        // Rest positions of b and c relative to a
+        glm::vec2 restB, restC;
+        // Degenerate rest triangles keep their slot but are never projected
+        bool valid;
+    };
+
+    // Relaxation of the three stretch components of one pass
+    struct Relaxation
+    {
+        float warp, weft, shear;
+    };
+
+    template <bool Pinned, bool Record>
+    void solve(std::vector<Mass> &masses, const Relaxation &relaxation, float maxStretchRatio,
+               FractureSystem *fracture, SolverResidual *residual, int begin, int end) const;
+
+    std::vector<Element> elements;
+    ConstraintColoring coloring;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Triangle mesh read from a Wavefront OBJ file
+// Every distinct position, texture coordinate and normal combination of the faces becomes one vertex,
+// polygons are split into fans. Missing texture coordinates are zero, missing normals are averaged
+// from the faces. The file is parsed in one pass over its text, linear in its size.
+struct ObjMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+    // Position line of the file every vertex came from, vertices split by a texture seam share it
+    std::vector<int> positionIndex;
+    int positionCount = 0;
+    // Names of the g groups and the group of every triangle, -1 before the first group
+    std::vector<std::string> groups;
+    std::vector<int> triangleGroups;
+
+    // False with a message on stderr when the file cannot be read or has no faces
+    bool load(const std::string &path);
+    void clear();
+
+    int vertexCount() const
+    {
+        return static_cast<int>(positions.size());
+    }
+    int triangleCount() const
+    {
+        return static_cast<int>(indices.size() / 3);
+    }
+    // Index of the group, -1 when no group has that name
+    int findGroup(const std::string &name) const;
+};
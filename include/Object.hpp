@@ -39,6 +39,7 @@ struct FaceCenters
 class Cube : public Object
 {
   public:
+    // Without a texture path the cube only collides and never touches OpenGL, for headless runs
     Cube(const glm::vec3 &center, const glm::vec3 &size, const char *texturePath);
     ~Cube();
 
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Layout of the sharded run, every shard process builds the same cloth from it
+struct ShardSettings
+{
+    int shardCount = 2;
+    int frames = 600;
+    int resX = 30;
+    int resY = 30;
+    float width = 4.0f;
+    float height = 4.0f;
+    float floorY = -10.0f;
+    float timeStep = 1.0f / 60.0f;
+    // Scheduler threads inside every shard
+    int threadsPerShard = 1;
+    bool tiledSolver = false;
+};
+
+struct ShardSegment;
+
+// Runs one cloth over several processes on the local host
+// The cloth is cut into strips of grid rows, one shard process per strip. Every shard simulates its rows plus
+// pinned halo rows of its neighbours. Boundary rows go through a POSIX shared memory segment that holds two
+// position slots: frame f reads slot f % 2 and writes slot (f + 1) % 2, so a single futex barrier per frame
+// keeps the processes in step. The coordinator forks the shards, reports progress and stops every shard as
+// soon as one of them fails.
+class ShardCoordinator
+{
+  public:
+    explicit ShardCoordinator(const ShardSettings &settings);
+    ~ShardCoordinator();
+
+    ShardCoordinator(const ShardCoordinator &) = delete;
+    ShardCoordinator &operator=(const ShardCoordinator &) = delete;
+
+    // Must be called before anything starts threads, shards are forked from the calling process
+    // Returns the process exit code, 0 when every shard finished all frames
+    int run();
+
+  private:
+    bool createSegment();
+    void destroySegment();
+    bool launchShards();
+    bool monitor();
+    void abortShards();
+    void printSummary() const;
+
+    // Body of a shard process, returns its exit code
+    int runShard(int shard);
+
+    ShardSettings settings;
+    std::string segmentName;
+    ShardSegment *segment = nullptr;
+    size_t segmentBytes = 0;
+    // Process id per shard, -1 once it was reaped
+    std::vector<int> shardPids;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct Mass;
+struct Spring;
+struct SpringMaterial;
+struct SolverResidual;
+struct SolverPass;
+
+// Topology of a regular resX x resY cloth, springs follow the initCloth stencil and only broken flags are stored
+// Edge ids use the same order as the explicit springs built by initCloth: structural rows, structural columns,
+// shear pairs per cell, bending rows, bending columns
+class StructuredGrid
+{
+  public:
+    // Offsets of the stencil, both diagonals of a cell share one block
+    enum Stencil
+    {
+        RIGHT,
+        DOWN,
+        DIAGONAL,
+        ANTI_DIAGONAL,
+        RIGHT_2,
+        DOWN_2,
+        STENCIL_COUNT
+    };
+
+    // Take rest lengths and materials from the explicit springs of a fresh grid
+    // Without skip springs the RIGHT_2 and DOWN_2 stencils stay empty
+    void build(int resX, int resY, const std::vector<Spring> &springs, bool skipSprings = true);
+    void clear();
+
+    bool active() const
+    {
+        return resX > 0;
+    }
+    int edgeCount() const
+    {
+        return totalEdges;
+    }
+    int rowCount() const
+    {
+        return resY;
+    }
+    int intactCount() const
+    {
+        return totalEdges - brokenEdges;
+    }
+
+    void endpoints(int edge, int &a, int &b) const;
+    // Edge id between two masses, -1 if they are not neighbours in the stencil
+    int edgeBetween(int a, int b) const;
+    float restLength(int edge) const;
+
+    bool isBroken(int edge) const
+    {
+        return (brokenBits[edge >> 6] >> (edge & 63)) & 1u;
+    }
+    void breakEdge(int edge);
+
+    // Row sweeps over the stencil, same projection and force as the explicit solver
+    // Pinned false skips the fixed checks, only valid when no mass is fixed
+    void applyForces(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                     bool pinned = true) const;
+    // Stencil blocks of families outside the pass are skipped whole
+    // The violation before each correction is accumulated into residualOut when it is set
+    void solveIteration(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                        const SolverPass &pass, float maxStretchRatio, bool pinned = true,
+                        SolverResidual *residualOut = nullptr) const;
+
+    // Row passes solve on structure-of-arrays positions in runs of edges that share no mass, so every run is a
+    // loop without carried dependencies. Edges are visited in another order than the explicit springs.
+    void setRowPasses(bool enabled)
+    {
+        rowPasses = enabled;
+    }
+    bool getRowPasses() const
+    {
+        return rowPasses;
+    }
+
+    // Explicit springs for every edge, broken ones included so ids stay aligned
+    void toSprings(std::vector<Spring> &springs) const;
+    // Intact springs of one mass
+    void springsAround(int mass, std::vector<Spring> &springs) const;
+
+    // Visitor: void(int edge, int a, int b, float restLength, int material), broken edges are skipped
+    template <typename Visitor> void forEachEdge(Visitor &&visit) const
+    {
+        forEachEdge(0, resY, visit);
+    }
+    // Edges whose first endpoint lies in rows [firstRow, lastRow), disjoint row ranges visit disjoint edges
+    template <typename Visitor> void forEachEdge(int firstRow, int lastRow, Visitor &&visit) const
+    {
+        for (int s = 0; s < STENCIL_COUNT; s++)
+        {
+            const Block &block = blocks[s];
+            for (int y = firstRow; y < lastRow && y < block.rows; y++)
+            {
+                for (int x = 0; x < block.columns; x++)
+                {
+                    int edge = edgeId(s, x, y);
+                    if (isBroken(edge))
+                        continue;
+
+                    int a = (y * resX + x) + block.startOffset;
+                    visit(edge, a, a + block.offset, block.restLength, block.material);
+                }
+            }
+        }
+    }
+
+  private:
+    struct Block
+    {
+        // First edge id and grid range of the stencil
+        int firstEdge = 0;
+        int columns = 0;
+        int rows = 0;
+        // Mass offsets: first endpoint = cell + startOffset, second = first + offset
+        int startOffset = 0;
+        int offset = 0;
+        float restLength = 1.0f;
+        int material = 0;
+    };
+
+    int resX = 0, resY = 0;
+    int totalEdges = 0;
+    int brokenEdges = 0;
+    Block blocks[STENCIL_COUNT];
+    std::vector<uint64_t> brokenBits;
+    bool rowPasses = false;
+    // Positions of the row passes, weight is zero for pinned masses
+    mutable std::vector<float> rowX, rowY, rowZ, rowWeight;
+
+    // Kernel: void(int edge, Mass &a, Mass &b, float restLength, int material), intact edges in id order
+    // Stencils: bit per Stencil, both diagonals follow the DIAGONAL bit
+    template <typename Kernel>
+    void sweep(std::vector<Mass> &masses, Kernel &&kernel, unsigned stencils = (1u << STENCIL_COUNT) - 1) const;
+    template <bool Pinned>
+    void solve(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials, const SolverPass &pass,
+               float maxStretchRatio, SolverResidual *residualOut) const;
+    template <bool Pinned>
+    void solveRows(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials, const SolverPass &pass,
+                   float maxStretchRatio, SolverResidual *residualOut) const;
+    int stencilOf(int edge) const;
+    int edgeId(int stencil, int x, int y) const
+    {
+        // Shear edges of one cell are stored next to each other
+        if (stencil == DIAGONAL || stencil == ANTI_DIAGONAL)
+            return blocks[DIAGONAL].firstEdge + 2 * (y * blocks[DIAGONAL].columns + x) + (stencil - DIAGONAL);
+        return blocks[stencil].firstEdge + y * blocks[stencil].columns + x;
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Mass;
+class TaskScheduler;
+
+// Rules of the reduced preview
+struct PreviewParams
+{
+    bool enabled = false;
+    // Full steps recorded as the example simulation
+    int trainingFrames = 120;
+    int maxModes = 24;
+    // Fraction of the snapshot variance the kept modes must explain
+    float energy = 0.999f;
+    // Regularization of the fitted dynamics, relative to the mean of the normal matrix diagonal
+    float ridge = 1e-4f;
+    // Modes may leave the range seen in training by this fraction of it
+    float margin = 0.25f;
+};
+
+// Reduced order model of the current cloth for fast previews while forces are tuned
+// Snapshots of full steps give a PCA basis, the modes of largest variance around the mean shape.
+// The internal dynamics of the modes are fitted to the recorded steps as one linear map of the modal
+// coordinates and velocities, while the external forces enter through Newton's law, so changing them
+// moves the preview the way it would move the full cloth. A step costs a few small matrix products,
+// rebuilding the positions is one matrix-vector product over the cloth.
+// The model only describes the topology and pins it was trained on, callers fall back to the full solver
+// once they change.
+class SubspacePreview
+{
+  public:
+    // Start recording, every following full step adds one snapshot until trainingFrames are in
+    void startTraining(const std::vector<Mass> &masses, int topology, int pins, const PreviewParams &params);
+    // Snapshot after a full step that moved the masses by acceleration over dt, returns true once the model
+    // has been built from the last snapshot
+    bool record(const std::vector<Mass> &masses, const glm::vec3 &acceleration, float dt, TaskScheduler &scheduler);
+    void clear();
+
+    bool isTraining() const
+    {
+        return training;
+    }
+    int getRecordedFrames() const
+    {
+        return recorded;
+    }
+    bool ready() const
+    {
+        return modeCount > 0;
+    }
+    // Recording or model belongs to this state of the cloth
+    bool trainedOn(int topology, int pins, int massCount) const
+    {
+        return topology == trainedTopology && pins == trainedPins && massCount == trainedMassCount;
+    }
+    bool matches(int topology, int pins, int massCount) const
+    {
+        return ready() && trainedOn(topology, pins, massCount);
+    }
+    int getModeCount() const
+    {
+        return modeCount;
+    }
+    // Fraction of the snapshot variance the kept modes explain
+    float getExplainedVariance() const
+    {
+        return explainedVariance;
+    }
+    float getTrainingDt() const
+    {
+        return trainingDt;
+    }
+
+    // Project the current state, called when the preview takes over from the full solver
+    void begin(const std::vector<Mass> &masses);
+    // One reduced step of the training step size, every free mass accelerated by acceleration
+    void step(const glm::vec3 &acceleration);
+    // Rebuild the positions from the modal coordinates, the previous positions keep the last frame
+    void reconstruct(std::vector<Mass> &masses, TaskScheduler &scheduler) const;
+
+  private:
+    void build(TaskScheduler &scheduler);
+    // Modal coordinates of positions, or of prevPositions when previous is set
+    void project(const std::vector<Mass> &masses, bool previous, std::vector<float> &out) const;
+
+    PreviewParams params;
+    bool training = false;
+    int recorded = 0;
+    int trainedTopology = -1;
+    int trainedPins = -1;
+    int trainedMassCount = -1;
+
+    // Training data, released once the model is built
+    std::vector<float> snapshots;
+    std::vector<glm::vec3> accelerations;
+    std::vector<float> stepSizes;
+
+    int modeCount = 0;
+    float explainedVariance = 0.0f;
+    float trainingDt = 0.016f;
+    // Mean shape and modes, all masses in xyz order, mode m starts at m * 3 * massCount
+    std::vector<float> mean;
+    std::vector<float> basis;
+    // Response of the modes to a unit acceleration of all free masses along x, y and z
+    std::vector<glm::vec3> forceResponse;
+    // Fitted step: q' = q + A q + B (q - qPrevious) + c, A and B row major
+    std::vector<float> stiffness;
+    std::vector<float> damping;
+    std::vector<float> offset;
+    // Range of every mode in training, widened by the margin
+    std::vector<float> lower;
+    std::vector<float> upper;
+
+    std::vector<float> coordinates;
+    std::vector<float> previousCoordinates;
+    std::vector<float> nextCoordinates;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+struct Mass;
+class TaskScheduler;
+
+// Render mesh finer than the simulated one
+struct SubdivisionParams
+{
+    bool enabled = false;
+    // Pieces every simulated triangle edge is split into, 4 renders a 50x50 cloth like a 200x200 one
+    int segments = 4;
+};
+
+// Curved point normal triangles over the simulated triangles, evaluated for display only
+// Every triangle becomes a cubic patch from its corner positions and normals, with quadratic normals
+// across it. A patch edge only depends on the two corners it joins, so neighbouring patches meet without
+// cracks, and a torn edge has no triangle on the far side to bend the surface across the tear.
+// The fine vertices of a patch are fixed blends of its control points, evaluated in lanes over the
+// vertices of the patch.
+class SurfaceSubdivision
+{
+  public:
+    static constexpr int MAX_SEGMENTS = 8;
+
+    // Fine triangles and blend weights for the simulated triangles, needed again when they change
+    void build(int triangleCount, int segments);
+    void clear();
+
+    bool active() const
+    {
+        return !indices.empty();
+    }
+    int getSegments() const
+    {
+        return segments;
+    }
+    // Fine triangles, patch t owns the vertices from t * getPatchVertexCount()
+    const std::vector<unsigned int> &getIndices() const
+    {
+        return indices;
+    }
+    int getPatchVertexCount() const
+    {
+        return patchVertices;
+    }
+
+    // Fine vertices as position, normal and texture coordinate, 8 floats each like the simulated ones
+    void evaluate(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                  std::vector<float> &vertices, TaskScheduler &scheduler) const;
+
+  private:
+    // Weights by control point, then by patch vertex, so a control point is blended into all vertices at once
+    enum
+    {
+        CUBIC_POINTS = 10,
+        QUADRATIC_POINTS = 6
+    };
+
+    int segments = 0;
+    int patchVertices = 0;
+    std::vector<unsigned int> indices;
+    std::vector<float> positionWeights;
+    std::vector<float> normalWeights;
+    // Barycentric weights of the second and third corner, for the texture coordinates
+    std::vector<float> towardB;
+    std::vector<float> towardC;
+};
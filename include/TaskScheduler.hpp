@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class TaskScheduler;
+
+// Counter of unfinished tasks, wait() on the scheduler returns once it drops to zero
+class TaskGroup
+{
+  public:
+    bool done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class TaskScheduler;
+    std::atomic<int> pending{0};
+};
+
+// Work unit, a function pointer and a range so submitting never allocates
+struct Task
+{
+    void (*run)(void *context, int begin, int end) = nullptr;
+    void *context = nullptr;
+    int begin = 0;
+    int end = 0;
+    TaskGroup *group = nullptr;
+};
+
+// Work-stealing scheduler shared by the whole program
+// Every thread owns a deque, it pops its own newest task and steals the oldest task of others.
+// The thread that waits on a group keeps running tasks, so nested parallel loops cannot deadlock.
+class TaskScheduler
+{
+  public:
+    // Shared instance, sized from the hardware concurrency until setThreadCount is called
+    static TaskScheduler &instance();
+
+    explicit TaskScheduler(int threadCount = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler &) = delete;
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    // Restart the workers, 0 uses the hardware concurrency, the calling thread counts as one
+    void setThreadCount(int threadCount);
+    int getThreadCount() const
+    {
+        return static_cast<int>(queues.size());
+    }
+
+    // Run everything on the calling thread in submission order, for reproducible experiments
+    void setDeterministic(bool enabled)
+    {
+        deterministic = enabled;
+    }
+    bool isDeterministic() const
+    {
+        return deterministic;
+    }
+
+    void submit(TaskGroup &group, const Task &task);
+    // Help with queued tasks until the group is finished
+    void wait(TaskGroup &group);
+
+    // Body: void(int begin, int end), called on chunks of at most grain items
+    // Chunks depend only on the range and grain, so race-free bodies give the same result on any thread count
+    template <typename Body> void parallelFor(int begin, int end, int grain, Body &&body)
+    {
+        grain = std::max(grain, 1);
+        if (end - begin <= grain || deterministic || queues.size() == 1)
+        {
+            for (int chunk = begin; chunk < end; chunk += grain)
+                body(chunk, std::min(chunk + grain, end));
+            return;
+        }
+
+        using BodyType = std::remove_reference_t<Body>;
+        TaskGroup group;
+        for (int chunk = begin; chunk < end; chunk += grain)
+        {
+            Task task;
+            task.run = [](void *context, int first, int last) { (*static_cast<BodyType *>(context))(first, last); };
+            task.context = const_cast<void *>(static_cast<const void *>(&body));
+            task.begin = chunk;
+            task.end = std::min(chunk + grain, end);
+            submit(group, task);
+        }
+        wait(group);
+    }
+
+    // Map: T(int begin, int end) over a chunk, Combine: T(T, T)
+    // Partial results are combined in chunk order, the sum does not depend on scheduling
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(int begin, int end, int grain, T identity, Map &&map, Combine &&combine)
+    {
+        const int count = end - begin;
+        if (count <= 0)
+            return identity;
+
+        // Chunk count is bounded so the partials fit on the stack
+        const int maxChunks = 64;
+        grain = std::max({grain, 1, (count + maxChunks - 1) / maxChunks});
+        const int chunks = (count + grain - 1) / grain;
+
+        T partials[maxChunks];
+        parallelFor(0, chunks, 1, [&](int first, int last) {
+            for (int c = first; c < last; c++)
+                partials[c] = map(begin + c * grain, std::min(begin + (c + 1) * grain, end));
+        });
+
+        T result = identity;
+        for (int c = 0; c < chunks; c++)
+            result = combine(result, partials[c]);
+        return result;
+    }
+
+  private:
+    // Ring buffer guarded by a mutex, it only grows so a steady workload stops allocating
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t head = 0;
+        size_t count = 0;
+
+        void push(const Task &task);
+        bool popBack(Task &task);
+        bool popFront(Task &task);
+    };
+
+    void start(int threadCount);
+    void stop();
+    void workerLoop(int index);
+    bool findTask(int index, Task &task);
+    void execute(const Task &task);
+    int currentQueue() const;
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool deterministic = false;
+};
+
+// Tasks with dependencies, nodes run once all their predecessors finished
+// Node storage comes from the given memory resource, bodies must outlive run()
+class TaskGraph
+{
+  public:
+    explicit TaskGraph(std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    ~TaskGraph();
+
+    TaskGraph(const TaskGraph &) = delete;
+    TaskGraph &operator=(const TaskGraph &) = delete;
+
+    // Body: void()
+    template <typename Body> int add(Body &body)
+    {
+        Node node;
+        node.run = [](void *context, int, int) { (*static_cast<Body *>(context))(); };
+        node.context = &body;
+        nodes.push_back(node);
+        return static_cast<int>(nodes.size()) - 1;
+    }
+    void precede(int before, int after);
+
+    // Blocks until every node ran, nodes without dependencies start first in insertion order
+    void run(TaskScheduler &scheduler);
+
+  private:
+    struct Node
+    {
+        void (*run)(void *context, int begin, int end) = nullptr;
+        void *context = nullptr;
+        int predecessors = 0;
+    };
+
+    static void runNode(void *context, int node, int);
+    void release(int node);
+
+    std::pmr::memory_resource *memory;
+    std::pmr::vector<Node> nodes;
+    // Pairs of (before, after), sorted by before when the graph runs
+    std::pmr::vector<std::pair<int, int>> edges;
+    std::pmr::vector<int> firstEdge;
+    // Unfinished predecessors per node while the graph runs
+    std::atomic<int> *remaining = nullptr;
+    size_t remainingCount = 0;
+    TaskScheduler *scheduler = nullptr;
+    TaskGroup group;
+};
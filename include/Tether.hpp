@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+struct Mass;
+struct Spring;
+class StructuredGrid;
+class TaskScheduler;
+
+// Long range attachment rules
+struct TetherParams
+{
+    bool enabled = false;
+    // Tether length over the rest distance, 1 keeps the path to the anchor inextensible
+    float slack = 1.0f;
+};
+
+// Unilateral distance limit from every free mass to its nearest pinned mass
+// Distances follow the edges of the rest mesh, so a region torn off from every pin gets no tether
+// and one still hanging by a thin strip keeps the longer way around the tear.
+class TetherSystem
+{
+  public:
+    void build(const std::vector<Mass> &masses, const std::vector<Spring> &springs);
+    void build(const std::vector<Mass> &masses, const StructuredGrid &grid);
+    // Triangle edges as the rest mesh, restSize scales texture coordinates to rest lengths
+    void build(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles, const glm::vec2 &restSize);
+    void clear();
+
+    bool active() const
+    {
+        return !tethers.empty();
+    }
+    int getTetherCount() const
+    {
+        return static_cast<int>(tethers.size());
+    }
+    // Free masses without a path to any pin
+    int getUnanchoredCount() const
+    {
+        return unanchored;
+    }
+
+    // Masses farther from their anchor than the tether allows are moved back onto the limit
+    void project(std::vector<Mass> &masses, float slack, TaskScheduler &scheduler) const;
+
+  private:
+    struct Tether
+    {
+        int mass;
+        int anchor;
+        float length;
+    };
+
+    // Visit: void(Emit), Emit: void(int id, int a, int b, float restLength, int material)
+    template <typename ForEach> void buildFrom(const std::vector<Mass> &masses, ForEach &&forEach);
+
+    std::vector<Tether> tethers;
+    int unanchored = 0;
+
+    // Dijkstra scratch, kept between rebuilds
+    std::vector<int> edgeStart;
+    std::vector<std::pair<int, float>> edges;
+    std::vector<float> distance;
+    std::vector<int> nearestAnchor;
+    std::vector<std::pair<float, int>> heap;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Mass;
+struct Spring;
+struct SpringMaterial;
+struct SolverResidual;
+struct SolverPass;
+class FractureSystem;
+class StructuredGrid;
+class TaskScheduler;
+
+// Constraint solver over rectangular tiles of the rest domain, one scheduler task per tile
+// Every tile runs Gauss-Seidel on a private copy of its masses, including a halo of the neighbours it touches.
+// After each iteration owned masses take the tile result, boundary masses average the corrections of all copies.
+class TileSolver
+{
+  public:
+    // Partition by rest coordinates, cuts follow the spring count so tiles carry similar work
+    void build(const std::vector<Mass> &masses, const std::vector<Spring> &springs, int tileCount);
+    void build(const std::vector<Mass> &masses, const StructuredGrid &grid, int tileCount);
+    void clear();
+
+    bool active() const
+    {
+        return !tiles.empty();
+    }
+    int getTileCount() const
+    {
+        return static_cast<int>(tiles.size());
+    }
+    // Spring count of the busiest tile over the average, 1 is a perfect balance
+    float getImbalance() const;
+
+    // One iteration over all tiles, strain is written by constraint id when strainOut is set
+    // Residuals of the tiles are merged in tile order into residualOut when it is set
+    void solveIteration(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                        const SolverPass &pass, float maxStretchRatio, FractureSystem *strainOut, bool pinned,
+                        TaskScheduler &scheduler, SolverResidual *residualOut = nullptr);
+
+  private:
+    struct LocalSpring
+    {
+        int a, b;
+        float restLength;
+        int material;
+        // Spring index or grid edge id, used for the strain
+        int id;
+    };
+
+    // Copy of an owned mass held by another tile
+    struct HaloLink
+    {
+        int owned;
+        int tile;
+        int local;
+    };
+
+    struct Tile
+    {
+        // Global index of every local mass, owned masses come first
+        std::vector<int> massIds;
+        int ownedCount = 0;
+        std::vector<Mass> local;
+        // Local positions at the start of the iteration
+        std::vector<glm::vec3> start;
+        // Grouped by material, batchEnd[m] ends the springs of material m
+        std::vector<LocalSpring> springs;
+        std::vector<int> batchEnd;
+        // Sorted by owned index
+        std::vector<HaloLink> incoming;
+        // Violation measured by the last iteration
+        float maxViolation = 0.0f;
+        double sumSquares = 0.0;
+        int projected = 0;
+    };
+
+    // Visit: void(Emit), Emit: void(int id, int a, int b, float restLength, int material)
+    template <typename ForEach> void partition(const std::vector<Mass> &masses, int tileCount, ForEach &&forEach);
+    template <bool Pinned, bool Measure>
+    void solveTile(Tile &tile, const std::vector<SpringMaterial> &materials, const SolverPass &pass,
+                   float maxStretchRatio, FractureSystem *strainOut);
+    void reconcileTile(Tile &tile, std::vector<Mass> &masses) const;
+
+    std::vector<Tile> tiles;
+    std::vector<int> owner;
+    std::vector<int> ownedIndex;
+    std::vector<int> stamp;
+    std::vector<int> localIndex;
+    std::vector<float> load;
+};
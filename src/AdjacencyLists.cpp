@@ -0,0 +1,67 @@
+#include "AdjacencyLists.hpp"
+
+#include <algorithm>
+
+void AdjacencyLists::clear()
+{
+    start.clear();
+    size.clear();
+    room.clear();
+    items.clear();
+}
+
+int AdjacencyLists::addOwner()
+{
+    start.push_back(static_cast<int>(items.size()));
+    size.push_back(0);
+    room.push_back(SLACK);
+    items.resize(items.size() + SLACK, -1);
+    return static_cast<int>(start.size()) - 1;
+}
+
+void AdjacencyLists::add(int owner, int item)
+{
+    if (size[owner] == room[owner])
+    {
+        // Full slot moves to the end with twice the room
+        int moved = static_cast<int>(items.size());
+        int newRoom = std::max(room[owner] * 2, SLACK);
+        items.resize(items.size() + newRoom, -1);
+        std::copy(items.begin() + start[owner], items.begin() + start[owner] + size[owner], items.begin() + moved);
+        start[owner] = moved;
+        room[owner] = newRoom;
+    }
+
+    items[start[owner] + size[owner]++] = item;
+}
+
+void AdjacencyLists::remove(int owner, int item)
+{
+    int *first = items.data() + start[owner];
+    for (int i = 0; i < size[owner]; i++)
+    {
+        if (first[i] == item)
+        {
+            first[i] = first[--size[owner]];
+            return;
+        }
+    }
+}
+
+void AdjacencyLists::replace(int owner, int from, int to)
+{
+    int *first = items.data() + start[owner];
+    for (int i = 0; i < size[owner]; i++)
+    {
+        if (first[i] == from)
+        {
+            first[i] = to;
+            return;
+        }
+    }
+}
+
+bool AdjacencyLists::contains(int owner, int item) const
+{
+    return std::find(begin(owner), end(owner), item) != end(owner);
+}
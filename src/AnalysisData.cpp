@@ -1,10 +1,14 @@
 #include "AnalysisData.hpp"
 #include "Cloth.hpp"
+#include "TaskScheduler.hpp"
 #include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
 
+// Items per scheduler chunk of the global statistics
+static const int STATS_GRAIN = 4096;
+
 ClothAnalysis::ClothAnalysis()
     : maxHistorySize(500), totalBrokenSprings(0), totalEnergy(0.0f), averageTension(0.0f), maxTension(0.0f),
       minBounds(0.0f), maxBounds(0.0f), isRecording(false), recordedMassIndex(-1)
@@ -66,6 +70,17 @@ void ClothAnalysis::recordSpringBreak(int springIndex, const glm::vec3 &position
     }
 }
 
+void ClothAnalysis::recordSpringBreaks(const std::vector<SpringBreakEvent> &events)
+{
+    breakEvents.insert(breakEvents.end(), events.begin(), events.end());
+    totalBrokenSprings += events.size();
+
+    if (breakEvents.size() > 100)
+    {
+        breakEvents.erase(breakEvents.begin(), breakEvents.end() - 100);
+    }
+}
+
 float ClothAnalysis::calculateKineticEnergy(const Mass &mass) const
 {
     glm::vec3 velocity = calculateVelocity(mass);
@@ -106,43 +121,79 @@ glm::vec3 ClothAnalysis::calculateVelocity(const Mass &mass) const
 void ClothAnalysis::updateGlobalStats(const std::vector<Mass> &masses, const std::vector<Spring> &springs,
                                       float simulationTime)
 {
-    totalEnergy = 0.0f;
-    minBounds = glm::vec3(std::numeric_limits<float>::max());
-    maxBounds = glm::vec3(std::numeric_limits<float>::lowest());
-
-    for (const auto &mass : masses)
-    {
-        totalEnergy += calculateKineticEnergy(mass);
-
-        minBounds.x = std::min(minBounds.x, mass.position.x);
-        minBounds.y = std::min(minBounds.y, mass.position.y);
-        minBounds.z = std::min(minBounds.z, mass.position.z);
-
-        maxBounds.x = std::max(maxBounds.x, mass.position.x);
-        maxBounds.y = std::max(maxBounds.y, mass.position.y);
-        maxBounds.z = std::max(maxBounds.z, mass.position.z);
-    }
-
-    float totalTension = 0.0f;
-    maxTension = 0.0f;
+    TaskScheduler &scheduler = TaskScheduler::instance();
 
-    for (const auto &spring : springs)
+    struct MassStats
     {
-        if (spring.a >= masses.size() || spring.b >= masses.size())
-            continue;
-
-        const Mass &massA = masses[spring.a];
-        const Mass &massB = masses[spring.b];
+        float energy = 0.0f;
+        glm::vec3 minBounds = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 maxBounds = glm::vec3(std::numeric_limits<float>::lowest());
+    };
+
+    MassStats massStats = scheduler.parallelReduce(
+        0, static_cast<int>(masses.size()), STATS_GRAIN, MassStats(),
+        [&](int begin, int end) {
+            MassStats partial;
+            for (int i = begin; i < end; ++i)
+            {
+                const Mass &mass = masses[i];
+                partial.energy += calculateKineticEnergy(mass);
+                partial.minBounds = glm::min(partial.minBounds, mass.position);
+                partial.maxBounds = glm::max(partial.maxBounds, mass.position);
+            }
+            return partial;
+        },
+        [](MassStats a, const MassStats &b) {
+            a.energy += b.energy;
+            a.minBounds = glm::min(a.minBounds, b.minBounds);
+            a.maxBounds = glm::max(a.maxBounds, b.maxBounds);
+            return a;
+        });
+
+    totalEnergy = massStats.energy;
+    minBounds = massStats.minBounds;
+    maxBounds = massStats.maxBounds;
+
+    // x: summed tension, y: max tension
+    glm::vec2 tension = scheduler.parallelReduce(
+        0, static_cast<int>(springs.size()), STATS_GRAIN, glm::vec2(0.0f),
+        [&](int begin, int end) {
+            glm::vec2 partial(0.0f);
+            for (int i = begin; i < end; ++i)
+            {
+                const Spring &spring = springs[i];
+                if (spring.a >= masses.size() || spring.b >= masses.size())
+                    continue;
+
+                float currentLength = glm::length(masses[spring.b].position - masses[spring.a].position);
+                float strain = (currentLength - spring.restLength) / spring.restLength;
+                partial.x += std::abs(strain);
+                partial.y = std::max(partial.y, std::abs(strain));
+            }
+            return partial;
+        },
+        [](glm::vec2 a, const glm::vec2 &b) { return glm::vec2(a.x + b.x, std::max(a.y, b.y)); });
+
+    maxTension = tension.y;
+    averageTension = springs.empty() ? 0.0f : tension.x / springs.size();
+}
 
-        float currentLength = glm::length(massB.position - massA.position);
-        float strain = (currentLength - spring.restLength) / spring.restLength;
-        float tension = std::abs(strain);
+void ClothAnalysis::setTensionStats(float average, float max)
+{
+    averageTension = average;
+    maxTension = max;
+}
 
-        totalTension += tension;
-        maxTension = std::max(maxTension, tension);
-    }
+void ClothAnalysis::clearResidualCurve()
+{
+    residualMax.clear();
+    residualRms.clear();
+}
 
-    averageTension = springs.empty() ? 0.0f : totalTension / springs.size();
+void ClothAnalysis::recordResidual(float maxViolation, float rmsViolation)
+{
+    residualMax.push_back(maxViolation);
+    residualRms.push_back(rmsViolation);
 }
 
 void ClothAnalysis::clearHistory()
@@ -0,0 +1,169 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <limits>
+
+void BVH::clear()
+{
+    nodes.clear();
+    primIndices.clear();
+    livePrimitives = 0;
+}
+
+void BVH::build(const std::vector<AABB> &bounds)
+{
+    nodes.clear();
+    primIndices.resize(bounds.size());
+    centroids.resize(bounds.size());
+    livePrimitives = static_cast<int>(bounds.size());
+
+    if (bounds.empty())
+        return;
+
+    for (int i = 0; i < bounds.size(); ++i)
+    {
+        primIndices[i] = i;
+        centroids[i] = bounds[i].getCenter();
+    }
+
+    // Median splits leave at least two primitives per leaf, so N nodes are always enough
+    nodes.reserve(bounds.size());
+
+    Node root;
+    root.start = 0;
+    root.count = static_cast<int>(bounds.size());
+    nodes.push_back(root);
+
+    subdivide(0, bounds);
+
+    slotOf.resize(bounds.size());
+    leafOf.resize(bounds.size());
+    for (int n = 0; n < nodes.size(); ++n)
+    {
+        if (nodes[n].count < 0)
+            continue;
+        for (int i = nodes[n].start; i < nodes[n].start + nodes[n].count; ++i)
+        {
+            slotOf[primIndices[i]] = i;
+            leafOf[primIndices[i]] = n;
+        }
+    }
+}
+
+void BVH::computeLeafBounds(Node &node, const std::vector<AABB> &bounds) const
+{
+    node.min = glm::vec3(std::numeric_limits<float>::max());
+    node.max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    for (int i = node.start; i < node.start + node.count; ++i)
+    {
+        const AABB &box = bounds[primIndices[i]];
+        node.min = glm::min(node.min, box.getMin());
+        node.max = glm::max(node.max, box.getMax());
+    }
+}
+
+void BVH::subdivide(int nodeIndex, const std::vector<AABB> &bounds)
+{
+    computeLeafBounds(nodes[nodeIndex], bounds);
+
+    int start = nodes[nodeIndex].start;
+    int count = nodes[nodeIndex].count;
+
+    if (count <= MAX_LEAF_SIZE)
+        return;
+
+    glm::vec3 centroidMin(std::numeric_limits<float>::max());
+    glm::vec3 centroidMax(std::numeric_limits<float>::lowest());
+    for (int i = start; i < start + count; ++i)
+    {
+        centroidMin = glm::min(centroidMin, centroids[primIndices[i]]);
+        centroidMax = glm::max(centroidMax, centroids[primIndices[i]]);
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent.x)
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    int half = count / 2;
+    std::nth_element(primIndices.begin() + start, primIndices.begin() + start + half,
+                     primIndices.begin() + start + count,
+                     [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    int leftIndex = static_cast<int>(nodes.size());
+
+    Node left;
+    left.start = start;
+    left.count = half;
+    Node right;
+    right.start = start + half;
+    right.count = count - half;
+
+    nodes.push_back(left);
+    nodes.push_back(right);
+
+    nodes[nodeIndex].start = leftIndex;
+    nodes[nodeIndex].count = -1;
+
+    subdivide(leftIndex, bounds);
+    subdivide(leftIndex + 1, bounds);
+
+    nodes[nodeIndex].min = glm::min(nodes[leftIndex].min, nodes[leftIndex + 1].min);
+    nodes[nodeIndex].max = glm::max(nodes[leftIndex].max, nodes[leftIndex + 1].max);
+}
+
+void BVH::refit(const std::vector<AABB> &bounds)
+{
+    if (bounds.size() != livePrimitives)
+    {
+        build(bounds);
+        return;
+    }
+
+    // Children are always stored after their parent, so a reverse sweep is bottom-up
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i)
+    {
+        Node &node = nodes[i];
+        if (node.count >= 0)
+        {
+            computeLeafBounds(node, bounds);
+        }
+        else
+        {
+            node.min = glm::min(nodes[node.start].min, nodes[node.start + 1].min);
+            node.max = glm::max(nodes[node.start].max, nodes[node.start + 1].max);
+        }
+    }
+}
+
+void BVH::removePrimitives(const int *removed, std::size_t count)
+{
+    if (nodes.empty())
+        return;
+
+    for (std::size_t r = 0; r < count; ++r)
+    {
+        int primitive = removed[r];
+
+        // The last primitive of the leaf fills the freed slot
+        Node &leaf = nodes[leafOf[primitive]];
+        int slot = slotOf[primitive];
+        int lastSlot = leaf.start + leaf.count - 1;
+        int moved = primIndices[lastSlot];
+        primIndices[slot] = moved;
+        slotOf[moved] = slot;
+        leaf.count--;
+
+        // The last id takes the removed one, like the swap with the back done on the primitive array
+        int last = --livePrimitives;
+        if (last != primitive)
+        {
+            primIndices[slotOf[last]] = primitive;
+            slotOf[primitive] = slotOf[last];
+            leafOf[primitive] = leafOf[last];
+        }
+    }
+}
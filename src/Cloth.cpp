@@ -1,22 +1,67 @@
 #include "Cloth.hpp"
 #include "AABB.hpp"
 #include "AnalysisData.hpp"
+#include "EdgeHash.hpp"
 #include "Object.hpp"
 #include "Ray.hpp"
+#include "TaskScheduler.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <queue>
-#include <set>
 #include <stb_image.h>
 
 enum class ClothOrientation;
 
+// Items per scheduler chunk, small cloths stay on the calling thread
+static const int MASS_GRAIN = 2048;
+static const int SPRING_GRAIN = 8192;
+static const int TRIANGLE_GRAIN = 4096;
+static const int GRID_ROW_GRAIN = 16;
+// Reduced steps per frame before the preview drops time
+static const int MAX_PREVIEW_STEPS = 8;
+// Fewest frames between statistics passes while the preview runs
+static const int PREVIEW_ANALYSIS_INTERVAL = 8;
+// Bits of the per-mass refinement marks
+static const uint8_t TEAR_FRONT_MARK = 1;
+static const uint8_t CONTACT_MARK = 2;
+// Marked triangles rank like an edge this far over the split strain
+static const float MARKED_SPLIT_SCORE = 1.0f;
+
 glm::vec3 midpoint(const glm::vec3 &a, const glm::vec3 &b)
 {
     return (a + b) * 0.5f;
 }
 
+// Moller-Trumbore ray/triangle test
+static bool rayTriangleIntersect(const Ray &ray, const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2,
+                                 float &t)
+{
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 p = glm::cross(ray.Direction(), edge2);
+    float det = glm::dot(edge1, p);
+
+    if (std::abs(det) < 1e-8f)
+        return false;
+
+    float invDet = 1.0f / det;
+    glm::vec3 s = ray.Origin() - v0;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(ray.Direction(), q) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = glm::dot(edge2, q) * invDet;
+    return t > 0.0f;
+}
+
 bool Cloth::areSpringMidpointsConnected(int springA, int springB) const
 {
     const Spring &sA = springs[springA];
@@ -25,30 +70,18 @@ bool Cloth::areSpringMidpointsConnected(int springA, int springB) const
     return (sA.a == sB.a || sA.a == sB.b || sA.b == sB.a || sA.b == sB.b);
 }
 
-void Cloth::initCloth()
+void Cloth::buildGrid()
 {
-    masses.clear();
-    springs.clear();
-    massIndexMap.clear();
-
-    forceManager.clear();
-    forceManager.addForce<GravityForce>(-9.81f);
-    forceManager.addForce<WindForce>(glm::vec3(1.0f, 0.0f, 0.0f), 5.0f);
-
-    simulationTime = 0.0f;
+    restDensity = defaultMass * resX * resY / (width * height);
 
     masses.reserve(resX * resY);
     springs.reserve((resX - 1) * resY + resX * (resY - 1) + (resX - 1) * (resY - 1));
     massIndexMap.resize(resX * resY);
 
     const float massValue = defaultMass;
-
-    float structuralStiff = defaultStructuralStiffness;
-    float structuralDamping = defaultStructuralDamping;
-    float shearStiff = defaultShearStiffness;
-    float shearDamping = defaultShearDamping;
-    float bendingStiff = defaultBendingStiffness;
-    float bendingDamping = defaultBendingDamping;
+    const int structural = static_cast<int>(SpringFamily::STRUCTURAL);
+    const int shear = static_cast<int>(SpringFamily::SHEAR);
+    const int bending = static_cast<int>(SpringFamily::BENDING);
 
     for (int y = 0; y < resY; y++)
     {
@@ -95,73 +128,268 @@ void Cloth::initCloth()
         }
     }
 
-    for (int y = 0; y < resY; y++)
+    // Triangle elements take over stretch and shear, they are built from the triangles below
+    if (activeMembraneModel() == MembraneModel::MASS_SPRING)
     {
-        for (int x = 0; x < resX - 1; x++)
+        for (int y = 0; y < resY; y++)
+        {
+            for (int x = 0; x < resX - 1; x++)
+            {
+                int idx1 = y * resX + x;
+                int idx2 = y * resX + (x + 1);
+                float length = glm::distance(masses[idx1].position, masses[idx2].position);
+                springs.emplace_back(idx1, idx2, length, structural);
+            }
+        }
+
+        for (int y = 0; y < resY - 1; y++)
+        {
+            for (int x = 0; x < resX; x++)
+            {
+                int idx1 = y * resX + x;
+                int idx2 = (y + 1) * resX + x;
+                float length = glm::distance(masses[idx1].position, masses[idx2].position);
+                springs.emplace_back(idx1, idx2, length, structural);
+            }
+        }
+
+        for (int y = 0; y < resY - 1; y++)
         {
-            int idx1 = y * resX + x;
-            int idx2 = y * resX + (x + 1);
-            float length = glm::distance(masses[idx1].position, masses[idx2].position);
-            glm::vec3 mp = midpoint(masses[idx1].position, masses[idx2].position);
-            springs.emplace_back(idx1, idx2, length, mp, structuralStiff, structuralDamping);
+            for (int x = 0; x < resX - 1; x++)
+            {
+                int idx1 = y * resX + x;
+                int idx2 = (y + 1) * resX + (x + 1);
+                float length = glm::distance(masses[idx1].position, masses[idx2].position);
+                springs.emplace_back(idx1, idx2, length, shear);
+
+                idx1 = y * resX + (x + 1);
+                idx2 = (y + 1) * resX + x;
+                length = glm::distance(masses[idx1].position, masses[idx2].position);
+                springs.emplace_back(idx1, idx2, length, shear);
+            }
         }
     }
 
-    for (int y = 0; y < resY - 1; y++)
+    // Hinges replace the skip springs, they are built from the triangles below
+    const bool skipSprings = !usesHinges();
+    if (skipSprings)
     {
-        for (int x = 0; x < resX; x++)
+        for (int y = 0; y < resY; y++)
+        {
+            for (int x = 0; x < resX - 2; x++)
+            {
+                int idx1 = y * resX + x;
+                int idx2 = y * resX + (x + 2);
+                float length = glm::distance(masses[idx1].position, masses[idx2].position);
+                springs.emplace_back(idx1, idx2, length, bending);
+            }
+        }
+
+        for (int y = 0; y < resY - 2; y++)
         {
-            int idx1 = y * resX + x;
-            int idx2 = (y + 1) * resX + x;
-            float length = glm::distance(masses[idx1].position, masses[idx2].position);
-            glm::vec3 mp = midpoint(masses[idx1].position, masses[idx2].position);
-            springs.emplace_back(idx1, idx2, length, mp, structuralStiff, structuralDamping);
+            for (int x = 0; x < resX; x++)
+            {
+                int idx1 = y * resX + x;
+                int idx2 = (y + 2) * resX + x;
+                float length = glm::distance(masses[idx1].position, masses[idx2].position);
+                springs.emplace_back(idx1, idx2, length, bending);
+            }
         }
     }
 
+    // Two triangles per grid cell, this list is the render topology and is only changed by tearing
+    textureIndices.clear();
+    textureIndices.reserve((resX - 1) * (resY - 1) * 6);
     for (int y = 0; y < resY - 1; y++)
     {
         for (int x = 0; x < resX - 1; x++)
         {
-            int idx1 = y * resX + x;
-            int idx2 = (y + 1) * resX + (x + 1);
-            float length = glm::distance(masses[idx1].position, masses[idx2].position);
-            glm::vec3 mp = midpoint(masses[idx1].position, masses[idx2].position);
-            springs.emplace_back(idx1, idx2, length, mp, shearStiff, shearDamping);
+            int idx0 = massIndexMap[y * resX + x];
+            int idx1 = massIndexMap[y * resX + (x + 1)];
+            int idx2 = massIndexMap[(y + 1) * resX + x];
+            int idx3 = massIndexMap[(y + 1) * resX + (x + 1)];
+
+            // Triangle elements flip the diagonal on every other cell, with one diagonal everywhere the
+            // membrane is stiffer against one shear direction and the cloth leans to the side
+            if (activeMembraneModel() == MembraneModel::COROTATIONAL && (x + y) % 2 == 1)
+            {
+                textureIndices.push_back(idx0);
+                textureIndices.push_back(idx1);
+                textureIndices.push_back(idx3);
+
+                textureIndices.push_back(idx0);
+                textureIndices.push_back(idx3);
+                textureIndices.push_back(idx2);
+                continue;
+            }
+
+            textureIndices.push_back(idx0);
+            textureIndices.push_back(idx1);
+            textureIndices.push_back(idx2);
 
-            idx1 = y * resX + (x + 1);
-            idx2 = (y + 1) * resX + x;
-            length = glm::distance(masses[idx1].position, masses[idx2].position);
-            mp = midpoint(masses[idx1].position, masses[idx2].position);
-            springs.emplace_back(idx1, idx2, length, mp, shearStiff, shearDamping);
+            textureIndices.push_back(idx1);
+            textureIndices.push_back(idx3);
+            textureIndices.push_back(idx2);
         }
     }
+}
 
-    for (int y = 0; y < resY; y++)
+void Cloth::buildFromMesh()
+{
+    const ObjMesh &mesh = clothMesh;
+    const int structural = static_cast<int>(SpringFamily::STRUCTURAL);
+    const int bending = static_cast<int>(SpringFamily::BENDING);
+
+    // One mass per position of the file, so texture seams do not cut the cloth, unused positions are dropped
+    std::vector<int> massOf(mesh.positionCount, -1);
+    for (unsigned int vertex : mesh.indices)
+        massOf[mesh.positionIndex[vertex]] = 0;
+    int massCount = 0;
+    for (int &mass : massOf)
+    {
+        if (mass == 0)
+            mass = massCount++;
+    }
+
+    std::vector<glm::vec3> positions(massCount);
+    std::vector<glm::vec2> texCoords(massCount);
+    for (int v = mesh.vertexCount() - 1; v >= 0; v--)
     {
-        for (int x = 0; x < resX - 2; x++)
+        int mass = massOf[mesh.positionIndex[v]];
+        if (mass < 0)
+            continue;
+        positions[mass] = mesh.positions[v] * meshImport.scale + meshImport.offset;
+        texCoords[mass] = mesh.texCoords[v];
+    }
+
+    std::vector<char> pinned(massCount, 0);
+    int pinGroup = mesh.findGroup(meshImport.pinGroup);
+    textureIndices.resize(mesh.indices.size());
+    for (int t = 0; t < mesh.triangleCount(); t++)
+    {
+        for (int k = 0; k < 3; k++)
         {
-            int idx1 = y * resX + x;
-            int idx2 = y * resX + (x + 2);
-            float length = glm::distance(masses[idx1].position, masses[idx2].position);
-            glm::vec3 mp = midpoint(masses[idx1].position, masses[idx2].position);
-            springs.emplace_back(idx1, idx2, length, mp, bendingStiff, bendingDamping);
+            int mass = massOf[mesh.positionIndex[mesh.indices[t * 3 + k]]];
+            textureIndices[t * 3 + k] = mass;
+            if (pinGroup >= 0 && mesh.triangleGroups[t] == pinGroup)
+                pinned[mass] = 1;
         }
     }
 
-    for (int y = 0; y < resY - 2; y++)
+    masses.reserve(massCount);
+    for (int i = 0; i < massCount; i++)
     {
-        for (int x = 0; x < resX; x++)
+        masses.emplace_back(positions[i], defaultMass, pinned[i] != 0, texCoords[i]);
+
+        // Same nudge as the grid so symmetric meshes do not fold in perfect balance
+        if (!pinned[i])
+        {
+            float offsetScale = 0.001f;
+            masses.back().prevPosition =
+                positions[i] - glm::vec3((i % 2 == 0 ? 1.0f : -1.0f) * offsetScale, -offsetScale * 0.5f,
+                                         ((i / 2) % 2 == 0 ? 1.0f : -1.0f) * offsetScale * 0.5f);
+        }
+    }
+
+    // Every unique edge is a structural spring, the two vertices across an edge with two triangles are
+    // joined by a bending spring unless hinges handle bending
+    const bool skipSprings = !usesHinges();
+    EdgeHash edges;
+    edges.reserve(mesh.triangleCount() * 3 / 2 + 16);
+    std::vector<int> opposite;
+    opposite.reserve(mesh.triangleCount() * 3 / 2 + 16);
+    springs.reserve(mesh.triangleCount() * (skipSprings ? 3 : 2));
+
+    glm::vec3 low(std::numeric_limits<float>::max());
+    glm::vec3 high(std::numeric_limits<float>::lowest());
+    float edgeLengthSum = 0.0f;
+    float area = 0.0f;
+    for (int t = 0; t < mesh.triangleCount(); t++)
+    {
+        const int corners[3] = {static_cast<int>(textureIndices[t * 3]), static_cast<int>(textureIndices[t * 3 + 1]),
+                                static_cast<int>(textureIndices[t * 3 + 2])};
+        area += 0.5f * glm::length(glm::cross(positions[corners[1]] - positions[corners[0]],
+                                              positions[corners[2]] - positions[corners[0]]));
+
+        for (int k = 0; k < 3; k++)
         {
-            int idx1 = y * resX + x;
-            int idx2 = (y + 2) * resX + x;
-            float length = glm::distance(masses[idx1].position, masses[idx2].position);
-            glm::vec3 mp = midpoint(masses[idx1].position, masses[idx2].position);
-            springs.emplace_back(idx1, idx2, length, mp, bendingStiff, bendingDamping);
+            int a = corners[k];
+            int b = corners[(k + 1) % 3];
+            int across = corners[(k + 2) % 3];
+            auto inserted = edges.insert(a, b, static_cast<int>(opposite.size()));
+            if (inserted.second)
+            {
+                float length = glm::distance(positions[a], positions[b]);
+                springs.emplace_back(a, b, length, structural);
+                opposite.push_back(across);
+                edgeLengthSum += length;
+            }
+            else if (skipSprings && opposite[inserted.first] >= 0)
+            {
+                // Edges shared by more than two triangles only bend across the first pair
+                int other = opposite[inserted.first];
+                springs.emplace_back(other, across, glm::distance(positions[other], positions[across]), bending);
+                opposite[inserted.first] = -1;
+            }
         }
     }
 
-    if (textureID == 0)
+    for (const glm::vec3 &position : positions)
+    {
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+
+    // The grid size stands in for the mesh where the code needs one, the spacing follows the mean edge
+    float meanEdge = edges.size() > 0 ? edgeLengthSum / edges.size() : 1.0f;
+    glm::vec3 extent = high - low;
+    width = std::max(extent.x, meanEdge);
+    height = std::max(std::max(extent.y, extent.z), meanEdge);
+    resX = std::max(2, static_cast<int>(std::lround(width / meanEdge)) + 1);
+    resY = std::max(2, static_cast<int>(std::lround(height / meanEdge)) + 1);
+    restDensity = area > 0.0f ? defaultMass * massCount / area : 0.0f;
+}
+
+void Cloth::initCloth()
+{
+    masses.clear();
+    springs.clear();
+    massIndexMap.clear();
+    refinementRecords.clear();
+    refineMarks.clear();
+    refinementFrame = 0;
+
+    forceManager.clear();
+    forceManager.addForce<GravityForce>(-9.81f);
+    forceManager.addForce<WindForce>(glm::vec3(1.0f, 0.0f, 0.0f), 5.0f);
+
+    simulationTime = 0.0f;
+    previousDt = 0.0f;
+    adaptiveDt = timestepParams.maxDt;
+    stepCounter = 0;
+    lastMaxStrain = 1.0f;
+    lastStrainTime = -1.0f;
+    lastBrokenCount = 0;
+
+    // One material per family, regions with other parameters can append their own
+    materials.clear();
+    materials.push_back({defaultStructuralStiffness, defaultStructuralDamping, SpringFamily::STRUCTURAL});
+    materials.push_back({defaultShearStiffness, defaultShearDamping, SpringFamily::SHEAR});
+    materials.push_back({defaultBendingStiffness, defaultBendingDamping, SpringFamily::BENDING});
+
+    // Imported meshes keep their own triangles, the rest of the setup is shared with the grid
+    // Triangle elements take their rest shape from the texture layout of the grid, meshes use springs
+    if (clothMesh.triangleCount() > 0)
+        buildFromMesh();
+    else
+        buildGrid();
+    indicesDirty = true;
+
+    restPositions.clear();
+    for (const Mass &mass : masses)
+        restPositions.push_back(mass.position);
+
+    if (textureID == 0 && !headless)
     {
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_2D, textureID);
@@ -204,17 +432,37 @@ void Cloth::initCloth()
         stbi_image_free(data);
     }
 
+    // Regular grids can drop the explicit springs, the stencil defines the topology
+    if (structuredGrid && activeMembraneModel() == MembraneModel::MASS_SPRING && clothMesh.triangleCount() == 0)
+    {
+        grid.build(resX, resY, springs, !usesHinges());
+        springs.clear();
+        springs.shrink_to_fit();
+    }
+    else
+    {
+        grid.clear();
+    }
+    fracture.reset(springs.size());
+
+    calculateNormals();
     rebuildGraphicsData();
     rebuildTextureData();
 
+    topologyVersion++;
+    positionsVersion++;
+
+    if (headless)
+        return;
+
     if (VAO_masses == 0)
     {
         glGenVertexArrays(1, &VAO_masses);
         glGenBuffers(1, &VBO_masses);
 
         glBindVertexArray(VAO_masses);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_masses);
-        glBufferData(GL_ARRAY_BUFFER, massesVertices.size() * sizeof(float), massesVertices.data(), GL_DYNAMIC_DRAW);
+        uploadBuffer(GL_ARRAY_BUFFER, VBO_masses, massesBufferSize, massesVertices.data(),
+                     massesVertices.size() * sizeof(float));
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
     }
@@ -225,8 +473,8 @@ void Cloth::initCloth()
         glGenBuffers(1, &VBO_lines);
 
         glBindVertexArray(VAO_lines);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_lines);
-        glBufferData(GL_ARRAY_BUFFER, lineVertices.size() * sizeof(float), lineVertices.data(), GL_DYNAMIC_DRAW);
+        uploadBuffer(GL_ARRAY_BUFFER, VBO_lines, linesBufferSize, lineVertices.data(),
+                     lineVertices.size() * sizeof(float));
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
     }
@@ -239,12 +487,11 @@ void Cloth::initCloth()
 
         glBindVertexArray(VAO_texture);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture);
-        glBufferData(GL_ARRAY_BUFFER, textureVertices.size() * sizeof(float), textureVertices.data(), GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_texture);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, textureIndices.size() * sizeof(unsigned int), textureIndices.data(),
-                     GL_DYNAMIC_DRAW);
+        uploadBuffer(GL_ARRAY_BUFFER, VBO_texture, textureBufferSize, textureVertices.data(),
+                     textureVertices.size() * sizeof(float));
+        uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_texture, indexBufferSize, renderIndices().data(),
+                     renderIndices().size() * sizeof(unsigned int));
+        indicesDirty = false;
 
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
@@ -269,8 +516,8 @@ void Cloth::reset()
     initCloth();
 }
 
-Cloth::Cloth(float width, float height, int resX, int resY, float floorY)
-    : width(width), height(height), resX(resX), resY(resY), floorY(floorY + .05f),
+Cloth::Cloth(float width, float height, int resX, int resY, float floorY, bool headless)
+    : width(width), height(height), resX(resX), resY(resY), floorY(floorY + .05f), headless(headless),
       currentOrientation(ClothOrientation::VERTICAL)
 {
     VAO_masses = 0, VBO_masses = 0;
@@ -291,198 +538,243 @@ void Cloth::rebuildGraphicsData()
     }
 
     lineVertices.clear();
+    auto addLine = [&](int a, int b) {
+        lineVertices.push_back(masses[a].position.x);
+        lineVertices.push_back(masses[a].position.y);
+        lineVertices.push_back(masses[a].position.z);
+
+        lineVertices.push_back(masses[b].position.x);
+        lineVertices.push_back(masses[b].position.y);
+        lineVertices.push_back(masses[b].position.z);
+    };
+
+    if (grid.active())
+        grid.forEachEdge([&](int, int a, int b, float, int) { addLine(a, b); });
     for (const auto &spring : springs)
-    {
-        lineVertices.push_back(masses[spring.a].position.x);
-        lineVertices.push_back(masses[spring.a].position.y);
-        lineVertices.push_back(masses[spring.a].position.z);
+        addLine(spring.a, spring.b);
 
-        lineVertices.push_back(masses[spring.b].position.x);
-        lineVertices.push_back(masses[spring.b].position.y);
-        lineVertices.push_back(masses[spring.b].position.z);
+    if (VAO_masses != 0)
+    {
+        uploadBuffer(GL_ARRAY_BUFFER, VBO_masses, massesBufferSize, massesVertices.data(),
+                     massesVertices.size() * sizeof(float));
     }
 
     if (VAO_lines != 0)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_lines);
-        glBufferData(GL_ARRAY_BUFFER, lineVertices.size() * sizeof(float), lineVertices.data(), GL_DYNAMIC_DRAW);
+        uploadBuffer(GL_ARRAY_BUFFER, VBO_lines, linesBufferSize, lineVertices.data(),
+                     lineVertices.size() * sizeof(float));
     }
 }
 
-void Cloth::calculateNormals()
+void Cloth::uploadBuffer(unsigned int target, unsigned int buffer, size_t &capacity, const void *data, size_t bytes)
 {
-    for (auto &mass : masses)
-    {
-        mass.normal = glm::vec3(0.0f);
-    }
+    glBindBuffer(target, buffer);
 
-    for (int y = 0; y < resY - 1; y++)
+    // Grow geometrically, so new masses from tearing do not reallocate GPU storage on every event
+    if (bytes > capacity)
     {
-        for (int x = 0; x < resX - 1; x++)
-        {
-            int gridIdx0 = y * resX + x;
-            int gridIdx1 = y * resX + (x + 1);
-            int gridIdx2 = (y + 1) * resX + x;
-            int gridIdx3 = (y + 1) * resX + (x + 1);
-
-            if (gridIdx0 >= massIndexMap.size() || gridIdx1 >= massIndexMap.size() || gridIdx2 >= massIndexMap.size() ||
-                gridIdx3 >= massIndexMap.size())
-                continue;
+        capacity = std::max(bytes, capacity * 2);
+        glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
 
-            int idx0 = massIndexMap[gridIdx0];
-            int idx1 = massIndexMap[gridIdx1];
-            int idx2 = massIndexMap[gridIdx2];
-            int idx3 = massIndexMap[gridIdx3];
+    if (bytes > 0)
+        glBufferSubData(target, 0, bytes, data);
+}
 
-            if (idx0 < 0 || idx1 < 0 || idx2 < 0 || idx3 < 0)
-                continue;
+void Cloth::calculateNormals()
+{
+    TaskScheduler &scheduler = TaskScheduler::instance();
+
+    // An embedded render mesh reads the masses of the triangles it is attached to, their normals need the whole
+    // fan around them. Refinement reads every normal, attachments of an older topology are not usable
+    const int allTriangles = static_cast<int>(textureIndices.size() / 3);
+    const bool partial = renderSource == RenderSource::EMBEDDED && !refinementParams.enabled &&
+                         renderMeshTopology == topologyVersion && renderMeshTriangles == allTriangles;
+    if (partial)
+        updateNormalSubset();
+
+    const int triangleCount = partial ? static_cast<int>(normalTriangles.size()) : allTriangles;
+    const int massCount = partial ? static_cast<int>(normalMasses.size()) : static_cast<int>(masses.size());
+    auto triangleAt = [&](int i) { return partial ? normalTriangles[i] : i; };
+    auto massAt = [&](int i) { return partial ? normalMasses[i] : i; };
+
+    // Face normals in parallel, then summed per mass in triangle order like before
+    std::pmr::vector<glm::vec3> faceNormals(triangleCount, &frameArena);
+    scheduler.parallelFor(0, triangleCount, TRIANGLE_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            int t = triangleAt(i);
+            const glm::vec3 &p0 = masses[textureIndices[t * 3]].position;
+            const glm::vec3 &p1 = masses[textureIndices[t * 3 + 1]].position;
+            const glm::vec3 &p2 = masses[textureIndices[t * 3 + 2]].position;
+
+            glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            float faceLength = glm::length(faceNormal);
+            faceNormals[i] = (faceLength < 1e-12f) ? glm::vec3(0.0f) : faceNormal / faceLength;
+        }
+    });
 
-            glm::vec3 v0 = masses[idx0].position;
-            glm::vec3 v1 = masses[idx1].position;
-            glm::vec3 v2 = masses[idx2].position;
+    for (int i = 0; i < massCount; ++i)
+    {
+        masses[massAt(i)].normal = glm::vec3(0.0f);
+    }
 
-            glm::vec3 edge1 = v1 - v0;
-            glm::vec3 edge2 = v2 - v0;
-            glm::vec3 normal1 = glm::normalize(glm::cross(edge1, edge2));
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        int t = triangleAt(i);
+        masses[textureIndices[t * 3]].normal += faceNormals[i];
+        masses[textureIndices[t * 3 + 1]].normal += faceNormals[i];
+        masses[textureIndices[t * 3 + 2]].normal += faceNormals[i];
+    }
 
-            masses[idx0].normal += normal1;
-            masses[idx1].normal += normal1;
-            masses[idx2].normal += normal1;
+    scheduler.parallelFor(0, massCount, MASS_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            Mass &mass = masses[massAt(i)];
+            if (glm::length(mass.normal) > 0.001f)
+            {
+                mass.normal = glm::normalize(mass.normal);
+            }
+            else
+            {
+                mass.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            }
+        }
+    });
+}
 
-            v0 = masses[idx1].position;
-            v1 = masses[idx3].position;
-            v2 = masses[idx2].position;
+void Cloth::updateNormalSubset()
+{
+    if (normalSubsetTopology == topologyVersion)
+        return;
 
-            edge1 = v1 - v0;
-            edge2 = v2 - v0;
-            glm::vec3 normal2 = glm::normalize(glm::cross(edge1, edge2));
+    // Corners of the attached triangles, then every triangle around them
+    massTouched.assign(masses.size(), 0);
+    for (int t : renderMesh.getAttachedTriangles())
+    {
+        for (int k = 0; k < 3; k++)
+            massTouched[textureIndices[t * 3 + k]] = 1;
+    }
 
-            masses[idx1].normal += normal2;
-            masses[idx3].normal += normal2;
-            masses[idx2].normal += normal2;
-        }
+    normalMasses.clear();
+    for (int i = 0; i < masses.size(); ++i)
+    {
+        if (massTouched[i])
+            normalMasses.push_back(i);
     }
 
-    for (auto &mass : masses)
+    normalTriangles.clear();
+    int triangleCount = static_cast<int>(textureIndices.size() / 3);
+    for (int t = 0; t < triangleCount; ++t)
     {
-        if (glm::length(mass.normal) > 0.001f)
-        {
-            mass.normal = glm::normalize(mass.normal);
-        }
-        else
-        {
-            mass.normal = glm::vec3(0.0f, 0.0f, 1.0f);
-        }
+        if (massTouched[textureIndices[t * 3]] || massTouched[textureIndices[t * 3 + 1]] ||
+            massTouched[textureIndices[t * 3 + 2]])
+            normalTriangles.push_back(t);
     }
+    normalSubsetTopology = topologyVersion;
 }
 
 void Cloth::rebuildTextureData()
 {
     textureVertices.clear();
-    textureIndices.clear();
 
     if (masses.empty())
         return;
 
-    calculateNormals();
-
-    textureVertices.reserve(masses.size() * 8);
-    for (const auto &mass : masses)
+    // An embedded mesh or patches replace the simulated vertices, the element buffer switches along with them
+    RenderSource source = RenderSource::SIMULATED;
+    if (renderMesh.active() && !textureIndices.empty())
+        source = RenderSource::EMBEDDED;
+    else if (subdivisionParams.enabled && subdivisionParams.segments > 1 && !textureIndices.empty())
+        source = RenderSource::SUBDIVIDED;
+
+    if (source == RenderSource::EMBEDDED)
+        updateRenderMesh();
+    else if (source == RenderSource::SUBDIVIDED)
+        updateSubdivision();
+    if (source != renderSource)
     {
-        textureVertices.push_back(mass.position.x);
-        textureVertices.push_back(mass.position.y);
-        textureVertices.push_back(mass.position.z);
-        textureVertices.push_back(mass.normal.x);
-        textureVertices.push_back(mass.normal.y);
-        textureVertices.push_back(mass.normal.z);
-        textureVertices.push_back(mass.texCoord.x);
-        textureVertices.push_back(mass.texCoord.y);
+        renderSource = source;
+        indicesDirty = true;
     }
 
-    std::set<std::pair<int, int>> springConnections;
-    for (const auto &spring : springs)
+    if (renderSource == RenderSource::EMBEDDED)
     {
-        if (spring.a >= masses.size() || spring.b >= masses.size())
-            continue;
-
-        int minIdx = std::min(spring.a, spring.b);
-        int maxIdx = std::max(spring.a, spring.b);
-        springConnections.insert({minIdx, maxIdx});
+        renderMesh.evaluate(masses, textureIndices, textureVertices, TaskScheduler::instance());
     }
-
-    auto hasSpring = [&](int a, int b) {
-        if (a < 0 || b < 0 || a >= masses.size() || b >= masses.size())
-            return false;
-        int minIdx = std::min(a, b);
-        int maxIdx = std::max(a, b);
-        return springConnections.count({minIdx, maxIdx}) > 0;
-    };
-
-    textureIndices.reserve((resX - 1) * (resY - 1) * 6);
-    for (int y = 0; y < resY - 1; y++)
+    else if (renderSource == RenderSource::SUBDIVIDED)
     {
-        for (int x = 0; x < resX - 1; x++)
+        subdivision.evaluate(masses, textureIndices, textureVertices, TaskScheduler::instance());
+    }
+    else
+    {
+        textureVertices.reserve(masses.size() * 8);
+        for (const auto &mass : masses)
         {
-            int gridIdx0 = y * resX + x;
-            int gridIdx1 = y * resX + (x + 1);
-            int gridIdx2 = (y + 1) * resX + x;
-            int gridIdx3 = (y + 1) * resX + (x + 1);
-
-            if (gridIdx0 >= massIndexMap.size() || gridIdx1 >= massIndexMap.size() || gridIdx2 >= massIndexMap.size() ||
-                gridIdx3 >= massIndexMap.size())
-                continue;
-
-            int idx0 = massIndexMap[gridIdx0];
-            int idx1 = massIndexMap[gridIdx1];
-            int idx2 = massIndexMap[gridIdx2];
-            int idx3 = massIndexMap[gridIdx3];
-
-            if (idx0 < 0 || idx1 < 0 || idx2 < 0 || idx3 < 0)
-                continue;
-
-            int edgeCount1 = 0;
-            if (hasSpring(idx0, idx1))
-                edgeCount1++;
-            if (hasSpring(idx1, idx2))
-                edgeCount1++;
-            if (hasSpring(idx0, idx2))
-                edgeCount1++;
-
-            if (edgeCount1 >= 2)
-            {
-                textureIndices.push_back(idx0);
-                textureIndices.push_back(idx1);
-                textureIndices.push_back(idx2);
-            }
-
-            int edgeCount2 = 0;
-            if (hasSpring(idx1, idx3))
-                edgeCount2++;
-            if (hasSpring(idx3, idx2))
-                edgeCount2++;
-            if (hasSpring(idx1, idx2))
-                edgeCount2++;
-
-            if (edgeCount2 >= 2)
-            {
-                textureIndices.push_back(idx1);
-                textureIndices.push_back(idx3);
-                textureIndices.push_back(idx2);
-            }
+            textureVertices.push_back(mass.position.x);
+            textureVertices.push_back(mass.position.y);
+            textureVertices.push_back(mass.position.z);
+            textureVertices.push_back(mass.normal.x);
+            textureVertices.push_back(mass.normal.y);
+            textureVertices.push_back(mass.normal.z);
+            textureVertices.push_back(mass.texCoord.x);
+            textureVertices.push_back(mass.texCoord.y);
         }
     }
 
     if (VAO_texture != 0)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture);
-        glBufferData(GL_ARRAY_BUFFER, textureVertices.size() * sizeof(float), textureVertices.data(), GL_DYNAMIC_DRAW);
+        uploadBuffer(GL_ARRAY_BUFFER, VBO_texture, textureBufferSize, textureVertices.data(),
+                     textureVertices.size() * sizeof(float));
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_texture);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, textureIndices.size() * sizeof(unsigned int), textureIndices.data(),
-                     GL_DYNAMIC_DRAW);
+        if (indicesDirty)
+        {
+            // Element buffer binding is VAO state
+            glBindVertexArray(VAO_texture);
+            const std::vector<unsigned int> &indices = renderIndices();
+            uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_texture, indexBufferSize, indices.data(),
+                         indices.size() * sizeof(unsigned int));
+            glBindVertexArray(0);
+            indicesDirty = false;
+        }
     }
 }
 
+void Cloth::updateSubdivision()
+{
+    int triangleCount = static_cast<int>(textureIndices.size() / 3);
+    if (subdivisionTopology == topologyVersion && subdivisionTriangles == triangleCount &&
+        subdivision.getSegments() == subdivisionParams.segments)
+        return;
+
+    subdivision.build(triangleCount, subdivisionParams.segments);
+    subdivisionTopology = topologyVersion;
+    subdivisionTriangles = triangleCount;
+    indicesDirty = true;
+}
+
+const std::vector<unsigned int> &Cloth::renderIndices() const
+{
+    if (renderSource == RenderSource::EMBEDDED)
+        return renderMesh.getIndices();
+    if (renderSource == RenderSource::SUBDIVIDED)
+        return subdivision.getIndices();
+    return textureIndices;
+}
+
+void Cloth::updateRenderMesh()
+{
+    int triangleCount = static_cast<int>(textureIndices.size() / 3);
+    if (renderMeshTopology == topologyVersion && renderMeshTriangles == triangleCount)
+        return;
+
+    renderMesh.attach(masses, textureIndices, TaskScheduler::instance());
+    renderMeshTopology = topologyVersion;
+    renderMeshTriangles = triangleCount;
+    normalSubsetTopology = -1;
+    indicesDirty = true;
+}
+
 void Cloth::draw(Shader &shader)
 {
     if (textureVisible)
@@ -492,7 +784,7 @@ void Cloth::draw(Shader &shader)
         shader.setInt("useTexture", 1);
 
         glBindVertexArray(VAO_texture);
-        glDrawElements(GL_TRIANGLES, textureIndices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, renderIndices().size(), GL_UNSIGNED_INT, 0);
 
         shader.setInt("useTexture", 0);
     }
@@ -532,504 +824,2206 @@ void Cloth::draw(Shader &shader)
     glBindVertexArray(0);
 }
 
-void Cloth::update(float dt)
+void Cloth::advanceFull(float dt)
 {
-    simulationTime += dt;
+    previewRunning = false;
 
-    for (auto &mass : masses)
+    updateTiles();
+    updateTethers();
+    updateSpringBatches();
+    updateDihedral();
+    updateMembrane();
+
+    // Feature branches are resolved once per step, the selected kernel carries none of them
+    int features = stepFeatures();
+    if (features != stepKernelFeatures)
     {
-        mass.force = glm::vec3(0.0f);
-        if (!mass.fixed)
-        {
-            glm::vec3 externalForces = forceManager.calculateTotalForce(mass, simulationTime);
-            mass.applyForce(externalForces);
-        }
+        stepKernel = selectStepKernel(features);
+        stepKernelFeatures = features;
     }
 
-    applySpringForces();
-
-    for (auto &mass : masses)
+    int steps = substeps;
+    if (timestepParams.enabled)
     {
-        mass.update(dt);
+        adaptiveDt = adaptTimestep(adaptiveDt, dt);
+        steps = std::max(steps, static_cast<int>(std::ceil(dt / adaptiveDt)));
     }
+    lastStepCount = steps;
+    lastStepDt = dt / steps;
+    for (int substep = 0; substep < steps; substep++)
+        (this->*stepKernel)(dt / steps);
 
-    applySpringForces();
-
-    for (int iter = 0; iter < solverIterations; ++iter)
+    if (enableTensionBreaking)
     {
-        for (auto &spring : springs)
-        {
-            Mass &massA = masses[spring.a];
-            Mass &massB = masses[spring.b];
-
-            glm::vec3 delta = massB.position - massA.position;
-            float currentLength = glm::length(delta);
-
-            if (currentLength < 0.0001f)
-                continue;
-
-            float difference = currentLength - spring.restLength;
-            glm::vec3 direction = delta / currentLength;
-
-            if (currentLength > spring.restLength * maxStretchRatio)
-            {
-                float maxLength = spring.restLength * maxStretchRatio;
-                float overStretch = currentLength - maxLength;
-                float correction = overStretch * 0.5f;
-
-                if (!massA.fixed)
-                    massA.position += direction * correction;
-                if (!massB.fixed)
-                    massB.position -= direction * correction;
-            }
-            else
-            {
-                glm::vec3 correction = direction * difference * 0.5f;
-                float correctionFactorScaled = correctionFactor * (spring.stiffness / 100.0f);
-
-                if (!massA.fixed)
-                    massA.position += correction * correctionFactorScaled;
-                if (!massB.fixed)
-                    massB.position -= correction * correctionFactorScaled;
-            }
-        }
-
-        if (enableCollisions)
-            for (auto *obj : collisionObjects)
-            {
-                for (auto &mass : masses)
-                {
-                    if (!mass.fixed)
-                    {
-                        glm::vec3 correction;
-                        if (obj->checkCollision(mass.position, correction))
-                        {
-                            mass.position += correction;
-
-                            float correctionLength = glm::length(correction);
-                            if (correctionLength > 0.001f)
-                            {
-                                glm::vec3 normal = correction / correctionLength;
-                            }
-                        }
-                    }
-                }
-            }
+        checkSpringTension();
     }
 
-    for (auto &mass : masses)
+    if (refinementParams.enabled)
     {
-        if (mass.position.y < floorY)
-        {
-            mass.position.y = floorY;
-            mass.prevPosition.y = floorY;
-        }
+        adaptMesh();
     }
 
-    if (enableTensionBreaking)
+    // Training snapshots are only valid for the topology and pins the recording started with
+    if (preview.isTraining())
     {
-        checkSpringTension();
+        if (preview.trainedOn(topologyVersion, pinsVersion, static_cast<int>(masses.size())))
+            preview.record(masses, externalAcceleration(), dt, TaskScheduler::instance());
+        else
+            preview.clear();
     }
+}
 
-    analysis.updateGlobalStats(masses, springs, simulationTime);
+bool Cloth::advancePreview(float dt)
+{
+    if (!previewParams.enabled || selectedMassIndex >= 0 ||
+        !preview.matches(topologyVersion, pinsVersion, static_cast<int>(masses.size())))
+        return false;
 
-    if (trackingMode && trackedMassIndex >= 0 && trackedMassIndex < masses.size())
+    if (!previewRunning)
     {
-        analysis.recordMassPointData(trackedMassIndex, masses[trackedMassIndex], springs, simulationTime);
+        preview.begin(masses);
+        previewAccumulator = 0.0f;
+        previewRunning = true;
     }
 
-    rebuildGraphicsData();
-    rebuildTextureData();
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_masses);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, massesVertices.size() * sizeof(float), massesVertices.data());
+    // The fitted dynamics only know the training step size, slow frames drop time instead of spiraling
+    float stepDt = preview.getTrainingDt();
+    previewAccumulator += dt;
+    int steps = std::min(static_cast<int>(previewAccumulator / stepDt), MAX_PREVIEW_STEPS);
+    previewAccumulator = std::min(previewAccumulator - steps * stepDt, stepDt);
+
+    glm::vec3 acceleration = externalAcceleration();
+    for (int step = 0; step < steps; step++)
+        preview.step(acceleration);
+    if (steps > 0)
+        preview.reconstruct(masses, TaskScheduler::instance());
+
+    lastStepCount = steps;
+    lastStepDt = stepDt;
+    return true;
+}
 
-    if (VAO_lines != 0)
+glm::vec3 Cloth::externalAcceleration() const
+{
+    for (const Mass &mass : masses)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_lines);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, lineVertices.size() * sizeof(float), lineVertices.data());
-    }
-
-    if (VAO_texture != 0)
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, textureVertices.size() * sizeof(float), textureVertices.data());
+        if (!mass.fixed)
+            return forceManager.calculateTotalForce(mass, simulationTime) / mass.mass;
     }
+    return glm::vec3(0.0f);
 }
-void Mass::update(float dt)
+
+void Cloth::update(float dt)
 {
-    if (fixed)
-    {
-        force = glm::vec3(0.0f);
-        return;
-    }
+    auto updateStart = std::chrono::steady_clock::now();
+    resetFrameArena();
 
-    glm::vec3 acceleration = force / mass;
+    if (timestepParams.enabled)
+        dt = std::min(dt, timestepParams.maxFrameDt);
+    simulationTime += dt;
+    positionsVersion++;
 
-    glm::vec3 currentPosition = position;
-    float damping = 0.99f;
-    position = position + (position - prevPosition) * damping + acceleration * (dt * dt);
-    prevPosition = currentPosition;
+    bool previewFrame = advancePreview(dt);
+    if (!previewFrame)
+        advanceFull(dt);
+    // A preview frame shorter than its step leaves the positions as they were
+    bool moved = !previewFrame || lastStepCount > 0;
 
-    force = glm::vec3(0.0f);
-}
+    // Statistics and normals only read positions, they run side by side before the buffers are filled
+    // The preview is for tuning by eye, its statistics are thinned out
+    int interval = previewFrame ? std::max(analysisInterval, PREVIEW_ANALYSIS_INTERVAL) : analysisInterval;
+    bool statsDue = moved && ++analysisFrame >= interval;
+    if (statsDue)
+        analysisFrame = 0;
 
-void Mass::applyForce(const glm::vec3 &force)
-{
-    this->force += force;
-}
+    auto stats = [&]() {
+        if (!statsDue)
+            return;
 
-int Cloth::pickMassPoint(const Ray &ray)
-{
-    float closestDistance = std::numeric_limits<float>::max();
-    int closestIndex = -1;
-    const float PICK_DISTANCE_THRESHOLD = 0.1f;
+        analysis.updateGlobalStats(masses, springs, simulationTime);
 
-    for (int i = 0; i < masses.size(); ++i)
-    {
-        const Mass &mass = masses[i];
+        if (grid.active())
+        {
+            float totalTension = 0.0f;
+            float maxTension = 0.0f;
+            grid.forEachEdge([&](int, int a, int b, float restLength, int) {
+                float currentLength = glm::length(masses[b].position - masses[a].position);
+                float tension = std::abs((currentLength - restLength) / restLength);
+                totalTension += tension;
+                maxTension = std::max(maxTension, tension);
+            });
+            analysis.setTensionStats(grid.intactCount() > 0 ? totalTension / grid.intactCount() : 0.0f,
+                                     maxTension);
+        }
+        else if (membrane.active())
+        {
+            float totalTension = 0.0f;
+            float maxTension = 0.0f;
+            for (int e = 0; e < membrane.getElementCount(); ++e)
+            {
+                float tension = std::abs(membrane.principalStretch(masses, e) - 1.0f);
+                totalTension += tension;
+                maxTension = std::max(maxTension, tension);
+            }
+            analysis.setTensionStats(totalTension / membrane.getElementCount(), maxTension);
+        }
 
-        glm::vec3 toMass = mass.position - ray.Origin();
-        float projection = glm::dot(toMass, ray.Direction());
+        if (trackingMode && trackedMassIndex >= 0 && trackedMassIndex < masses.size())
+        {
+            analysis.recordMassPointData(trackedMassIndex, masses[trackedMassIndex],
+                                         springsAround(trackedMassIndex), simulationTime);
+        }
+    };
+    // Normals are read by the drawn surface and by the curvature test of refinement only
+    auto normals = [&]() {
+        if (moved && (!headless || refinementParams.enabled))
+            calculateNormals();
+    };
+    // Picking and cutting only query the index, it is refitted here once per frame
+    auto pickIndex = [&]() {
+        if (!headless)
+            updatePickIndex();
+    };
 
-        if (projection < 0)
-            continue;
+    TaskGraph graph(&frameArena);
+    graph.add(stats);
+    graph.add(normals);
+    graph.add(pickIndex);
+    graph.run(TaskScheduler::instance());
 
-        glm::vec3 closestPoint = ray.Origin() + ray.Direction() * projection;
-        float distance = glm::length(mass.position - closestPoint);
+    if (!headless)
+    {
+        rebuildGraphicsData();
+        rebuildTextureData();
+    }
 
-        if (distance < PICK_DISTANCE_THRESHOLD && distance < closestDistance)
+    if (governor.getParams().enabled)
+    {
+        float stepMs =
+            std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+        GovernedSettings settings{solverIterations, substeps, analysisInterval};
+        if (governor.update(stepMs, simulationTime, settings))
         {
-            closestDistance = distance;
-            closestIndex = i;
+            solverIterations = settings.iterations;
+            substeps = settings.substeps;
+            analysisInterval = settings.analysisInterval;
         }
     }
-
-    selectedMassIndex = closestIndex;
-    return closestIndex;
 }
 
-void Cloth::setMassPosition(int index, const glm::vec3 &position)
+// Feature bits of the step kernel table
+enum StepFeature
 {
-    if (index >= 0 && index < masses.size())
-    {
-        glm::vec3 clampedPos = position;
-        clampedPos.x = glm::clamp(clampedPos.x, -10.0f, 10.0f);
-        clampedPos.z = glm::clamp(clampedPos.z, -10.0f, 10.0f);
-        clampedPos.y = glm::max(clampedPos.y, floorY);
+    STEP_COLLISIONS = 1,
+    STEP_PINNED = 2,
+    STEP_RECORD_STRAIN = 4,
+    STEP_STRUCTURED = 8
+};
 
-        masses[index].position = clampedPos;
-        checkTearingAroundPoint(index);
-    }
+int Cloth::stepFeatures() const
+{
+    int features = 0;
+    if (enableCollisions && !collisionObjects.empty())
+        features |= STEP_COLLISIONS;
+    // Pins usually sit in the first row, the search stops there
+    if (std::any_of(masses.begin(), masses.end(), [](const Mass &mass) { return mass.fixed; }))
+        features |= STEP_PINNED;
+    // Strain of the last iteration is read by fracture detection, refinement and the adaptive step only, the grid
+    // measures stretch from the positions
+    if ((enableTensionBreaking || refinementParams.enabled || timestepParams.enabled) && !grid.active())
+        features |= STEP_RECORD_STRAIN;
+    if (grid.active())
+        features |= STEP_STRUCTURED;
+    return features;
 }
 
-void Cloth::checkTearingAroundPoint(int massIndex)
+float Cloth::adaptTimestep(float previousStable, float frameDt)
 {
-    const float tearThreshold = 20.0f;
-
-    bool springsRemoved = false;
-    for (auto it = springs.begin(); it != springs.end();)
+    if (minRestTopology != topologyVersion)
     {
-        if (it->a == massIndex || it->b == massIndex)
+        minRestLength = std::numeric_limits<float>::max();
+        if (grid.active())
+            grid.forEachEdge([&](int, int, int, float restLength, int) {
+                minRestLength = std::min(minRestLength, restLength);
+            });
+        for (const auto &spring : springs)
+            minRestLength = std::min(minRestLength, spring.restLength);
+        if (activeMembraneModel() == MembraneModel::COROTATIONAL)
         {
-            Mass &massA = masses[it->a];
-            Mass &massB = masses[it->b];
-
-            glm::vec3 delta = massB.position - massA.position;
-            float currentLength = glm::length(delta);
-            float stretchRatio = currentLength / it->restLength;
-
-            if (stretchRatio > tearThreshold)
+            for (int i = 0; i < textureIndices.size(); ++i)
             {
-                it = springs.erase(it);
-                springsRemoved = true;
-                continue;
+                const Mass &a = masses[textureIndices[i]];
+                const Mass &b = masses[textureIndices[i % 3 == 2 ? i - 2 : i + 1]];
+                float restLength = glm::length((b.texCoord - a.texCoord) * glm::vec2(width, height));
+                minRestLength = std::min(minRestLength, restLength);
             }
         }
-        ++it;
+        minRestTopology = topologyVersion;
     }
 
-    if (springsRemoved)
+    struct MotionBounds
     {
-        rebuildTextureData();
+        float maxTravel = 0.0f;
+        float minMass = std::numeric_limits<float>::max();
+    };
+    MotionBounds motion = TaskScheduler::instance().parallelReduce(
+        0, static_cast<int>(masses.size()), MASS_GRAIN, MotionBounds(),
+        [&](int begin, int end) {
+            MotionBounds partial;
+            for (int i = begin; i < end; ++i)
+            {
+                if (masses[i].fixed)
+                    continue;
+                float travel = glm::length(masses[i].position - masses[i].prevPosition);
+                partial.maxTravel = std::max(partial.maxTravel, travel);
+                partial.minMass = std::min(partial.minMass, masses[i].mass);
+            }
+            return partial;
+        },
+        [](MotionBounds a, const MotionBounds &b) {
+            a.maxTravel = std::max(a.maxTravel, b.maxTravel);
+            a.minMass = std::min(a.minMass, b.minMass);
+            return a;
+        });
+
+    float stable = timestepParams.maxDt;
+
+    // Explicit spring forces oscillate at sqrt(k (1 / mA + 1 / mB)), the step must stay below 2 / omega
+    float maxStiffness = 0.0f;
+    for (const auto &material : materials)
+        maxStiffness = std::max(maxStiffness, material.stiffness);
+    if (maxStiffness > 0.0f && motion.minMass < std::numeric_limits<float>::max())
+        stable = std::min(stable, timestepParams.safety * 2.0f / std::sqrt(2.0f * maxStiffness / motion.minMass));
+
+    // No mass may cross more than a fraction of the shortest spring in one step
+    if (previousDt > 0.0f && motion.maxTravel > 0.0f && minRestLength < std::numeric_limits<float>::max())
+    {
+        float maxSpeed = motion.maxTravel / previousDt;
+        stable = std::min(stable, timestepParams.maxTravel * minRestLength / maxSpeed);
     }
-}
 
-void Cloth::releaseMassPoint(int index)
-{
-    if (index == selectedMassIndex)
+    // Largest stretch the last step left, springs and elements hold the ratio of their last solver iteration and
+    // the grid keeps none, its edges are measured from the positions
+    auto maxRatio = [](float a, float b) { return std::max(a, b); };
+    float maxStrain;
+    if (grid.active())
     {
-        selectedMassIndex = -1;
+        maxStrain = TaskScheduler::instance().parallelReduce(
+            0, grid.rowCount(), GRID_ROW_GRAIN, 1.0f,
+            [&](int begin, int end) {
+                float partial = 1.0f;
+                grid.forEachEdge(begin, end, [&](int, int a, int b, float restLength, int) {
+                    partial = std::max(partial, glm::length(masses[b].position - masses[a].position) / restLength);
+                });
+                return partial;
+            },
+            maxRatio);
     }
-}
-
-bool Cloth::springIntersectsSegment(const Spring &spring, const glm::vec3 &segmentStart, const glm::vec3 &segmentEnd,
-                                    glm::vec3 &intersectionPoint)
-{
-    const Mass &massA = masses[spring.a];
-    const Mass &massB = masses[spring.b];
-
-    glm::vec3 springStart = massA.position;
-    glm::vec3 springEnd = massB.position;
-    glm::vec3 segmentDir = segmentEnd - segmentStart;
-    float segmentLength = glm::length(segmentDir);
-
-    if (segmentLength < 0.001f)
-        return false;
-    segmentDir = segmentDir / segmentLength;
-
-    glm::vec3 springCenter = (springStart + springEnd) * 0.5f;
-    glm::vec3 toCenter = springCenter - segmentStart;
-    float projection = glm::dot(toCenter, segmentDir);
-    projection = glm::clamp(projection, 0.0f, segmentLength);
-    glm::vec3 closestPointOnSegment = segmentStart + segmentDir * projection;
-    float distance = glm::length(springCenter - closestPointOnSegment);
-    float threshold = 0.3f;
-
-    if (distance <= threshold)
+    else
     {
-        intersectionPoint = springCenter;
-        return true;
+        maxStrain = TaskScheduler::instance().parallelReduce(
+            0, fracture.size(), SPRING_GRAIN, 1.0f,
+            [&](int begin, int end) {
+                float partial = 1.0f;
+                for (int i = begin; i < end; ++i)
+                {
+                    if (!fracture.isBroken(i))
+                        partial = std::max(partial, fracture.getStrain(i));
+                }
+                return partial;
+            },
+            maxRatio);
     }
 
-    return false;
+    // The sample belongs to the state before this frame, the rate uses the time simulated since the last one
+    // Tearing and quickly growing stretch shrink the step, a cloth resting at a high stretch does not
+    float sampleTime = simulationTime - frameDt;
+    float elapsed = sampleTime - lastStrainTime;
+    float strainRate = (lastStrainTime >= 0.0f && elapsed > 0.0f) ? (maxStrain - lastMaxStrain) / elapsed : 0.0f;
+    if (strainRate > timestepParams.strainRateLimit)
+        stable *= std::max(timestepParams.strainRateLimit / strainRate, 0.25f);
+    if (analysis.getTotalBrokenSprings() > lastBrokenCount)
+        stable *= timestepParams.tearingScale;
+    lastMaxStrain = maxStrain;
+    lastStrainTime = sampleTime;
+    lastBrokenCount = analysis.getTotalBrokenSprings();
+
+    // Shrink at once, grow gradually so a calm frame after a violent one does not jump back
+    stable = std::min(stable, previousStable * timestepParams.maxGrowth);
+    return std::clamp(stable, timestepParams.minDt, timestepParams.maxDt);
 }
 
-void Cloth::cleanupBuffers()
+SolverPass Cloth::schedulePass(int iteration, bool bendingDue) const
 {
-    if (VAO_masses != 0)
-    {
-        glDeleteVertexArrays(1, &VAO_masses);
-        glDeleteBuffers(1, &VBO_masses);
-        VAO_masses = 0;
-        VBO_masses = 0;
-    }
-
-    if (VAO_lines != 0)
-    {
-        glDeleteVertexArrays(1, &VAO_lines);
-        glDeleteBuffers(1, &VBO_lines);
-        VAO_lines = 0;
-        VBO_lines = 0;
-    }
+    SolverPass pass(correctionFactor);
+    if (!scheduleParams.enabled)
+        return pass;
 
-    if (VAO_texture != 0)
+    pass.families = 0;
+    for (int family = 0; family < SPRING_FAMILY_COUNT; ++family)
     {
-        glDeleteVertexArrays(1, &VAO_texture);
-        glDeleteBuffers(1, &VBO_texture);
-        glDeleteBuffers(1, &EBO_texture);
-        VAO_texture = 0;
-        VBO_texture = 0;
-        EBO_texture = 0;
+        const FamilySchedule &schedule = scheduleParams.families[family];
+        bool due = iteration < std::min(schedule.iterations, solverIterations);
+        if (static_cast<SpringFamily>(family) == SpringFamily::BENDING)
+            due = due && bendingDue;
+
+        if (due)
+            pass.families |= 1u << family;
+        pass.correction[family] = correctionFactor * schedule.relaxation;
     }
+    return pass;
 }
 
-void Cloth::resize(float newWidth, float newHeight, int newResX, int newResY)
+int Cloth::scheduledIterations(bool bendingDue) const
 {
-    width = newWidth;
-    height = newHeight;
-    resX = newResX;
-    resY = newResY;
+    if (!scheduleParams.enabled)
+        return solverIterations;
 
-    cleanupBuffers();
-    initCloth();
+    int iterations = 0;
+    for (int family = 0; family < SPRING_FAMILY_COUNT; ++family)
+    {
+        if (static_cast<SpringFamily>(family) == SpringFamily::BENDING && !bendingDue)
+            continue;
+        iterations = std::max(iterations, std::min(scheduleParams.families[family].iterations, solverIterations));
+    }
+    return iterations;
 }
 
-void Cloth::cutSpringsWithRay(const Ray &ray, const glm::vec3 &previousMousePos, const glm::mat4 &view,
-                              const glm::mat4 &projection, int screenWidth, int screenHeight)
+void Cloth::updateSpringBatches()
 {
-    glm::mat4 viewProjection = projection * view;
+    // The grid and the tiles keep their own batches
+    if (!scheduleParams.enabled || grid.active())
+    {
+        for (auto &batch : springBatches)
+            batch.clear();
+        batchesTopology = -1;
+        return;
+    }
 
-    std::vector<int> springsToCut;
-    springsToCut.reserve(50);
+    if (batchesTopology == topologyVersion && batchesSpringCount == springs.size())
+        return;
 
-    float cutThresholdPixels = 10.0f;
+    for (auto &batch : springBatches)
+        batch.clear();
+    for (int i = 0; i < springs.size(); ++i)
+        springBatches[static_cast<int>(materials[springs[i].material].family)].push_back(i);
 
-    auto worldToScreen = [&](const glm::vec3 &worldPos) -> glm::vec3 {
-        glm::vec4 clipSpace = viewProjection * glm::vec4(worldPos, 1.0f);
+    batchesTopology = topologyVersion;
+    batchesSpringCount = static_cast<int>(springs.size());
+}
 
-        if (std::abs(clipSpace.w) < 0.0001f)
-            return glm::vec3(-9999.0f);
+MembraneModel Cloth::activeMembraneModel() const
+{
+    return clothMesh.triangleCount() > 0 ? MembraneModel::MASS_SPRING : membraneModel;
+}
 
-        float invW = 1.0f / clipSpace.w;
-        glm::vec3 ndc = glm::vec3(clipSpace) * invW;
+bool Cloth::usesHinges() const
+{
+    return bendingModel == BendingModel::DIHEDRAL || activeMembraneModel() == MembraneModel::COROTATIONAL;
+}
 
-        return glm::vec3((ndc.x + 1.0f) * 0.5f * screenWidth, (1.0f - ndc.y) * 0.5f * screenHeight, clipSpace.w);
-    };
+void Cloth::updateDihedral()
+{
+    if (!usesHinges())
+    {
+        dihedral.clear();
+        dihedralTopology = -1;
+        return;
+    }
 
-    float distToPrev = glm::length(previousMousePos - ray.Origin());
-    glm::vec3 currentMouseWorldPos = ray.Origin() + ray.Direction() * distToPrev;
+    if (dihedralTopology == topologyVersion && dihedralTriangles == textureIndices.size())
+        return;
 
-    glm::vec3 currentScreen = worldToScreen(currentMouseWorldPos);
-    glm::vec3 previousScreen = worldToScreen(previousMousePos);
+    dihedral.build(textureIndices, restPositions, &grid);
+    dihedralTopology = topologyVersion;
+    dihedralTriangles = static_cast<int>(textureIndices.size());
+}
 
-    if (currentScreen.x < -9000.0f || previousScreen.x < -9000.0f)
+void Cloth::updateMembrane()
+{
+    if (activeMembraneModel() != MembraneModel::COROTATIONAL)
     {
+        membrane.clear();
+        membraneTopology = -1;
         return;
     }
 
-    glm::vec2 screenSegment = glm::vec2(currentScreen.x - previousScreen.x, currentScreen.y - previousScreen.y);
-    float segmentLength = glm::length(screenSegment);
+    if (membraneTopology == topologyVersion && membraneTriangles == textureIndices.size())
+        return;
 
-    if (segmentLength < 1.0f)
+    membrane.build(masses, textureIndices, glm::vec2(width, height));
+    membraneTopology = topologyVersion;
+    membraneTriangles = static_cast<int>(textureIndices.size());
+
+    // Element tearing removes state in step with the triangles, anything else that rewrote them starts over
+    if (fracture.size() != membrane.getElementCount())
+        fracture.reset(membrane.getElementCount());
+}
+
+void Cloth::updateTethers()
+{
+    if (!tetherParams.enabled)
     {
+        tethers.clear();
+        tethersTopology = -1;
         return;
     }
 
-    glm::vec2 segmentDir = screenSegment / segmentLength;
-    glm::vec2 prevScreen2D = glm::vec2(previousScreen.x, previousScreen.y);
+    // Tearing and refinement change the paths, a region cut off from every pin loses its tethers
+    if (tethersTopology == topologyVersion && tethersPins == pinsVersion && tethersMassCount == masses.size())
+        return;
 
-    float cutThresholdSq = cutThresholdPixels * cutThresholdPixels;
+    if (grid.active())
+        tethers.build(masses, grid);
+    else if (activeMembraneModel() == MembraneModel::COROTATIONAL)
+        tethers.build(masses, textureIndices, glm::vec2(width, height));
+    else
+        tethers.build(masses, springs);
 
-    float margin = cutThresholdPixels * 1.5f;
-    float minX = std::min(previousScreen.x, currentScreen.x) - margin;
-    float maxX = std::max(previousScreen.x, currentScreen.x) + margin;
-    float minY = std::min(previousScreen.y, currentScreen.y) - margin;
-    float maxY = std::max(previousScreen.y, currentScreen.y) + margin;
+    tethersTopology = topologyVersion;
+    tethersPins = pinsVersion;
+    tethersMassCount = static_cast<int>(masses.size());
+}
 
-    for (int i = 0; i < springs.size(); ++i)
+void Cloth::updateTiles()
+{
+    if (!tiledSolver)
     {
-        const Mass &massA = masses[springs[i].a];
-        const Mass &massB = masses[springs[i].b];
+        tiles.clear();
+        return;
+    }
 
-        glm::vec3 springStart = massA.position;
-        glm::vec3 springEnd = massB.position;
-        glm::vec3 springMid = (springStart + springEnd) * 0.5f;
+    // Tearing and refinement move the load, the cuts are recomputed from the new springs
+    int tileCount = TaskScheduler::instance().getThreadCount();
+    if (tiles.active() && tilesTopology == topologyVersion && tilesMassCount == masses.size() &&
+        tiles.getTileCount() <= tileCount)
+        return;
 
-        glm::vec3 startScreen = worldToScreen(springStart);
-        glm::vec3 endScreen = worldToScreen(springEnd);
-        glm::vec3 midScreen = worldToScreen(springMid);
+    if (grid.active())
+        tiles.build(masses, grid, tileCount);
+    else
+        tiles.build(masses, springs, tileCount);
 
-        if (startScreen.x < -9000.0f && endScreen.x < -9000.0f && midScreen.x < -9000.0f)
-            continue;
+    tilesTopology = topologyVersion;
+    tilesMassCount = static_cast<int>(masses.size());
+}
 
-        bool shouldCut = false;
+Cloth::StepKernel Cloth::selectStepKernel(int features)
+{
+    // Indexed by the feature bits, every combination is instantiated
+    static const StepKernel kernels[] = {
+        &Cloth::step<false, false, false, false>,
+        &Cloth::step<true, false, false, false>,
+        &Cloth::step<false, true, false, false>,
+        &Cloth::step<true, true, false, false>,
+        &Cloth::step<false, false, true, false>,
+        &Cloth::step<true, false, true, false>,
+        &Cloth::step<false, true, true, false>,
+        &Cloth::step<true, true, true, false>,
+        &Cloth::step<false, false, false, true>,
+        &Cloth::step<true, false, false, true>,
+        &Cloth::step<false, true, false, true>,
+        &Cloth::step<true, true, false, true>,
+        &Cloth::step<false, false, true, true>,
+        &Cloth::step<true, false, true, true>,
+        &Cloth::step<false, true, true, true>,
+        &Cloth::step<true, true, true, true>,
+    };
+    return kernels[features];
+}
 
-        glm::vec3 pointsToCheck[3] = {startScreen, midScreen, endScreen};
+template <bool Collisions, bool Pinned, bool RecordStrain, bool Structured> void Cloth::step(float dt)
+{
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    const int massCount = static_cast<int>(masses.size());
 
-        for (int p = 0; p < 3; p++)
+    scheduler.parallelFor(0, massCount, MASS_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
         {
-            glm::vec3 point = pointsToCheck[p];
-
-            if (point.x < -9000.0f)
+            Mass &mass = masses[i];
+            mass.force = glm::vec3(0.0f);
+            if (Pinned && mass.fixed)
                 continue;
 
-            if (point.x < minX || point.x > maxX || point.y < minY || point.y > maxY)
-                continue;
+            mass.applyForce(forceManager.calculateTotalForce(mass, simulationTime));
+        }
+    });
 
-            glm::vec2 point2D = glm::vec2(point.x, point.y);
-            glm::vec2 toPoint = point2D - prevScreen2D;
+    auto springForces = [&]() {
+        if constexpr (Structured)
+        {
+            grid.applyForces(masses, materials, Pinned);
+        }
+        else
+        {
+            for (const auto &spring : springs)
+            {
+                applySpringForce<Pinned>(masses[spring.a], masses[spring.b], spring.restLength,
+                                         materials[spring.material]);
+            }
+        }
+    };
 
-            float projection = glm::dot(toPoint, segmentDir);
-            projection = glm::clamp(projection, 0.0f, segmentLength);
+    springForces();
 
-            glm::vec2 closestPoint = prevScreen2D + segmentDir * projection;
-            glm::vec2 diff = point2D - closestPoint;
+    const VerletStep verlet(dt, previousDt > 0.0f ? previousDt : dt);
+    previousDt = dt;
 
-            float distanceSq = diff.x * diff.x + diff.y * diff.y;
+    // Masses pushed out of a collider are refined around on the next pass
+    const bool markContacts = Collisions && refinementParams.enabled && refinementParams.splitContacts;
+    if (markContacts)
+        refineMarks.resize(massCount, 0);
 
-            if (distanceSq <= cutThresholdSq)
+    scheduler.parallelFor(0, massCount, MASS_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            if constexpr (Pinned)
+                masses[i].update(verlet);
+            else
+                masses[i].integrate(verlet);
+        }
+    });
+
+    springForces();
+
+    const bool bendingDue = stepCounter++ % std::max(scheduleParams.bendingInterval, 1) == 0;
+    const int iterations = scheduledIterations(bendingDue);
+
+    // Record: std::bool_constant, true on the last iteration when someone reads the strain
+    // Measure: std::bool_constant, accumulates the violation of the sweep into residual
+    SolverResidual residual;
+    auto iteration = [&](const SolverPass &pass, auto record, auto measure) {
+        constexpr bool recordStrain = decltype(record)::value;
+        constexpr bool measureResidual = decltype(measure)::value;
+
+        auto projectAt = [&](int i, float correction) {
+            const Spring &spring = springs[i];
+            float currentLength = projectSpring<Pinned>(masses[spring.a], masses[spring.b], spring.restLength,
+                                                        materials[spring.material].stiffness, correction,
+                                                        maxStretchRatio);
+            if constexpr (recordStrain)
+                fracture.setStrain(i, currentLength / spring.restLength);
+            if constexpr (measureResidual)
+                residual.add(currentLength / spring.restLength);
+        };
+
+        if (tiles.active())
+        {
+            tiles.solveIteration(masses, materials, pass, maxStretchRatio, recordStrain ? &fracture : nullptr, Pinned,
+                                 scheduler, measureResidual ? &residual : nullptr);
+        }
+        else if constexpr (Structured)
+        {
+            grid.solveIteration(masses, materials, pass, maxStretchRatio, Pinned,
+                                measureResidual ? &residual : nullptr);
+        }
+        else if (scheduleParams.enabled)
+        {
+            for (int family = 0; family < SPRING_FAMILY_COUNT; ++family)
             {
-                shouldCut = true;
-                break;
+                if (!pass.includes(static_cast<SpringFamily>(family)))
+                    continue;
+                for (int i : springBatches[family])
+                    projectAt(i, pass.correction[family]);
             }
         }
+        else
+        {
+            for (int i = 0; i < springs.size(); ++i)
+                projectAt(i, pass.correction[0]);
+        }
+
+        if (membrane.active() && (pass.includes(SpringFamily::STRUCTURAL) || pass.includes(SpringFamily::SHEAR)))
+        {
+            membrane.solveIteration(masses, materials, pass, membraneParams, maxStretchRatio,
+                                    recordStrain ? &fracture : nullptr, Pinned, scheduler,
+                                    measureResidual ? &residual : nullptr);
+        }
+
+        if (dihedral.active() && pass.includes(SpringFamily::BENDING))
+        {
+            const int bending = static_cast<int>(SpringFamily::BENDING);
+            float stiffness = pass.correction[bending] * (materials[bending].stiffness / 100.0f);
+            dihedral.solveIteration(masses, std::min(stiffness, 1.0f), Pinned, scheduler);
+        }
+
+        // Tethers run after the springs so the stretch they leave along the pinned paths is removed
+        if (tethers.active())
+            tethers.project(masses, tetherParams.slack, scheduler);
+
+        // Masses collide independently, each one still tests the objects in order
+        if constexpr (Collisions)
+        {
+            scheduler.parallelFor(0, massCount, MASS_GRAIN, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i)
+                {
+                    Mass &mass = masses[i];
+                    if (Pinned && mass.fixed)
+                        continue;
+
+                    for (auto *obj : collisionObjects)
+                    {
+                        glm::vec3 correction;
+                        if (obj->checkCollision(mass.position, correction))
+                        {
+                            mass.position += correction;
+                            if (markContacts)
+                                refineMarks[i] |= CONTACT_MARK;
+                        }
+                    }
+                }
+            });
+        }
+    };
+
+    if (convergenceParams.enabled)
+    {
+        // Any iteration may be the last one, so each of them records the strain when it is read
+        // The violation is measured before the corrections of the sweep, the result is at least as good
+        analysis.clearResidualCurve();
+        float previousViolation = std::numeric_limits<float>::max();
+        for (int iter = 0; iter < iterations; ++iter)
+        {
+            residual = SolverResidual();
+            iteration(schedulePass(iter, bendingDue), std::bool_constant<RecordStrain>(), std::true_type());
+            analysis.recordResidual(residual.maxViolation, residual.rms());
+
+            // Gauss-Seidel removes long wavelength errors slowly, stalled iterations are not worth their cost
+            float violation = convergenceParams.useRms ? residual.rms() : residual.maxViolation;
+            bool converged = violation <= convergenceParams.tolerance;
+            bool stalled = convergenceParams.minImprovement > 0.0f &&
+                           violation > previousViolation * (1.0f - convergenceParams.minImprovement);
+            if (iter + 1 >= convergenceParams.minIterations && (converged || stalled))
+                break;
+            previousViolation = violation;
+        }
+    }
+    else if (scheduleParams.enabled)
+    {
+        // Families drop out after their own count, every iteration records the strain of the springs it projects
+        for (int iter = 0; iter < iterations; ++iter)
+            iteration(schedulePass(iter, bendingDue), std::bool_constant<RecordStrain>(), std::false_type());
+    }
+    else
+    {
+        const SolverPass pass(correctionFactor);
+        for (int iter = 0; iter + 1 < iterations; ++iter)
+            iteration(pass, std::false_type(), std::false_type());
+        if (iterations > 0)
+            iteration(pass, std::bool_constant<RecordStrain>(), std::false_type());
+    }
+
+    scheduler.parallelFor(0, massCount, MASS_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            Mass &mass = masses[i];
+            if (mass.position.y < floorY)
+            {
+                mass.position.y = floorY;
+                mass.prevPosition.y = floorY;
+            }
+        }
+    });
+}
+
+VerletStep::VerletStep(float dt, float previousDt)
+{
+    // Damping is defined per reference step, so the loss per second does not depend on the step size
+    const float damping = 0.99f;
+    const float dampingReferenceDt = 0.016f;
+
+    velocityScale = std::pow(damping, dt / dampingReferenceDt) * (dt / previousDt);
+    accelerationScale = dt * (dt + previousDt) * 0.5f;
+}
+
+void Mass::update(const VerletStep &step)
+{
+    if (fixed)
+    {
+        force = glm::vec3(0.0f);
+        return;
+    }
+
+    integrate(step);
+}
+
+void Mass::integrate(const VerletStep &step)
+{
+    glm::vec3 acceleration = force / mass;
+
+    glm::vec3 currentPosition = position;
+    position = position + (position - prevPosition) * step.velocityScale + acceleration * step.accelerationScale;
+    prevPosition = currentPosition;
+
+    force = glm::vec3(0.0f);
+}
+
+void Mass::applyForce(const glm::vec3 &force)
+{
+    this->force += force;
+}
+
+void Cloth::updatePickIndex()
+{
+    if (pickIndexState.positions == positionsVersion && pickIndexState.topology == topologyVersion)
+        return;
+
+    bool rebuild = pickIndexState.topology != topologyVersion;
+
+    primitiveBounds.clear();
+    for (int i = 0; i + 2 < textureIndices.size(); i += 3)
+    {
+        const glm::vec3 &v0 = masses[textureIndices[i]].position;
+        const glm::vec3 &v1 = masses[textureIndices[i + 1]].position;
+        const glm::vec3 &v2 = masses[textureIndices[i + 2]].position;
+        primitiveBounds.emplace_back(glm::min(v0, glm::min(v1, v2)), glm::max(v0, glm::max(v1, v2)));
+    }
+
+    if (rebuild)
+        triangleBVH.build(primitiveBounds);
+    else
+        triangleBVH.refit(primitiveBounds);
+
+    primitiveBounds.clear();
+    for (const auto &mass : masses)
+    {
+        primitiveBounds.emplace_back(mass.position - glm::vec3(pickRadius), mass.position + glm::vec3(pickRadius));
+    }
+
+    if (rebuild)
+        massBVH.build(primitiveBounds);
+    else
+        massBVH.refit(primitiveBounds);
+
+    pickIndexState.positions = positionsVersion;
+    pickIndexState.topology = topologyVersion;
+}
+
+void Cloth::updateCutIndex()
+{
+    if (cutIndexState.positions == positionsVersion && cutIndexState.topology == topologyVersion)
+        return;
+
+    // Grid edges are indexed by edge id, which stays the spring id when the grid becomes explicit
+    int count = grid.active() ? grid.edgeCount() : static_cast<int>(springs.size());
+    primitiveBounds.clear();
+    for (int i = 0; i < count; ++i)
+    {
+        int a, b;
+        springEndpoints(i, a, b);
+        const glm::vec3 &pa = masses[a].position;
+        const glm::vec3 &pb = masses[b].position;
+        primitiveBounds.emplace_back(glm::min(pa, pb), glm::max(pa, pb));
+    }
+
+    if (cutIndexState.topology != topologyVersion)
+        springBVH.build(primitiveBounds);
+    else
+        springBVH.refit(primitiveBounds);
+
+    cutIndexState.positions = positionsVersion;
+    cutIndexState.topology = topologyVersion;
+}
+
+bool Cloth::pickIndexCurrent() const
+{
+    return pickIndexState.topology == topologyVersion;
+}
+
+int Cloth::pickMassPoint(const Ray &ray)
+{
+    // The index is refitted by update, between a tear and the next frame every primitive is tested
+    const bool indexed = pickIndexCurrent();
+
+    // Depth of the first visible surface along the ray
+    float surfaceT = std::numeric_limits<float>::max();
+    auto hitTriangle = [&](int tri, float &tMax) {
+        float t;
+        if (rayTriangleIntersect(ray, masses[textureIndices[tri * 3]].position,
+                                 masses[textureIndices[tri * 3 + 1]].position,
+                                 masses[textureIndices[tri * 3 + 2]].position, t) &&
+            t < tMax)
+        {
+            tMax = t;
+        }
+    };
+    if (indexed)
+    {
+        triangleBVH.intersectRay(ray, surfaceT, hitTriangle);
+    }
+    else
+    {
+        for (int tri = 0; tri * 3 < textureIndices.size(); ++tri)
+            hitTriangle(tri, surfaceT);
+    }
+
+    // Masses behind the front layer are occluded, allow pickRadius of slack for the surface itself
+    float maxT = surfaceT;
+    if (maxT < std::numeric_limits<float>::max())
+        maxT += pickRadius;
+
+    float closestDistance = std::numeric_limits<float>::max();
+    int closestIndex = -1;
+
+    auto hitMass = [&](int i, float &tMax) {
+        const Mass &mass = masses[i];
+
+        glm::vec3 toMass = mass.position - ray.Origin();
+        float projection = glm::dot(toMass, ray.Direction());
+
+        if (projection < 0 || projection > tMax)
+            return;
+
+        glm::vec3 closestPoint = ray.Origin() + ray.Direction() * projection;
+        float distance = glm::length(mass.position - closestPoint);
+
+        if (distance < pickRadius && distance < closestDistance)
+        {
+            closestDistance = distance;
+            closestIndex = i;
+        }
+    };
+    if (indexed)
+    {
+        massBVH.intersectRay(ray, maxT, hitMass);
+    }
+    else
+    {
+        for (int i = 0; i < masses.size(); ++i)
+            hitMass(i, maxT);
+    }
+
+    selectedMassIndex = closestIndex;
+    return closestIndex;
+}
+
+void Cloth::setMassPosition(int index, const glm::vec3 &position)
+{
+    if (index >= 0 && index < masses.size())
+    {
+        glm::vec3 clampedPos = position;
+        clampedPos.x = glm::clamp(clampedPos.x, -10.0f, 10.0f);
+        clampedPos.z = glm::clamp(clampedPos.z, -10.0f, 10.0f);
+        clampedPos.y = glm::max(clampedPos.y, floorY);
+
+        masses[index].position = clampedPos;
+        positionsVersion++;
+        checkTearingAroundPoint(index);
+    }
+}
+
+void Cloth::checkTearingAroundPoint(int massIndex)
+{
+    const float tearThreshold = 20.0f;
+
+    bool springsRemoved = false;
+    if (grid.active())
+    {
+        for (const auto &spring : springsAround(massIndex))
+        {
+            float currentLength = glm::length(masses[spring.b].position - masses[spring.a].position);
+            if (currentLength / spring.restLength > tearThreshold)
+            {
+                grid.breakEdge(grid.edgeBetween(spring.a, spring.b));
+                springsRemoved = true;
+            }
+        }
+    }
+    else if (membrane.active())
+    {
+        // Only the fan of the dragged mass is checked, element e is triangle e
+        updateMassLinks();
+        for (const int *e = massTriangleLinks.begin(massIndex); e != massTriangleLinks.end(massIndex); ++e)
+        {
+            if (membrane.principalStretch(masses, *e) > tearThreshold)
+            {
+                fracture.markBroken(*e);
+                springsRemoved = true;
+            }
+        }
+    }
+    else
+    {
+        updateMassLinks();
+        for (const int *s = massSpringLinks.begin(massIndex); s != massSpringLinks.end(massIndex); ++s)
+        {
+            const Spring &spring = springs[*s];
+            float currentLength = glm::length(masses[spring.b].position - masses[spring.a].position);
+            if (currentLength / spring.restLength > tearThreshold)
+            {
+                fracture.markBroken(*s);
+                springsRemoved = true;
+            }
+        }
+    }
+
+    if (springsRemoved)
+    {
+        removeBrokenSprings();
+    }
+}
+
+void Cloth::releaseMassPoint(int index)
+{
+    if (index == selectedMassIndex)
+    {
+        selectedMassIndex = -1;
+    }
+}
+
+bool Cloth::springIntersectsSegment(const Spring &spring, const glm::vec3 &segmentStart, const glm::vec3 &segmentEnd,
+                                    glm::vec3 &intersectionPoint)
+{
+    const Mass &massA = masses[spring.a];
+    const Mass &massB = masses[spring.b];
+
+    glm::vec3 springStart = massA.position;
+    glm::vec3 springEnd = massB.position;
+    glm::vec3 segmentDir = segmentEnd - segmentStart;
+    float segmentLength = glm::length(segmentDir);
+
+    if (segmentLength < 0.001f)
+        return false;
+    segmentDir = segmentDir / segmentLength;
+
+    glm::vec3 springCenter = (springStart + springEnd) * 0.5f;
+    glm::vec3 toCenter = springCenter - segmentStart;
+    float projection = glm::dot(toCenter, segmentDir);
+    projection = glm::clamp(projection, 0.0f, segmentLength);
+    glm::vec3 closestPointOnSegment = segmentStart + segmentDir * projection;
+    float distance = glm::length(springCenter - closestPointOnSegment);
+    float threshold = 0.3f;
+
+    if (distance <= threshold)
+    {
+        intersectionPoint = springCenter;
+        return true;
+    }
+
+    return false;
+}
+
+void Cloth::cleanupBuffers()
+{
+    if (VAO_masses != 0)
+    {
+        glDeleteVertexArrays(1, &VAO_masses);
+        glDeleteBuffers(1, &VBO_masses);
+        VAO_masses = 0;
+        VBO_masses = 0;
+    }
+
+    if (VAO_lines != 0)
+    {
+        glDeleteVertexArrays(1, &VAO_lines);
+        glDeleteBuffers(1, &VBO_lines);
+        VAO_lines = 0;
+        VBO_lines = 0;
+    }
+
+    if (VAO_texture != 0)
+    {
+        glDeleteVertexArrays(1, &VAO_texture);
+        glDeleteBuffers(1, &VBO_texture);
+        glDeleteBuffers(1, &EBO_texture);
+        VAO_texture = 0;
+        VBO_texture = 0;
+        EBO_texture = 0;
+    }
+
+    massesBufferSize = 0;
+    linesBufferSize = 0;
+    textureBufferSize = 0;
+    indexBufferSize = 0;
+}
+
+void Cloth::resize(float newWidth, float newHeight, int newResX, int newResY)
+{
+    clothMesh.clear();
+    width = newWidth;
+    height = newHeight;
+    resX = newResX;
+    resY = newResY;
+
+    cleanupBuffers();
+    initCloth();
+}
+
+void Cloth::cutSpringsWithRay(const Ray &ray, const glm::vec3 &previousMousePos, const glm::mat4 &view,
+                              const glm::mat4 &projection, int screenWidth, int screenHeight)
+{
+    // Cutting works on springs or grid edges through the spring BVH, or on the triangles of the membrane
+    // The grid turns into explicit springs only once an edge is actually cut
+    const bool cutElements = activeMembraneModel() == MembraneModel::COROTATIONAL;
+    if (cutElements)
+        updateMembrane();
+
+    glm::mat4 viewProjection = projection * view;
+
+    std::pmr::vector<int> springsToCut(&frameArena);
+    springsToCut.reserve(50);
+
+    float cutThresholdPixels = 10.0f;
+
+    auto worldToScreen = [&](const glm::vec3 &worldPos) -> glm::vec3 {
+        glm::vec4 clipSpace = viewProjection * glm::vec4(worldPos, 1.0f);
+
+        if (std::abs(clipSpace.w) < 0.0001f)
+            return glm::vec3(-9999.0f);
+
+        float invW = 1.0f / clipSpace.w;
+        glm::vec3 ndc = glm::vec3(clipSpace) * invW;
+
+        return glm::vec3((ndc.x + 1.0f) * 0.5f * screenWidth, (1.0f - ndc.y) * 0.5f * screenHeight, clipSpace.w);
+    };
+
+    float distToPrev = glm::length(previousMousePos - ray.Origin());
+    glm::vec3 currentMouseWorldPos = ray.Origin() + ray.Direction() * distToPrev;
+
+    glm::vec3 currentScreen = worldToScreen(currentMouseWorldPos);
+    glm::vec3 previousScreen = worldToScreen(previousMousePos);
+
+    if (currentScreen.x < -9000.0f || previousScreen.x < -9000.0f)
+    {
+        return;
+    }
+
+    glm::vec2 screenSegment = glm::vec2(currentScreen.x - previousScreen.x, currentScreen.y - previousScreen.y);
+    float segmentLength = glm::length(screenSegment);
+
+    if (segmentLength < 1.0f)
+    {
+        return;
+    }
+
+    glm::vec2 segmentDir = screenSegment / segmentLength;
+    glm::vec2 prevScreen2D = glm::vec2(previousScreen.x, previousScreen.y);
+
+    float cutThresholdSq = cutThresholdPixels * cutThresholdPixels;
+
+    float margin = cutThresholdPixels * 1.5f;
+    float minX = std::min(previousScreen.x, currentScreen.x) - margin;
+    float maxX = std::max(previousScreen.x, currentScreen.x) + margin;
+    float minY = std::min(previousScreen.y, currentScreen.y) - margin;
+    float maxY = std::max(previousScreen.y, currentScreen.y) + margin;
+
+    // Cull BVH nodes whose screen footprint misses the blade, only springs near the cursor get tested
+    auto nodeNearBlade = [&](const glm::vec3 &boxMin, const glm::vec3 &boxMax) {
+        float nodeMinX = std::numeric_limits<float>::max();
+        float nodeMaxX = std::numeric_limits<float>::lowest();
+        float nodeMinY = std::numeric_limits<float>::max();
+        float nodeMaxY = std::numeric_limits<float>::lowest();
+
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 cornerPos((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+                                (corner & 4) ? boxMax.z : boxMin.z);
+            glm::vec3 cornerScreen = worldToScreen(cornerPos);
+
+            // Box crosses the camera plane, projection is not conservative so keep it
+            if (cornerScreen.x < -9000.0f || cornerScreen.z <= 0.0f)
+                return true;
+
+            nodeMinX = std::min(nodeMinX, cornerScreen.x);
+            nodeMaxX = std::max(nodeMaxX, cornerScreen.x);
+            nodeMinY = std::min(nodeMinY, cornerScreen.y);
+            nodeMaxY = std::max(nodeMaxY, cornerScreen.y);
+        }
+
+        return nodeMaxX >= minX && nodeMinX <= maxX && nodeMaxY >= minY && nodeMinY <= maxY;
+    };
+
+    // Screen point within the threshold of the blade segment
+    auto pointNearBlade = [&](const glm::vec3 &point) {
+        if (point.x < -9000.0f)
+            return false;
+
+        if (point.x < minX || point.x > maxX || point.y < minY || point.y > maxY)
+            return false;
+
+        glm::vec2 point2D = glm::vec2(point.x, point.y);
+        glm::vec2 toPoint = point2D - prevScreen2D;
+
+        float projection = glm::dot(toPoint, segmentDir);
+        projection = glm::clamp(projection, 0.0f, segmentLength);
+
+        glm::vec2 closestPoint = prevScreen2D + segmentDir * projection;
+        glm::vec2 diff = point2D - closestPoint;
+
+        float distanceSq = diff.x * diff.x + diff.y * diff.y;
+        return distanceSq <= cutThresholdSq;
+    };
+
+    if (cutElements)
+    {
+        // Corners are shared by a whole fan, so only edge midpoints and the centroid select a triangle
+        std::pmr::vector<int> trianglesToCut(&frameArena);
+        auto cutTriangle = [&](int tri) {
+            const glm::vec3 &v0 = masses[textureIndices[tri * 3]].position;
+            const glm::vec3 &v1 = masses[textureIndices[tri * 3 + 1]].position;
+            const glm::vec3 &v2 = masses[textureIndices[tri * 3 + 2]].position;
+
+            glm::vec3 pointsToCheck[4] = {(v0 + v1) * 0.5f, (v1 + v2) * 0.5f, (v2 + v0) * 0.5f,
+                                          (v0 + v1 + v2) / 3.0f};
+            for (const auto &point : pointsToCheck)
+            {
+                if (pointNearBlade(worldToScreen(point)))
+                {
+                    trianglesToCut.push_back(tri);
+                    return;
+                }
+            }
+        };
+        if (pickIndexCurrent())
+        {
+            triangleBVH.traverse(nodeNearBlade, cutTriangle);
+        }
+        else
+        {
+            for (int tri = 0; tri * 3 < textureIndices.size(); ++tri)
+                cutTriangle(tri);
+        }
+
+        for (int tri : trianglesToCut)
+            fracture.markBroken(tri);
+        if (!trianglesToCut.empty())
+            removeBrokenElements();
+        return;
+    }
+
+    updateCutIndex();
+
+    springBVH.traverse(nodeNearBlade, [&](int i) {
+        int a, b;
+        springEndpoints(i, a, b);
+        const Mass &massA = masses[a];
+        const Mass &massB = masses[b];
+
+        glm::vec3 springStart = massA.position;
+        glm::vec3 springEnd = massB.position;
+        glm::vec3 springMid = (springStart + springEnd) * 0.5f;
+
+        glm::vec3 startScreen = worldToScreen(springStart);
+        glm::vec3 endScreen = worldToScreen(springEnd);
+        glm::vec3 midScreen = worldToScreen(springMid);
+
+        if (startScreen.x < -9000.0f && endScreen.x < -9000.0f && midScreen.x < -9000.0f)
+            return;
+
+        glm::vec3 pointsToCheck[3] = {startScreen, midScreen, endScreen};
+
+        for (int p = 0; p < 3; p++)
+        {
+            if (pointNearBlade(pointsToCheck[p]))
+            {
+                springsToCut.push_back(i);
+                return;
+            }
+        }
+    });
+
+    if (!springsToCut.empty())
+    {
+        for (int springIdx : springsToCut)
+        {
+            if (grid.active())
+                grid.breakEdge(springIdx);
+            else
+                fracture.markBroken(springIdx);
+        }
+        removeBrokenSprings();
+
+        // Patch the cut index instead of rebuilding it on the next drag frame, in the order the springs
+        // were swapped out
+        springBVH.removePrimitives(brokenItems.data(), brokenItems.size());
+        cutIndexState.topology = topologyVersion;
+    }
+}
+
+void Cloth::checkSpringTension()
+{
+    if (!enableTensionBreaking)
+        return;
+
+    // Detection writes only the slots of its own range
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    int newBreaks = 0;
+    if (grid.active())
+    {
+        newBreaks = fracture.checkGrid(masses, grid, fractureParams, simulationTime, scheduler);
+    }
+    else if (membrane.active())
+    {
+        scheduler.parallelFor(0, membrane.getElementCount(), SPRING_GRAIN, [&](int begin, int end) {
+            fracture.detectRange(begin, end, masses, membrane, fractureParams);
+        });
+        newBreaks = fracture.collectEvents(masses, membrane, simulationTime);
+    }
+    else
+    {
+        scheduler.parallelFor(0, static_cast<int>(springs.size()), SPRING_GRAIN, [&](int begin, int end) {
+            fracture.detectRange(begin, end, masses, springs, fractureParams);
+        });
+        newBreaks = fracture.collectEvents(masses, springs, simulationTime);
+    }
+
+    if (newBreaks > 0)
+    {
+        analysis.recordSpringBreaks(fracture.getEvents());
+        fracture.clearEvents();
+        removeBrokenSprings();
+    }
+}
+
+void Cloth::removeBrokenSprings()
+{
+    // Torn masses split, which the grid cannot describe, so its broken edges become pending springs
+    if (grid.active() && grid.intactCount() < grid.edgeCount())
+        useExplicitSprings();
+
+    if (!fracture.hasBroken())
+        return;
+
+    if (membrane.active())
+    {
+        removeBrokenElements();
+        return;
+    }
+
+    // Every broken spring swaps with the back, the links of the masses around it are patched in place
+    updateMassLinks();
+    fracture.takeBroken(brokenItems);
+    for (int s : brokenItems)
+    {
+        int a = springs[s].a;
+        int b = springs[s].b;
+        tornMasses.push_back(a);
+        tornMasses.push_back(b);
+        massSpringLinks.remove(a, s);
+        massSpringLinks.remove(b, s);
+
+        int last = static_cast<int>(springs.size()) - 1;
+        if (s != last)
+        {
+            springs[s] = springs[last];
+            massSpringLinks.replace(springs[s].a, last, s);
+            massSpringLinks.replace(springs[s].b, last, s);
+        }
+        springs.pop_back();
+        fracture.removeSlot(s);
+    }
+
+    splitTornVertices();
+    topologyVersion++;
+    linksTopology = topologyVersion;
+
+    calculateNormals();
+    rebuildGraphicsData();
+    rebuildTextureData();
+}
+
+void Cloth::removeBrokenElements()
+{
+    // Element i is triangle i, the element and its fracture state swap with the back together with the triangle
+    updateMassLinks();
+    fracture.takeBroken(brokenItems);
+    for (int t : brokenItems)
+    {
+        for (int k = 0; k < 3; k++)
+            tornMasses.push_back(textureIndices[t * 3 + k]);
+        removeTriangle(t);
+        membrane.removeElement(t);
+        fracture.removeSlot(t);
+    }
+
+    splitTornVertices();
+    indicesDirty = true;
+    topologyVersion++;
+    linksTopology = topologyVersion;
+    membraneTopology = topologyVersion;
+    membraneTriangles = static_cast<int>(textureIndices.size());
+
+    calculateNormals();
+    rebuildGraphicsData();
+    rebuildTextureData();
+}
+
+void Cloth::useExplicitSprings()
+{
+    if (!grid.active())
+        return;
+
+    // Broken edges become springs too and stay pending, so spring i is still edge i until they are removed
+    grid.toSprings(springs);
+    fracture.expandGrid(springs.size());
+    for (int i = 0; i < springs.size(); ++i)
+    {
+        if (grid.isBroken(i))
+            fracture.markBroken(i);
+    }
+
+    grid.clear();
+    topologyVersion++;
+}
+
+void Cloth::springEndpoints(int spring, int &a, int &b) const
+{
+    if (grid.active())
+    {
+        grid.endpoints(spring, a, b);
+        return;
+    }
+    a = springs[spring].a;
+    b = springs[spring].b;
+}
+
+const std::vector<Spring> &Cloth::springsAround(int massIndex) const
+{
+    if (!grid.active())
+        return springs;
+
+    localSprings.clear();
+    grid.springsAround(massIndex, localSprings);
+    return localSprings;
+}
+
+static uint64_t edgeKey(int a, int b)
+{
+    if (a > b)
+        std::swap(a, b);
+    return (static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b);
+}
+
+void Cloth::updateMassLinks()
+{
+    if (linksTopology == topologyVersion && massSpringLinks.ownerCount() == masses.size())
+        return;
+
+    int massCount = static_cast<int>(masses.size());
+    massSpringLinks.build(massCount, [&](auto &&emit) {
+        for (int i = 0; i < springs.size(); ++i)
+        {
+            emit(springs[i].a, i);
+            emit(springs[i].b, i);
+        }
+    });
+    massTriangleLinks.build(massCount, [&](auto &&emit) {
+        for (int t = 0; t * 3 < textureIndices.size(); ++t)
+            for (int k = 0; k < 3; k++)
+                emit(textureIndices[t * 3 + k], t);
+    });
+    linksTopology = topologyVersion;
+}
+
+bool Cloth::hasSpring(int a, int b) const
+{
+    for (const int *s = massSpringLinks.begin(a); s != massSpringLinks.end(a); ++s)
+    {
+        if (springs[*s].a == b || springs[*s].b == b)
+            return true;
+    }
+    return false;
+}
+
+void Cloth::removeTriangle(int t)
+{
+    for (int k = 0; k < 3; k++)
+        massTriangleLinks.remove(textureIndices[t * 3 + k], t);
+
+    // The last triangle fills the gap
+    int last = static_cast<int>(textureIndices.size() / 3) - 1;
+    if (t != last)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            textureIndices[t * 3 + k] = textureIndices[last * 3 + k];
+            massTriangleLinks.replace(textureIndices[t * 3 + k], last, t);
+        }
+    }
+    textureIndices.resize(last * 3);
+}
+
+void Cloth::splitTornVertices()
+{
+    if (tornMasses.empty())
+        return;
+
+    // Only the fans of the torn masses are visited, the links are current for every other mass
+    std::sort(tornMasses.begin(), tornMasses.end());
+    tornMasses.erase(std::unique(tornMasses.begin(), tornMasses.end()), tornMasses.end());
+    const int firstCopy = static_cast<int>(masses.size());
+
+    auto triangleHas = [&](int t, int v) {
+        return textureIndices[t * 3] == v || textureIndices[t * 3 + 1] == v || textureIndices[t * 3 + 2] == v;
+    };
+
+    // Triangles that lost two edges are dropped, same rule the renderer used before
+    // Triangle elements tear by losing the whole triangle, every remaining one is intact
+    droppedTriangles.clear();
+    for (int m : tornMasses)
+    {
+        if (membrane.active())
+            break;
+
+        for (const int *t = massTriangleLinks.begin(m); t != massTriangleLinks.end(m); ++t)
+        {
+            int v0 = textureIndices[*t * 3];
+            int v1 = textureIndices[*t * 3 + 1];
+            int v2 = textureIndices[*t * 3 + 2];
+            if (int(hasSpring(v0, v1)) + int(hasSpring(v1, v2)) + int(hasSpring(v2, v0)) < 2)
+                droppedTriangles.push_back(*t);
+        }
+    }
+    std::sort(droppedTriangles.begin(), droppedTriangles.end(), std::greater<int>());
+    droppedTriangles.erase(std::unique(droppedTriangles.begin(), droppedTriangles.end()), droppedTriangles.end());
+    for (int t : droppedTriangles)
+        removeTriangle(t);
+    indicesDirty = true;
+
+    for (int m : tornMasses)
+    {
+        fanTriangles.assign(massTriangleLinks.begin(m), massTriangleLinks.end(m));
+        int fanSize = static_cast<int>(fanTriangles.size());
+
+        // Triangles around m stay together while they share an intact edge through m, any edge shared by two
+        // remaining triangle elements is intact
+        fanComponents.resize(fanSize);
+        for (int i = 0; i < fanSize; i++)
+            fanComponents[i] = i;
+
+        auto findRoot = [&](int i) {
+            while (fanComponents[i] != i)
+                i = fanComponents[i] = fanComponents[fanComponents[i]];
+            return i;
+        };
+
+        for (int i = 0; i < fanSize; i++)
+        {
+            int ti = fanTriangles[i];
+            for (int k = 0; k < 3; k++)
+            {
+                int x = textureIndices[ti * 3 + k];
+                if (x == m || (!membrane.active() && !hasSpring(m, x)))
+                    continue;
+
+                for (int j = i + 1; j < fanSize; j++)
+                {
+                    if (triangleHas(fanTriangles[j], x))
+                        fanComponents[findRoot(j)] = findRoot(i);
+                }
+            }
+        }
+
+        // Relabel roots as 0..count-1, component 0 keeps the original mass
+        fanLabels.resize(fanSize);
+        for (int i = 0; i < fanSize; i++)
+            fanLabels[i] = findRoot(i);
+
+        int componentCount = 0;
+        componentMasses.clear();
+        for (int i = 0; i < fanSize; i++)
+        {
+            if (fanLabels[i] != i)
+                continue;
+
+            if (componentCount == 0)
+            {
+                componentMasses.push_back(m);
+            }
+            else
+            {
+                Mass copy = masses[m];
+                componentMasses.push_back(static_cast<int>(masses.size()));
+                masses.push_back(copy);
+                restPositions.push_back(restPositions[m]);
+                massSpringLinks.addOwner();
+                massTriangleLinks.addOwner();
+            }
+            fanComponents[i] = componentCount++;
+        }
+        for (int i = 0; i < fanSize; i++)
+            fanLabels[i] = fanComponents[fanLabels[i]];
+
+        if (componentCount < 2)
+            continue;
+
+        // Sides share the mass of the original so tearing keeps the total
+        float share = masses[m].mass / componentCount;
+        for (int target : componentMasses)
+            masses[target].mass = share;
+
+        for (int i = 0; i < fanSize; i++)
+        {
+            int t = fanTriangles[i];
+            int target = componentMasses[fanLabels[i]];
+            if (target == m)
+                continue;
+
+            for (int k = 0; k < 3; k++)
+            {
+                if (textureIndices[t * 3 + k] == m)
+                    textureIndices[t * 3 + k] = target;
+            }
+            if (membrane.active())
+                membrane.replaceCorner(t, m, target);
+            massTriangleLinks.remove(m, t);
+            massTriangleLinks.add(target, t);
+        }
+
+        fanSprings.assign(massSpringLinks.begin(m), massSpringLinks.end(m));
+        for (int s : fanSprings)
+        {
+            Spring &spring = springs[s];
+            int other = (spring.a == m) ? spring.b : spring.a;
+
+            // Edge springs follow the triangle they border
+            int label = -1;
+            for (int i = 0; i < fanSize && label < 0; i++)
+            {
+                if (triangleHas(fanTriangles[i], other))
+                    label = fanLabels[i];
+            }
+
+            // Other springs go to the side that points the same way in texture space
+            if (label < 0)
+            {
+                glm::vec2 dir = masses[other].texCoord - masses[m].texCoord;
+                float bestDot = std::numeric_limits<float>::lowest();
+                for (int i = 0; i < fanSize; i++)
+                {
+                    int t = fanTriangles[i];
+                    glm::vec2 centroid = (masses[textureIndices[t * 3]].texCoord +
+                                          masses[textureIndices[t * 3 + 1]].texCoord +
+                                          masses[textureIndices[t * 3 + 2]].texCoord) /
+                                         3.0f;
+                    float d = glm::dot(dir, centroid - masses[m].texCoord);
+                    if (d > bestDot)
+                    {
+                        bestDot = d;
+                        label = fanLabels[i];
+                    }
+                }
+            }
+
+            int target = componentMasses[label];
+            if (target == m)
+                continue;
+
+            if (spring.a == m)
+                spring.a = target;
+            else
+                spring.b = target;
+            massSpringLinks.remove(m, s);
+            massSpringLinks.add(target, s);
+        }
+    }
+
+    // Torn masses and their copies are the tear front, refinement resolves it on the next pass
+    if (refinementParams.enabled && refinementParams.splitTearFront)
+    {
+        refineMarks.resize(masses.size(), 0);
+        for (int m : tornMasses)
+            refineMarks[m] |= TEAR_FRONT_MARK;
+        for (int m = firstCopy; m < masses.size(); ++m)
+            refineMarks[m] |= TEAR_FRONT_MARK;
+    }
+    tornMasses.clear();
+}
+
+// Compressed adjacency, the items of owner i are list[start[i]] .. list[start[i + 1] - 1]
+// ForEach: void(Emit), Emit: void(int owner, int item)
+template <typename ForEach>
+static void buildAdjacency(int ownerCount, std::vector<int> &start, std::vector<int> &list, ForEach &&forEach)
+{
+    start.assign(ownerCount + 1, 0);
+    forEach([&](int owner, int) { start[owner + 1]++; });
+
+    for (int i = 0; i < ownerCount; i++)
+        start[i + 1] += start[i];
+
+    list.resize(start[ownerCount]);
+    forEach([&](int owner, int item) { list[start[owner]++] = item; });
+
+    // Filling advanced every start to the next owner, shift back
+    for (int i = ownerCount; i > 0; i--)
+        start[i] = start[i - 1];
+    start[0] = 0;
+}
+
+void Cloth::adaptMesh()
+{
+    if (++refinementFrame < refinementParams.interval)
+        return;
+    refinementFrame = 0;
+
+    // Refinement inserts masses off the grid
+    useExplicitSprings();
+
+    int massCount = static_cast<int>(masses.size());
+    int springCount = static_cast<int>(springs.size());
+
+    coarsenMesh();
+    refineMesh();
+
+    if (masses.size() != massCount || springs.size() != springCount)
+    {
+        topologyVersion++;
+        indicesDirty = true;
+    }
+}
+
+void Cloth::refineMesh()
+{
+    refineMarks.resize(masses.size(), 0);
+    if (masses.size() >= refinementParams.massBudget)
+    {
+        std::fill(refineMarks.begin(), refineMarks.end(), 0);
+        return;
+    }
+
+    edgeSprings.clear();
+    for (int i = 0; i < springs.size(); ++i)
+        edgeSprings[edgeKey(springs[i].a, springs[i].b)] = i;
+
+    int triangleCount = static_cast<int>(textureIndices.size() / 3);
+    edgeTriangles.clear();
+    for (int t = 0; t < triangleCount; ++t)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uint64_t key = edgeKey(textureIndices[t * 3 + k], textureIndices[t * 3 + (k + 1) % 3]);
+            auto it = edgeTriangles.find(key);
+            if (it == edgeTriangles.end())
+                edgeTriangles.emplace(key, std::make_pair(t, -1));
+            else
+                it->second.second = t;
+        }
+    }
+
+    float gridSpacing = std::min(width / float(resX - 1), height / float(resY - 1));
+    float minRestLength = gridSpacing * refinementParams.minEdgeFraction;
+
+    // Triangles next to a tear miss a spring, they are bisected along their remaining edges
+    auto longestEdge = [&](int t) {
+        int longest = -1;
+        for (int k = 0; k < 3; k++)
+        {
+            auto it = edgeSprings.find(edgeKey(textureIndices[t * 3 + k], textureIndices[t * 3 + (k + 1) % 3]));
+            if (it == edgeSprings.end())
+                continue;
+            if (longest < 0 || springs[it->second].restLength > springs[longest].restLength)
+                longest = it->second;
+        }
+        return longest;
+    };
+
+    // Every triangle over the limits proposes its longest edge
+    splitCandidates.clear();
+    for (int t = 0; t < triangleCount; ++t)
+    {
+        int longest = longestEdge(t);
+        if (longest < 0 || springs[longest].restLength < minRestLength)
+            continue;
+
+        float maxStrain = 0.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            auto it = edgeSprings.find(edgeKey(textureIndices[t * 3 + k], textureIndices[t * 3 + (k + 1) % 3]));
+            if (it != edgeSprings.end())
+                maxStrain = std::max(maxStrain, fracture.getStrain(it->second));
+        }
+
+        const glm::vec3 &n0 = masses[textureIndices[t * 3]].normal;
+        const glm::vec3 &n1 = masses[textureIndices[t * 3 + 1]].normal;
+        const glm::vec3 &n2 = masses[textureIndices[t * 3 + 2]].normal;
+        float flatness = std::min(glm::dot(n0, n1), std::min(glm::dot(n1, n2), glm::dot(n2, n0)));
+
+        float score = std::max(maxStrain - refinementParams.splitStrain, refinementParams.splitCurvature - flatness);
+        if (refineMarks[textureIndices[t * 3]] | refineMarks[textureIndices[t * 3 + 1]] |
+            refineMarks[textureIndices[t * 3 + 2]])
+            score = std::max(score, MARKED_SPLIT_SCORE);
+        if (score > 0.0f)
+            splitCandidates.emplace_back(score, longest);
+    }
+
+    std::sort(splitCandidates.begin(), splitCandidates.end(),
+              [](const std::pair<float, int> &x, const std::pair<float, int> &y) { return x.first > y.first; });
+
+    // Worst regions first until the budget is used up
+    triangleTouched.assign(triangleCount, 0);
+    for (const auto &candidate : splitCandidates)
+    {
+        if (masses.size() >= refinementParams.massBudget)
+            break;
+
+        // Follow the longest edge path first, so every split edge is the longest of both its triangles
+        // and repeated refinement does not produce slivers
+        int spring = candidate.second;
+        for (int step = 0; step < 16; step++)
+        {
+            auto adjacent = edgeTriangles.find(edgeKey(springs[spring].a, springs[spring].b));
+            if (adjacent == edgeTriangles.end())
+                break;
+
+            int next = spring;
+            for (int t : {adjacent->second.first, adjacent->second.second})
+            {
+                if (t < 0 || triangleTouched[t])
+                    continue;
+                int longest = longestEdge(t);
+                if (longest >= 0 && springs[longest].restLength > springs[next].restLength * 1.001f)
+                    next = longest;
+            }
+
+            if (next == spring)
+                break;
+            spring = next;
+        }
+
+        if (springs[spring].restLength >= minRestLength)
+            splitEdge(spring);
+    }
+
+    // Marks only live until the pass that resolves them
+    std::fill(refineMarks.begin(), refineMarks.end(), 0);
+}
+
+bool Cloth::splitEdge(int springIndex)
+{
+    Spring parent = springs[springIndex];
+    int a = parent.a;
+    int b = parent.b;
+
+    auto adjacent = edgeTriangles.find(edgeKey(a, b));
+    if (adjacent == edgeTriangles.end())
+        return false;
+
+    // A torn edge keeps the rest length of its texture layout, which is how initCloth placed the masses. Loaded
+    // meshes have no such layout, their torn triangles are left alone
+    const bool textureRest = clothMesh.triangleCount() == 0;
+    auto restBetween = [&](int x, int y) {
+        auto it = edgeSprings.find(edgeKey(x, y));
+        if (it != edgeSprings.end())
+            return springs[it->second].restLength;
+        if (textureRest)
+            return glm::length((masses[y].texCoord - masses[x].texCoord) * glm::vec2(width, height));
+        return -1.0f;
+    };
+
+    int sides[2] = {adjacent->second.first, adjacent->second.second};
+    for (int t : sides)
+    {
+        if (t < 0)
+            continue;
+
+        int c = textureIndices[t * 3] ^ textureIndices[t * 3 + 1] ^ textureIndices[t * 3 + 2] ^ a ^ b;
+        if (triangleTouched[t] || restBetween(a, c) < 0.0f || restBetween(b, c) < 0.0f)
+            return false;
+    }
+
+    // Lumped mass: every triangle gives a third of its rest area to each corner. Halving the
+    // triangles moves a sixth of their area from both edge ends to the new mass
+    float movedArea = 0.0f;
+    for (int t : sides)
+    {
+        if (t < 0)
+            continue;
+
+        int c = textureIndices[t * 3] ^ textureIndices[t * 3 + 1] ^ textureIndices[t * 3 + 2] ^ a ^ b;
+        float ac = restBetween(a, c);
+        float bc = restBetween(b, c);
+        float ab = parent.restLength;
+        float semi = (ab + ac + bc) * 0.5f;
+        movedArea += std::sqrt(std::max(0.0f, semi * (semi - ab) * (semi - ac) * (semi - bc))) / 6.0f;
+    }
+
+    if (movedArea <= 0.0f)
+        return false;
+
+    RefinementRecord record;
+    record.a = a;
+    record.b = b;
+    record.restLength = parent.restLength;
+    record.material = parent.material;
+    record.takenA = std::min(restDensity * movedArea, masses[a].mass * 0.5f);
+    record.takenB = std::min(restDensity * movedArea, masses[b].mass * 0.5f);
+    record.settledPasses = 0;
+
+    Mass mid((masses[a].position + masses[b].position) * 0.5f, record.takenA + record.takenB,
+             masses[a].fixed && masses[b].fixed, (masses[a].texCoord + masses[b].texCoord) * 0.5f);
+    mid.prevPosition = (masses[a].prevPosition + masses[b].prevPosition) * 0.5f;
+    mid.normal = masses[a].normal;
+
+    masses[a].mass -= record.takenA;
+    masses[b].mass -= record.takenB;
+
+    int m = static_cast<int>(masses.size());
+    record.mid = m;
+    masses.push_back(mid);
+    restPositions.push_back((restPositions[a] + restPositions[b]) * 0.5f);
+
+    // Parent spring keeps its slot as the first half
+    springs[springIndex] = Spring(a, m, parent.restLength * 0.5f, parent.material);
+    springs.emplace_back(m, b, parent.restLength * 0.5f, parent.material);
+
+    for (int t : sides)
+    {
+        if (t < 0)
+            continue;
+
+        // Rotate so the split edge is (x, y) in winding order
+        int k = 0;
+        while (k < 3)
+        {
+            int x = textureIndices[t * 3 + k];
+            int y = textureIndices[t * 3 + (k + 1) % 3];
+            if ((x == a && y == b) || (x == b && y == a))
+                break;
+            k++;
+        }
+        if (k == 3)
+            continue;
+
+        int x = textureIndices[t * 3 + k];
+        int y = textureIndices[t * 3 + (k + 1) % 3];
+        int c = textureIndices[t * 3 + (k + 2) % 3];
+
+        textureIndices[t * 3] = x;
+        textureIndices[t * 3 + 1] = m;
+        textureIndices[t * 3 + 2] = c;
+        textureIndices.push_back(m);
+        textureIndices.push_back(y);
+        textureIndices.push_back(c);
+        triangleTouched[t] = 1;
+
+        // Median length of the rest triangle, exact for the flat rest shape
+        float restA = restBetween(a, c);
+        float restB = restBetween(b, c);
+        float restMid = std::sqrt(std::max(
+            0.0f, 0.5f * restA * restA + 0.5f * restB * restB - 0.25f * parent.restLength * parent.restLength));
+
+        springs.emplace_back(m, c, restMid, parent.material);
+    }
+
+    fracture.grow(springs.size());
+    fracture.setStrain(springIndex, 1.0f);
+    refinementRecords.push_back(record);
+    return true;
+}
+
+void Cloth::coarsenMesh()
+{
+    if (refinementRecords.empty())
+        return;
+
+    int massCount = static_cast<int>(masses.size());
+    int triangleCount = static_cast<int>(textureIndices.size() / 3);
+
+    buildAdjacency(massCount, massSpringStart, massSprings, [&](auto &&emit) {
+        for (int i = 0; i < springs.size(); ++i)
+        {
+            emit(springs[i].a, i);
+            emit(springs[i].b, i);
+        }
+    });
+    buildAdjacency(massCount, massTriangleStart, massTriangles, [&](auto &&emit) {
+        for (int t = 0; t < triangleCount; ++t)
+            for (int k = 0; k < 3; k++)
+                emit(textureIndices[t * 3 + k], t);
+    });
+
+    massTouched.assign(massCount, 0);
+    triangleTouched.assign(triangleCount, 0);
+    massRemap.assign(massCount, 0);
+    refineMarks.resize(massCount, 0);
+    int collapsed = 0;
+
+    // Newest first, a bisection can only be undone after the ones that split its children
+    for (int r = static_cast<int>(refinementRecords.size()) - 1; r >= 0; --r)
+    {
+        RefinementRecord &record = refinementRecords[r];
+        int m = record.mid;
+
+        if (massTouched[record.a] || massTouched[record.b] || massTouched[m] || m == selectedMassIndex ||
+            m == trackedMassIndex)
+            continue;
+
+        // Tear fronts and contacts are about to be refined, merging there would undo the next pass
+        if (refineMarks[record.a] | refineMarks[record.b] | refineMarks[m])
+        {
+            record.settledPasses = 0;
+            continue;
+        }
+
+        // Strain must also be under the split limit, otherwise the merged edge would be split again
+        bool settled = glm::length(masses[m].position - masses[m].prevPosition) <= refinementParams.settleMotion;
+        for (int i = massSpringStart[m]; i < massSpringStart[m + 1] && settled; i++)
+        {
+            const Spring &spring = springs[massSprings[i]];
+            int other = (spring.a == m) ? spring.b : spring.a;
+            settled = fracture.getStrain(massSprings[i]) <= refinementParams.splitStrain &&
+                      glm::dot(masses[m].normal, masses[other].normal) >= refinementParams.coarsenCurvature;
+        }
+
+        record.settledPasses = settled ? record.settledPasses + 1 : 0;
+        if (record.settledPasses < refinementParams.settlePasses)
+            continue;
+
+        // The mass must still look exactly like the bisection left it: halves of the parent plus one
+        // spring and two triangles per opposite vertex, anything else means tearing or further refinement
+        int springA = -1, springB = -1;
+        int opposite[2] = {-1, -1};
+        int oppositeSprings[2] = {-1, -1};
+        int oppositeCount = 0;
+        bool valid = true;
+
+        for (int i = massSpringStart[m]; i < massSpringStart[m + 1] && valid; i++)
+        {
+            const Spring &spring = springs[massSprings[i]];
+            int other = (spring.a == m) ? spring.b : spring.a;
+
+            if (other == record.a && springA < 0)
+                springA = massSprings[i];
+            else if (other == record.b && springB < 0)
+                springB = massSprings[i];
+            else if (oppositeCount < 2 && !massTouched[other])
+            {
+                opposite[oppositeCount] = other;
+                oppositeSprings[oppositeCount++] = massSprings[i];
+            }
+            else
+                valid = false;
+        }
+
+        int triangleCountAround = massTriangleStart[m + 1] - massTriangleStart[m];
+        if (!valid || springA < 0 || springB < 0 || triangleCountAround != oppositeCount * 2)
+            continue;
+
+        int pairs[2][2] = {{-1, -1}, {-1, -1}};
+        for (int i = massTriangleStart[m]; i < massTriangleStart[m + 1] && valid; i++)
+        {
+            int t = massTriangles[i];
+            bool hasA = false, hasB = false;
+            int side = -1;
+            for (int k = 0; k < 3; k++)
+            {
+                int v = textureIndices[t * 3 + k];
+                hasA |= (v == record.a);
+                hasB |= (v == record.b);
+                for (int o = 0; o < oppositeCount; o++)
+                {
+                    if (v == opposite[o])
+                        side = o;
+                }
+            }
+
+            if (side < 0 || hasA == hasB || pairs[side][hasA ? 0 : 1] >= 0)
+                valid = false;
+            else
+                pairs[side][hasA ? 0 : 1] = t;
+        }
+
+        if (!valid)
+            continue;
+
+        // Merge each triangle pair back into the parent triangle
+        for (int o = 0; o < oppositeCount; o++)
+        {
+            int keep = pairs[o][0];
+            for (int k = 0; k < 3; k++)
+            {
+                if (textureIndices[keep * 3 + k] == m)
+                    textureIndices[keep * 3 + k] = record.b;
+            }
+            triangleTouched[pairs[o][1]] = 1;
+
+            fracture.markBroken(oppositeSprings[o]);
+            massTouched[opposite[o]] = 1;
+        }
+
+        springs[springA] = Spring(record.a, record.b, record.restLength, record.material);
+        fracture.setStrain(springA, 1.0f);
+        fracture.markBroken(springB);
+
+        masses[record.a].mass += record.takenA;
+        masses[record.b].mass += record.takenB;
+
+        massTouched[record.a] = 1;
+        massTouched[record.b] = 1;
+        massTouched[m] = 1;
+        massRemap[m] = -1;
+        record.mid = -1;
+        collapsed++;
+    }
+
+    if (collapsed == 0)
+        return;
+
+    int write = 0;
+    for (int t = 0; t < triangleCount; ++t)
+    {
+        if (triangleTouched[t])
+            continue;
+        for (int k = 0; k < 3; k++)
+            textureIndices[write * 3 + k] = textureIndices[t * 3 + k];
+        write++;
+    }
+    textureIndices.resize(write * 3);
+
+    refinementRecords.erase(std::remove_if(refinementRecords.begin(), refinementRecords.end(),
+                                           [](const RefinementRecord &record) { return record.mid < 0; }),
+                            refinementRecords.end());
+
+    fracture.compact(springs);
+
+    int next = 0;
+    for (int i = 0; i < massCount; ++i)
+        massRemap[i] = (massRemap[i] < 0) ? -1 : next++;
+    remapMasses(massRemap);
+}
+
+void Cloth::resetFrameArena()
+{
+    // Member containers on the arena give up their buckets before the memory goes away
+    std::pmr::unordered_map<uint64_t, int>(&frameArena).swap(edgeSprings);
+    std::pmr::unordered_map<uint64_t, std::pair<int, int>>(&frameArena).swap(edgeTriangles);
+
+    frameArena.reset();
+}
+
+void Cloth::remapMasses(const std::vector<int> &newIndex)
+{
+    int count = 0;
+    for (int i = 0; i < masses.size(); ++i)
+    {
+        if (newIndex[i] >= 0)
+            count++;
+    }
+
+    massScratch = masses;
+    for (int i = 0; i < masses.size(); ++i)
+    {
+        if (newIndex[i] >= 0)
+            massScratch[newIndex[i]] = masses[i];
+    }
+    massScratch.resize(count, masses.front());
+    masses.swap(massScratch);
+
+    restScratch.resize(count);
+    for (int i = 0; i < restPositions.size(); ++i)
+    {
+        if (newIndex[i] >= 0)
+            restScratch[newIndex[i]] = restPositions[i];
+    }
+    restPositions.swap(restScratch);
+
+    for (auto &spring : springs)
+    {
+        spring.a = newIndex[spring.a];
+        spring.b = newIndex[spring.b];
+    }
 
-        if (shouldCut)
-        {
-            springsToCut.push_back(i);
-        }
+    for (auto &index : textureIndices)
+        index = newIndex[index];
+
+    for (auto &index : massIndexMap)
+    {
+        if (index >= 0)
+            index = newIndex[index];
     }
 
-    if (!springsToCut.empty())
+    for (auto &record : refinementRecords)
+    {
+        record.a = newIndex[record.a];
+        record.b = newIndex[record.b];
+        record.mid = newIndex[record.mid];
+    }
+
+    if (!refineMarks.empty())
     {
-        for (int i = springsToCut.size() - 1; i >= 0; --i)
+        markScratch.assign(count, 0);
+        for (int i = 0; i < refineMarks.size(); ++i)
         {
-            springs.erase(springs.begin() + springsToCut[i]);
+            if (newIndex[i] >= 0)
+                markScratch[newIndex[i]] = refineMarks[i];
         }
-
-        rebuildGraphicsData();
-        rebuildTextureData();
+        refineMarks.swap(markScratch);
     }
+
+    if (selectedMassIndex >= 0)
+        selectedMassIndex = newIndex[selectedMassIndex];
+    if (trackedMassIndex >= 0)
+        trackedMassIndex = newIndex[trackedMassIndex];
+
+    topologyVersion++;
+    indicesDirty = true;
 }
 
-void Cloth::checkSpringTension()
+// Interleave the bits of two 16 bit coordinates
+static uint32_t mortonCode(uint32_t x, uint32_t y)
 {
-    if (!enableTensionBreaking)
+    auto spread = [](uint32_t v) {
+        v &= 0xFFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+void Cloth::reorderForLocality()
+{
+    // Row sweeps of the structured grid are already sequential and depend on the row-major numbering
+    if (grid.active() || masses.empty())
         return;
 
-    static std::vector<int> tensionCounter;
-    if (tensionCounter.size() != springs.size())
+    // Rest coordinates keep torn copies and inserted masses next to their neighbours
+    mortonOrder.clear();
+    mortonOrder.reserve(masses.size());
+    for (int i = 0; i < masses.size(); ++i)
     {
-        tensionCounter.resize(springs.size(), 0);
+        const glm::vec2 &uv = masses[i].texCoord;
+        uint32_t x = static_cast<uint32_t>(std::clamp(uv.x, 0.0f, 1.0f) * 65535.0f);
+        uint32_t y = static_cast<uint32_t>(std::clamp(uv.y, 0.0f, 1.0f) * 65535.0f);
+        mortonOrder.emplace_back(mortonCode(x, y), i);
     }
+    // Ties keep their old order, so running it again changes nothing
+    std::sort(mortonOrder.begin(), mortonOrder.end());
 
-    std::vector<int> springsToBreak;
-    springsToBreak.reserve(20);
+    massRemap.assign(masses.size(), -1);
+    for (int i = 0; i < mortonOrder.size(); ++i)
+        massRemap[mortonOrder[i].second] = i;
+    remapMasses(massRemap);
 
-    const int FRAMES_BEFORE_BREAK = 3;
-
-    for (int i = 0; i < springs.size(); ++i)
+    // Springs by first endpoint, the solver then walks masses roughly in memory order
+    for (auto &spring : springs)
     {
-        const Spring &spring = springs[i];
-        const Mass &massA = masses[spring.a];
-        const Mass &massB = masses[spring.b];
-
-        float currentLength = glm::length(massB.position - massA.position);
-
-        if (currentLength < 0.0001f)
-            continue;
-        float stretchRatio = currentLength / spring.restLength;
-
-        if (stretchRatio > tensionBreakThreshold)
-        {
-            tensionCounter[i]++;
-            if (tensionCounter[i] >= FRAMES_BEFORE_BREAK)
-            {
-                bool shouldBreak = true;
-                if ((massA.fixed && !massB.fixed) || (!massA.fixed && massB.fixed))
-                {
-                    if (stretchRatio < tensionBreakThreshold * 1.5f)
-                    {
-                        shouldBreak = false;
-                    }
-                }
-                if (shouldBreak)
-                {
-                    springsToBreak.push_back(i);
-                    glm::vec3 breakPos = (massA.position + massB.position) * 0.5f;
-                    analysis.recordSpringBreak(i, breakPos, stretchRatio, simulationTime);
-                }
-            }
-        }
-        else
-        {
-            tensionCounter[i] = 0;
-        }
+        if (spring.a > spring.b)
+            std::swap(spring.a, spring.b);
     }
 
-    if (!springsToBreak.empty())
-    {
-        for (int i = springsToBreak.size() - 1; i >= 0; --i)
-        {
-            int springIdx = springsToBreak[i];
-            springs.erase(springs.begin() + springIdx);
-            tensionCounter.erase(tensionCounter.begin() + springIdx);
-        }
-        rebuildGraphicsData();
-        rebuildTextureData();
-    }
+    springOrder.resize(springs.size());
+    for (int i = 0; i < springOrder.size(); ++i)
+        springOrder[i] = i;
+    std::stable_sort(springOrder.begin(), springOrder.end(), [this](int lhs, int rhs) {
+        const Spring &first = springs[lhs];
+        const Spring &second = springs[rhs];
+        return first.a != second.a ? first.a < second.a : first.b < second.b;
+    });
+    fracture.permute(springs, springOrder);
 }
 
 AnalysisDisplayData Cloth::getAnalysisDisplayData() const
 {
-    AnalysisDisplayData data;
+    AnalysisDisplayData data(&frameArena);
 
     extern int trackedMassIndex;
     extern bool trackingMode;
 
     data.selectedMassIndex = trackingMode ? trackedMassIndex : -1;
-    data.totalSprings = springs.size();
+    data.totalSprings = getSpringCount();
     data.brokenSprings = analysis.getTotalBrokenSprings();
     data.totalEnergy = analysis.getTotalEnergy();
     data.averageSystemTension = analysis.getAverageTension();
@@ -1043,10 +3037,12 @@ AnalysisDisplayData Cloth::getAnalysisDisplayData() const
         data.speed = glm::length(data.velocity);
         data.acceleration = mass.acceleration;
         data.kineticEnergy = analysis.calculateKineticEnergy(mass);
-        data.averageTension = analysis.calculateAverageSpringTension(trackedMassIndex, masses, springs);
+        const std::vector<Spring> &connected = springsAround(trackedMassIndex);
+
+        data.averageTension = analysis.calculateAverageSpringTension(trackedMassIndex, masses, connected);
 
         data.connectedSprings = 0;
-        for (const auto &spring : springs)
+        for (const auto &spring : connected)
         {
             if (spring.a == trackedMassIndex || spring.b == trackedMassIndex)
                 data.connectedSprings++;
@@ -1074,6 +3070,7 @@ void Cloth::freeCloth()
 {
     for (auto &mass : masses)
         mass.fixed = false;
+    pinsVersion++;
 }
 
 void Cloth::addCollisionObject(Object *obj)
@@ -1104,6 +3101,62 @@ void Cloth::setOrientation(ClothOrientation orientation)
     }
 }
 
+void Cloth::keepRows(int firstRow, int lastRow, int haloRows)
+{
+    useExplicitSprings();
+
+    const int haloFirst = std::max(firstRow - haloRows, 0);
+    const int haloLast = std::min(lastRow + haloRows, resY);
+
+    // Rows come from the rest coordinates, so torn copies and inserted masses follow their grid point
+    massRemap.assign(masses.size(), -1);
+    int kept = 0;
+    for (int i = 0; i < masses.size(); ++i)
+    {
+        int row = static_cast<int>(std::lround(masses[i].texCoord.y * (resY - 1)));
+        if (row < haloFirst || row >= haloLast)
+            continue;
+
+        if (row < firstRow || row >= lastRow)
+            masses[i].fixed = true;
+        massRemap[i] = kept++;
+    }
+    pinsVersion++;
+
+    for (int i = 0; i < springs.size(); ++i)
+    {
+        if (massRemap[springs[i].a] < 0 || massRemap[springs[i].b] < 0)
+            fracture.markBroken(i);
+    }
+    fracture.compact(springs);
+
+    int write = 0;
+    for (size_t t = 0; t + 2 < textureIndices.size(); t += 3)
+    {
+        if (massRemap[textureIndices[t]] < 0 || massRemap[textureIndices[t + 1]] < 0 ||
+            massRemap[textureIndices[t + 2]] < 0)
+            continue;
+
+        for (int k = 0; k < 3; ++k)
+            textureIndices[write++] = textureIndices[t + k];
+    }
+    textureIndices.resize(write);
+
+    refinementRecords.erase(std::remove_if(refinementRecords.begin(), refinementRecords.end(),
+                                           [&](const RefinementRecord &record) {
+                                               return massRemap[record.a] < 0 || massRemap[record.b] < 0 ||
+                                                      massRemap[record.mid] < 0;
+                                           }),
+                            refinementRecords.end());
+
+    remapMasses(massRemap);
+    positionsVersion++;
+
+    calculateNormals();
+    rebuildGraphicsData();
+    rebuildTextureData();
+}
+
 void Cloth::setPhysicalProperties(float mass, float structStiff, float structDamp, float shearStiff, float shearDamp,
                                   float bendStiff, float bendDamp)
 {
@@ -1116,6 +3169,12 @@ void Cloth::setPhysicalProperties(float mass, float structStiff, float structDam
     defaultBendingDamping = bendDamp;
 }
 
+PhysicalProperties Cloth::getPhysicalProperties() const
+{
+    return {defaultMass,         defaultStructuralStiffness, defaultStructuralDamping, defaultShearStiffness,
+            defaultShearDamping, defaultBendingStiffness,    defaultBendingDamping};
+}
+
 void Cloth::setSolverParameters(int iterations, float correction, float maxStretch)
 {
     solverIterations = iterations;
@@ -1123,6 +3182,88 @@ void Cloth::setSolverParameters(int iterations, float correction, float maxStret
     maxStretchRatio = maxStretch;
 }
 
+float Cloth::getCorrectionFactor() const
+{
+    return correctionFactor;
+}
+
+float Cloth::getMaxStretchRatio() const
+{
+    return maxStretchRatio;
+}
+
+const TimestepParams &Cloth::getTimestepParams() const
+{
+    return timestepParams;
+}
+
+void Cloth::setTimestepParams(const TimestepParams &params)
+{
+    if (params.enabled && !timestepParams.enabled)
+    {
+        adaptiveDt = params.maxDt;
+        lastStrainTime = -1.0f;
+    }
+    timestepParams = params;
+}
+
+float Cloth::getTimestep() const
+{
+    return lastStepDt;
+}
+
+int Cloth::getStepCount() const
+{
+    return lastStepCount;
+}
+
+int Cloth::getSolverIterations() const
+{
+    return solverIterations;
+}
+
+void Cloth::setSubsteps(int count)
+{
+    substeps = std::max(count, 1);
+}
+
+int Cloth::getSubsteps() const
+{
+    return substeps;
+}
+
+void Cloth::setAnalysisInterval(int frames)
+{
+    analysisInterval = std::max(frames, 1);
+}
+
+int Cloth::getAnalysisInterval() const
+{
+    return analysisInterval;
+}
+
+FrameGovernor &Cloth::getGovernor()
+{
+    return governor;
+}
+
+const FrameGovernor &Cloth::getGovernor() const
+{
+    return governor;
+}
+
+const ConvergenceParams &Cloth::getConvergenceParams() const
+{
+    return convergenceParams;
+}
+
+void Cloth::setConvergenceParams(const ConvergenceParams &params)
+{
+    convergenceParams = params;
+    if (!params.enabled)
+        analysis.clearResidualCurve();
+}
+
 const ForceManager &Cloth::getForceManager() const
 {
     return forceManager;
@@ -1148,11 +3289,28 @@ const std::vector<Spring> &Cloth::getSprings() const
     return springs;
 }
 
+const SpringMaterial &Cloth::getSpringMaterial(const Spring &spring) const
+{
+    return materials[spring.material];
+}
+
+glm::vec3 Cloth::getSpringMidpoint(const Spring &spring) const
+{
+    return midpoint(masses[spring.a].position, masses[spring.b].position);
+}
+
 Mass &Cloth::getMass(int index)
 {
     return masses[index];
 }
 
+int Cloth::getGridMassIndex(int x, int y) const
+{
+    if (y * resX + x >= massIndexMap.size())
+        return -1;
+    return massIndexMap[y * resX + x];
+}
+
 ForceManager &Cloth::getForceManager()
 {
     return forceManager;
@@ -1173,12 +3331,12 @@ void Cloth::changeTextureVisible()
 
 void Cloth::setTensionBreaking(float threshold)
 {
-    tensionBreakThreshold = threshold;
+    fractureParams.threshold = threshold;
 }
 
 void Cloth::setTensionBreakThreshold(float threshold)
 {
-    tensionBreakThreshold = threshold;
+    fractureParams.threshold = threshold;
 }
 
 void Cloth::setCutThreshold(float threshold)
@@ -1193,12 +3351,12 @@ void Cloth::setEnableTensionBreaking(bool enabled)
 
 float Cloth::getTensionBreaking() const
 {
-    return tensionBreakThreshold;
+    return fractureParams.threshold;
 }
 
 float Cloth::getTensionBreakThreshold() const
 {
-    return tensionBreakThreshold;
+    return fractureParams.threshold;
 }
 
 float Cloth::getCutThreshold() const
@@ -1237,34 +3395,229 @@ Cloth::ClothOrientation Cloth::getOrientation() const
 
 void Cloth::applySpringForces()
 {
+    if (grid.active())
+    {
+        grid.applyForces(masses, materials);
+        return;
+    }
+
     for (const auto &spring : springs)
     {
-        Mass &massA = masses[spring.a];
-        Mass &massB = masses[spring.b];
+        applySpringForce(masses[spring.a], masses[spring.b], spring.restLength, materials[spring.material]);
+    }
+}
 
-        glm::vec3 delta = massB.position - massA.position;
-        float currentLength = glm::length(delta);
+void Cloth::setStructuredGrid(bool enabled)
+{
+    structuredGrid = enabled;
+}
 
-        if (currentLength < 0.0001f)
-            continue;
+bool Cloth::getStructuredGrid() const
+{
+    return structuredGrid;
+}
+
+void Cloth::setGridRowPasses(bool enabled)
+{
+    grid.setRowPasses(enabled);
+}
+
+bool Cloth::getGridRowPasses() const
+{
+    return grid.getRowPasses();
+}
 
-        glm::vec3 direction = delta / currentLength;
+void Cloth::setBendingModel(BendingModel model)
+{
+    bendingModel = model;
+}
+
+BendingModel Cloth::getBendingModel() const
+{
+    return bendingModel;
+}
 
-        float displacement = currentLength - spring.restLength;
-        float springForceMagnitude = spring.stiffness * displacement;
-        glm::vec3 springForce = direction * springForceMagnitude;
+const DihedralBending &Cloth::getDihedralBending() const
+{
+    return dihedral;
+}
 
-        glm::vec3 velocityA = massA.position - massA.prevPosition;
-        glm::vec3 velocityB = massB.position - massB.prevPosition;
-        glm::vec3 relativeVelocity = velocityB - velocityA;
-        float relativeVelocityAlongSpring = glm::dot(relativeVelocity, direction);
-        glm::vec3 dampingForce = direction * (spring.damping * relativeVelocityAlongSpring);
+void Cloth::setMembraneModel(MembraneModel model)
+{
+    membraneModel = model;
+}
 
-        glm::vec3 totalSpringForce = springForce + dampingForce;
+MembraneModel Cloth::getMembraneModel() const
+{
+    return membraneModel;
+}
 
-        if (!massA.fixed)
-            massA.applyForce(totalSpringForce);
-        if (!massB.fixed)
-            massB.applyForce(-totalSpringForce);
-    }
-}
\ No newline at end of file
+const MembraneParams &Cloth::getMembraneParams() const
+{
+    return membraneParams;
+}
+
+void Cloth::setMembraneParams(const MembraneParams &params)
+{
+    membraneParams = params;
+}
+
+const MembraneSystem &Cloth::getMembrane() const
+{
+    return membrane;
+}
+
+void Cloth::setTiledSolver(bool enabled)
+{
+    tiledSolver = enabled;
+}
+
+bool Cloth::getTiledSolver() const
+{
+    return tiledSolver;
+}
+
+const TileSolver &Cloth::getTileSolver() const
+{
+    return tiles;
+}
+
+const ScheduleParams &Cloth::getScheduleParams() const
+{
+    return scheduleParams;
+}
+
+void Cloth::setScheduleParams(const ScheduleParams &params)
+{
+    scheduleParams = params;
+}
+
+const TetherParams &Cloth::getTetherParams() const
+{
+    return tetherParams;
+}
+
+void Cloth::setTetherParams(const TetherParams &params)
+{
+    tetherParams = params;
+}
+
+const TetherSystem &Cloth::getTethers() const
+{
+    return tethers;
+}
+
+const PreviewParams &Cloth::getPreviewParams() const
+{
+    return previewParams;
+}
+
+void Cloth::setPreviewParams(const PreviewParams &params)
+{
+    previewParams = params;
+}
+
+void Cloth::startPreviewTraining()
+{
+    preview.startTraining(masses, topologyVersion, pinsVersion, previewParams);
+}
+
+const SubspacePreview &Cloth::getPreview() const
+{
+    return preview;
+}
+
+bool Cloth::isPreviewRunning() const
+{
+    return previewRunning;
+}
+
+const SubdivisionParams &Cloth::getSubdivisionParams() const
+{
+    return subdivisionParams;
+}
+
+void Cloth::setSubdivisionParams(const SubdivisionParams &params)
+{
+    subdivisionParams = params;
+    subdivisionParams.segments = std::clamp(params.segments, 1, SurfaceSubdivision::MAX_SEGMENTS);
+}
+
+bool Cloth::loadClothMesh(const std::string &path, const MeshImportParams &params)
+{
+    ObjMesh mesh;
+    if (!mesh.load(path))
+        return false;
+
+    clothMesh = std::move(mesh);
+    meshImport = params;
+    selectedMassIndex = -1;
+    cleanupBuffers();
+    initCloth();
+    return true;
+}
+
+bool Cloth::hasClothMesh() const
+{
+    return clothMesh.triangleCount() > 0;
+}
+
+bool Cloth::loadRenderMesh(const std::string &path)
+{
+    if (!renderMesh.load(path))
+        return false;
+
+    // Bound in the current pose, normals are needed for the offsets along them
+    renderMeshTopology = -1;
+    calculateNormals();
+    renderMesh.bind(masses, textureIndices, TaskScheduler::instance());
+    renderMeshTopology = topologyVersion;
+    renderMeshTriangles = static_cast<int>(textureIndices.size() / 3);
+    normalSubsetTopology = -1;
+    indicesDirty = true;
+    if (!headless)
+        rebuildTextureData();
+    return renderMesh.active();
+}
+
+void Cloth::clearRenderMesh()
+{
+    renderMesh.clear();
+    if (!headless)
+        rebuildTextureData();
+}
+
+const EmbeddedMesh &Cloth::getRenderMesh() const
+{
+    return renderMesh;
+}
+
+int Cloth::getRenderedTriangleCount() const
+{
+    return static_cast<int>(renderIndices().size() / 3);
+}
+
+int Cloth::getSpringCount() const
+{
+    return grid.active() ? grid.intactCount() : static_cast<int>(springs.size());
+}
+
+const RefinementParams &Cloth::getRefinementParams() const
+{
+    return refinementParams;
+}
+
+void Cloth::setRefinementParams(const RefinementParams &params)
+{
+    refinementParams = params;
+}
+
+int Cloth::getSelectedMassIndex() const
+{
+    return selectedMassIndex;
+}
+
+int Cloth::getRefinedEdgeCount() const
+{
+    return static_cast<int>(refinementRecords.size());
+}
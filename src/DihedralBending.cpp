@@ -0,0 +1,189 @@
+#include "DihedralBending.hpp"
+#include "Cloth.hpp"
+#include "StructuredGrid.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const int HINGE_GRAIN = 1024;
+const float PI = 3.14159265358979f;
+
+// Difference of two hinge angles, wrapped so a hinge folded past the half turn takes the short way back
+float angleOffset(float angle, float restAngle)
+{
+    float offset = angle - restAngle;
+    if (offset > PI)
+        offset -= 2.0f * PI;
+    else if (offset < -PI)
+        offset += 2.0f * PI;
+    return offset;
+}
+
+// Signed hinge angle, zero for a flat hinge, and its gradient for the masses c, d, a, b
+// Normals follow the winding of both triangles and are left unnormalized, the gradient divides by their squares
+struct HingeGeometry
+{
+    float angle = 0.0f;
+    glm::vec3 gradient[4];
+};
+
+bool hingeGeometry(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d,
+                   HingeGeometry &out)
+{
+    glm::vec3 edge = b - a;
+    float edgeLength = glm::length(edge);
+    glm::vec3 normalC = glm::cross(c - a, c - b);
+    glm::vec3 normalD = glm::cross(d - b, d - a);
+    float squaredC = glm::dot(normalC, normalC);
+    float squaredD = glm::dot(normalD, normalD);
+
+    // Collapsed triangles have no direction to move along
+    if (edgeLength < 0.0001f || squaredC < 1e-12f || squaredD < 1e-12f)
+        return false;
+
+    float inverseLength = 1.0f / edgeLength;
+    glm::vec3 scaledC = normalC * (1.0f / squaredC);
+    glm::vec3 scaledD = normalD * (1.0f / squaredD);
+
+    out.angle = std::atan2(glm::dot(glm::cross(normalD, normalC), edge) * inverseLength, glm::dot(normalC, normalD));
+    out.gradient[0] = edgeLength * scaledC;
+    out.gradient[1] = edgeLength * scaledD;
+    out.gradient[2] =
+        (glm::dot(c - b, edge) * inverseLength) * scaledC + (glm::dot(d - b, edge) * inverseLength) * scaledD;
+    out.gradient[3] = -(out.gradient[0] + out.gradient[1] + out.gradient[2]);
+    return true;
+}
+} // namespace
+
+void DihedralBending::clear()
+{
+    hinges.clear();
+    coloring.clear();
+}
+
+void DihedralBending::build(const std::vector<unsigned int> &triangles, const std::vector<glm::vec3> &restPositions,
+                            const StructuredGrid *grid)
+{
+    sides.clear();
+    sides.reserve(triangles.size());
+    for (int t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            int start = triangles[t + corner];
+            int end = triangles[t + (corner + 1) % 3];
+            int opposite = triangles[t + (corner + 2) % 3];
+            uint64_t key = (uint64_t(std::min(start, end)) << 32) | uint32_t(std::max(start, end));
+            sides.push_back({key, {opposite, start}});
+        }
+    }
+    std::sort(sides.begin(), sides.end());
+
+    hinges.clear();
+    for (int i = 0; i < sides.size();)
+    {
+        int j = i + 1;
+        while (j < sides.size() && sides[j].first == sides[i].first)
+            j++;
+
+        // Boundary and non manifold edges get no hinge, nor do sides that disagree on the winding
+        int a = static_cast<int>(sides[i].first >> 32);
+        int b = static_cast<int>(sides[i].first & 0xffffffffu);
+        if (j - i == 2 && sides[i].second.second != sides[i + 1].second.second)
+        {
+            bool intact = true;
+            if (grid && grid->active())
+            {
+                int edge = grid->edgeBetween(a, b);
+                intact = edge >= 0 && !grid->isBroken(edge);
+            }
+
+            // The side that runs from a to b gives c
+            int oppositeFirst = sides[i].second.first;
+            int oppositeSecond = sides[i + 1].second.first;
+            Hinge hinge{a, b, oppositeFirst, oppositeSecond, 0.0f};
+            if (sides[i].second.second != a)
+                std::swap(hinge.c, hinge.d);
+
+            // A rest hinge that is already degenerate keeps the flat target
+            HingeGeometry rest;
+            if (hingeGeometry(restPositions[a], restPositions[b], restPositions[hinge.c], restPositions[hinge.d], rest))
+                hinge.restAngle = rest.angle;
+            if (intact)
+                hinges.push_back(hinge);
+        }
+        i = j;
+    }
+
+    // Hinges of one color share no mass and are solved in parallel
+    int massCount = 0;
+    for (unsigned int index : triangles)
+        massCount = std::max(massCount, static_cast<int>(index) + 1);
+    coloring.build(static_cast<int>(hinges.size()), massCount, [&](int h, auto &&visit) {
+        visit(hinges[h].a);
+        visit(hinges[h].b);
+        visit(hinges[h].c);
+        visit(hinges[h].d);
+    });
+
+    std::vector<Hinge> sorted(hinges.size());
+    for (int h = 0; h < sorted.size(); h++)
+        sorted[h] = hinges[coloring.getOrder()[h]];
+    hinges.swap(sorted);
+}
+
+void DihedralBending::solveIteration(std::vector<Mass> &masses, float stiffness, bool pinned,
+                                     TaskScheduler &scheduler) const
+{
+    coloring.run(scheduler, HINGE_GRAIN, [&](int first, int last) {
+        if (pinned)
+            solve<true>(masses, stiffness, first, last);
+        else
+            solve<false>(masses, stiffness, first, last);
+    });
+}
+
+template <bool Pinned>
+void DihedralBending::solve(std::vector<Mass> &masses, float stiffness, int begin, int end) const
+{
+    HingeGeometry geometry;
+    for (int h = begin; h < end; h++)
+    {
+        const Hinge &hinge = hinges[h];
+        Mass *corners[4] = {&masses[hinge.c], &masses[hinge.d], &masses[hinge.a], &masses[hinge.b]};
+        if (!hingeGeometry(corners[2]->position, corners[3]->position, corners[0]->position, corners[1]->position,
+                           geometry))
+            continue;
+
+        // Unit weights like the springs, fixed masses do not move
+        float weights[4];
+        float denominator = 0.0f;
+        for (int k = 0; k < 4; k++)
+        {
+            weights[k] = Pinned && corners[k]->fixed ? 0.0f : 1.0f;
+            denominator += weights[k] * glm::dot(geometry.gradient[k], geometry.gradient[k]);
+        }
+        if (denominator < 1e-12f)
+            continue;
+
+        float scale = -stiffness * angleOffset(geometry.angle, hinge.restAngle) / denominator;
+        for (int k = 0; k < 4; k++)
+            corners[k]->position += (scale * weights[k]) * geometry.gradient[k];
+    }
+}
+
+float DihedralBending::meanAngle(const std::vector<Mass> &masses) const
+{
+    HingeGeometry geometry;
+    double total = 0.0;
+    for (const Hinge &hinge : hinges)
+    {
+        if (hingeGeometry(masses[hinge.a].position, masses[hinge.b].position, masses[hinge.c].position,
+                          masses[hinge.d].position, geometry))
+            total += std::abs(angleOffset(geometry.angle, hinge.restAngle));
+    }
+    return hinges.empty() ? 0.0f : static_cast<float>(total / hinges.size());
+}
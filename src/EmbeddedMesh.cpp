@@ -0,0 +1,448 @@
+#include "EmbeddedMesh.hpp"
+#include "AABB.hpp"
+#include "BVH.hpp"
+#include "Cloth.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+const int VERTEX_GRAIN = 2048;
+const int BIND_GRAIN = 256;
+const char CACHE_MAGIC[4] = {'C', 'B', 'N', 'D'};
+const uint32_t CACHE_VERSION = 1;
+// Barycentric slack when a binding is attached again, covers rounding between triangles
+const float ATTACH_TOLERANCE = 1e-3f;
+
+struct Frame
+{
+    glm::vec3 tangent, bitangent, normal;
+};
+
+// Interpolated normal of the masses, the tangent follows the texture u direction across the triangle
+Frame triangleFrame(const Mass &a, const Mass &b, const Mass &c, const glm::vec3 &weights)
+{
+    glm::vec3 edgeB = b.position - a.position;
+    glm::vec3 edgeC = c.position - a.position;
+
+    Frame frame;
+    frame.normal = a.normal * weights.x + b.normal * weights.y + c.normal * weights.z;
+    float length = glm::length(frame.normal);
+    if (length < 1e-6f)
+    {
+        frame.normal = glm::cross(edgeB, edgeC);
+        length = glm::length(frame.normal);
+    }
+    frame.normal = length > 1e-12f ? frame.normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+    glm::vec2 texB = b.texCoord - a.texCoord;
+    glm::vec2 texC = c.texCoord - a.texCoord;
+    float determinant = texB.x * texC.y - texC.x * texB.y;
+    glm::vec3 tangent = std::abs(determinant) > 1e-12f ? (edgeB * texC.y - edgeC * texB.y) / determinant : edgeB;
+    tangent -= frame.normal * glm::dot(frame.normal, tangent);
+    length = glm::length(tangent);
+    frame.tangent = length > 1e-12f ? tangent / length : glm::vec3(1.0f, 0.0f, 0.0f);
+    frame.bitangent = glm::cross(frame.normal, frame.tangent);
+    return frame;
+}
+
+// Barycentric weights of the projection of p onto the plane of the triangle, not clamped
+glm::vec3 planeWeights(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 v0 = b - a, v1 = c - a, v2 = p - a;
+    float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1);
+    float d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+    float denominator = d00 * d11 - d01 * d01;
+    if (std::abs(denominator) < 1e-20f)
+        return glm::vec3(1.0f, 0.0f, 0.0f);
+    float wb = (d11 * d20 - d01 * d21) / denominator;
+    float wc = (d00 * d21 - d01 * d20) / denominator;
+    return glm::vec3(1.0f - wb - wc, wb, wc);
+}
+
+// Same in texture space, false for collapsed texture triangles
+bool textureWeights(const glm::vec2 &p, const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c, glm::vec3 &out)
+{
+    glm::vec2 v0 = b - a, v1 = c - a, v2 = p - a;
+    float denominator = v0.x * v1.y - v1.x * v0.y;
+    if (std::abs(denominator) < 1e-20f)
+        return false;
+    float wb = (v2.x * v1.y - v1.x * v2.y) / denominator;
+    float wc = (v0.x * v2.y - v2.x * v0.y) / denominator;
+    out = glm::vec3(1.0f - wb - wc, wb, wc);
+    return true;
+}
+
+// Squared distance to the closest point of the triangle
+float triangleDistance2(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 weights = planeWeights(p, a, b, c);
+    if (weights.x >= 0.0f && weights.y >= 0.0f && weights.z >= 0.0f)
+    {
+        glm::vec3 offset = p - (a * weights.x + b * weights.y + c * weights.z);
+        return glm::dot(offset, offset);
+    }
+
+    // Outside the triangle the closest point lies on one of the edges
+    auto segment = [&](const glm::vec3 &from, const glm::vec3 &to) {
+        glm::vec3 edge = to - from;
+        float length2 = glm::dot(edge, edge);
+        float t = length2 > 1e-20f ? std::clamp(glm::dot(p - from, edge) / length2, 0.0f, 1.0f) : 0.0f;
+        glm::vec3 offset = p - (from + edge * t);
+        return glm::dot(offset, offset);
+    };
+    return std::min(segment(a, b), std::min(segment(b, c), segment(c, a)));
+}
+
+void hashBytes(uint64_t &hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+} // namespace
+
+bool EmbeddedMesh::load(const std::string &meshPath)
+{
+    clear();
+    if (!mesh.load(meshPath))
+        return false;
+    path = meshPath;
+    return true;
+}
+
+void EmbeddedMesh::clear()
+{
+    path.clear();
+    mesh.clear();
+    bindings.clear();
+    triangleOf.clear();
+    weights.clear();
+    indices.clear();
+    attachedTriangles.clear();
+    hidden = 0;
+    fromCache = false;
+}
+
+uint64_t EmbeddedMesh::bindKey(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles) const
+{
+    uint64_t hash = 14695981039346656037ull;
+    hashBytes(hash, mesh.positions.data(), mesh.positions.size() * sizeof(glm::vec3));
+    hashBytes(hash, triangles.data(), triangles.size() * sizeof(unsigned int));
+    for (const Mass &mass : masses)
+    {
+        hashBytes(hash, &mass.position, sizeof(glm::vec3));
+        hashBytes(hash, &mass.texCoord, sizeof(glm::vec2));
+    }
+    return hash;
+}
+
+std::string EmbeddedMesh::cachePath() const
+{
+    return path + ".binding";
+}
+
+bool EmbeddedMesh::readCache(uint64_t key)
+{
+    std::ifstream file(cachePath(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    uint64_t storedKey = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    file.read(reinterpret_cast<char *>(&storedKey), sizeof(storedKey));
+    file.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version != CACHE_VERSION ||
+        storedKey != key || count != static_cast<uint32_t>(mesh.vertexCount()))
+        return false;
+
+    bindings.resize(count);
+    file.read(reinterpret_cast<char *>(bindings.data()), count * sizeof(Binding));
+    if (!file)
+    {
+        bindings.clear();
+        return false;
+    }
+    return true;
+}
+
+void EmbeddedMesh::writeCache(uint64_t key) const
+{
+    std::ofstream file(cachePath(), std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to write binding cache: " << cachePath() << "\n";
+        return;
+    }
+
+    uint32_t count = static_cast<uint32_t>(bindings.size());
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    file.write(reinterpret_cast<const char *>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+    file.write(reinterpret_cast<const char *>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char *>(bindings.data()), count * sizeof(Binding));
+}
+
+void EmbeddedMesh::bind(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                        TaskScheduler &scheduler)
+{
+    bindings.clear();
+    fromCache = false;
+    if (mesh.vertexCount() == 0 || triangles.empty())
+        return;
+
+    uint64_t key = bindKey(masses, triangles);
+    if (readCache(key))
+    {
+        fromCache = true;
+        attach(masses, triangles, scheduler);
+        return;
+    }
+
+    std::vector<AABB> bounds;
+    bounds.reserve(triangles.size() / 3);
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        const glm::vec3 &a = masses[triangles[t]].position;
+        const glm::vec3 &b = masses[triangles[t + 1]].position;
+        const glm::vec3 &c = masses[triangles[t + 2]].position;
+        bounds.emplace_back(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+    }
+    BVH bvh;
+    bvh.build(bounds);
+
+    // Nearest triangle of every render vertex, boxes farther than the best hit so far are skipped
+    bindings.resize(mesh.vertexCount());
+    scheduler.parallelFor(0, mesh.vertexCount(), BIND_GRAIN, [&](int begin, int end) {
+        for (int v = begin; v < end; v++)
+        {
+            const glm::vec3 &p = mesh.positions[v];
+            float best = std::numeric_limits<float>::max();
+            int nearest = 0;
+            bvh.traverse(
+                [&](const glm::vec3 &min, const glm::vec3 &max) {
+                    glm::vec3 outside = glm::max(glm::max(min - p, p - max), glm::vec3(0.0f));
+                    return glm::dot(outside, outside) < best;
+                },
+                [&](int t) {
+                    float distance = triangleDistance2(p, masses[triangles[t * 3]].position,
+                                                       masses[triangles[t * 3 + 1]].position,
+                                                       masses[triangles[t * 3 + 2]].position);
+                    if (distance < best)
+                    {
+                        best = distance;
+                        nearest = t;
+                    }
+                });
+
+            const Mass &a = masses[triangles[nearest * 3]];
+            const Mass &b = masses[triangles[nearest * 3 + 1]];
+            const Mass &c = masses[triangles[nearest * 3 + 2]];
+            glm::vec3 w = planeWeights(p, a.position, b.position, c.position);
+            Frame frame = triangleFrame(a, b, c, w);
+            glm::vec3 base = a.position * w.x + b.position * w.y + c.position * w.z;
+            const glm::vec3 &normal = mesh.normals[v];
+
+            Binding &binding = bindings[v];
+            binding.material = a.texCoord * w.x + b.texCoord * w.y + c.texCoord * w.z;
+            binding.offset = glm::dot(p - base, frame.normal);
+            binding.localNormal = glm::vec3(glm::dot(normal, frame.tangent), glm::dot(normal, frame.bitangent),
+                                            glm::dot(normal, frame.normal));
+            binding.outside = std::min(0.0f, std::min(w.x, std::min(w.y, w.z)));
+        }
+    });
+
+    writeCache(key);
+    attach(masses, triangles, scheduler);
+}
+
+void EmbeddedMesh::attach(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                          TaskScheduler &scheduler)
+{
+    const int vertexCount = static_cast<int>(bindings.size());
+    const int triangleCount = static_cast<int>(triangles.size() / 3);
+    triangleOf.assign(vertexCount, -1);
+    weights.assign(vertexCount, glm::vec3(0.0f));
+    indices.clear();
+    attachedTriangles.clear();
+    hidden = vertexCount;
+    if (vertexCount == 0 || triangleCount == 0)
+        return;
+
+    // Triangles bucketed by their texture bounds, a binding looks at its cell and the ones around it
+    glm::vec2 low(std::numeric_limits<float>::max());
+    glm::vec2 high(std::numeric_limits<float>::lowest());
+    for (unsigned int mass : triangles)
+    {
+        low = glm::min(low, masses[mass].texCoord);
+        high = glm::max(high, masses[mass].texCoord);
+    }
+    const int cells = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(triangleCount))));
+    const glm::vec2 scale = static_cast<float>(cells) / glm::max(high - low, glm::vec2(1e-6f));
+    auto cellOf = [&](const glm::vec2 &uv, int &x, int &y) {
+        glm::vec2 cell = (uv - low) * scale;
+        x = std::clamp(static_cast<int>(std::floor(cell.x)), 0, cells - 1);
+        y = std::clamp(static_cast<int>(std::floor(cell.y)), 0, cells - 1);
+    };
+
+    std::vector<int> cellStart(cells * cells + 1, 0);
+    std::vector<int> cellTriangles;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<int> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (int t = 0; t < triangleCount; t++)
+        {
+            const glm::vec2 &a = masses[triangles[t * 3]].texCoord;
+            const glm::vec2 &b = masses[triangles[t * 3 + 1]].texCoord;
+            const glm::vec2 &c = masses[triangles[t * 3 + 2]].texCoord;
+            int x0, y0, x1, y1;
+            cellOf(glm::min(a, glm::min(b, c)), x0, y0);
+            cellOf(glm::max(a, glm::max(b, c)), x1, y1);
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    if (pass == 0)
+                        cellStart[y * cells + x + 1]++;
+                    else
+                        cellTriangles[cursor[y * cells + x]++] = t;
+                }
+            }
+        }
+        if (pass == 0)
+        {
+            for (int cell = 0; cell < cells * cells; cell++)
+                cellStart[cell + 1] += cellStart[cell];
+            cellTriangles.resize(cellStart.back());
+        }
+    }
+
+    // The triangle that covers the point best, bindings beyond every triangle are hidden
+    scheduler.parallelFor(0, vertexCount, VERTEX_GRAIN, [&](int begin, int end) {
+        for (int v = begin; v < end; v++)
+        {
+            const Binding &binding = bindings[v];
+            int cx, cy;
+            cellOf(binding.material, cx, cy);
+
+            float bestScore = std::numeric_limits<float>::lowest();
+            for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, cells - 1); y++)
+            {
+                for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cells - 1); x++)
+                {
+                    for (int i = cellStart[y * cells + x]; i < cellStart[y * cells + x + 1]; i++)
+                    {
+                        int t = cellTriangles[i];
+                        glm::vec3 w;
+                        if (!textureWeights(binding.material, masses[triangles[t * 3]].texCoord,
+                                            masses[triangles[t * 3 + 1]].texCoord,
+                                            masses[triangles[t * 3 + 2]].texCoord, w))
+                            continue;
+
+                        float score = std::min(w.x, std::min(w.y, w.z));
+                        if (score > bestScore)
+                        {
+                            bestScore = score;
+                            triangleOf[v] = t;
+                            weights[v] = w;
+                        }
+                    }
+                }
+            }
+
+            if (bestScore < binding.outside - ATTACH_TOLERANCE)
+                triangleOf[v] = -1;
+        }
+    });
+    hidden = static_cast<int>(std::count(triangleOf.begin(), triangleOf.end(), -1));
+
+    for (int t : triangleOf)
+    {
+        if (t >= 0)
+            attachedTriangles.push_back(t);
+    }
+    std::sort(attachedTriangles.begin(), attachedTriangles.end());
+    attachedTriangles.erase(std::unique(attachedTriangles.begin(), attachedTriangles.end()), attachedTriangles.end());
+
+    // Split masses keep their texture coordinates, triangles that meet there without a common mass were torn
+    auto sameSide = [&](int s, int t) {
+        if (s == t)
+            return true;
+        bool touching = false;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                unsigned int a = triangles[s * 3 + i];
+                unsigned int b = triangles[t * 3 + j];
+                if (a == b)
+                    return true;
+                touching |= masses[a].texCoord == masses[b].texCoord;
+            }
+        }
+        return !touching;
+    };
+
+    indices.reserve(mesh.indices.size());
+    for (size_t r = 0; r + 2 < mesh.indices.size(); r += 3)
+    {
+        int t0 = triangleOf[mesh.indices[r]];
+        int t1 = triangleOf[mesh.indices[r + 1]];
+        int t2 = triangleOf[mesh.indices[r + 2]];
+        if (t0 < 0 || t1 < 0 || t2 < 0 || !sameSide(t0, t1) || !sameSide(t1, t2) || !sameSide(t2, t0))
+            continue;
+        indices.insert(indices.end(), {mesh.indices[r], mesh.indices[r + 1], mesh.indices[r + 2]});
+    }
+}
+
+void EmbeddedMesh::evaluate(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                            std::vector<float> &vertices, TaskScheduler &scheduler) const
+{
+    const int vertexCount = static_cast<int>(bindings.size());
+    vertices.resize(static_cast<size_t>(vertexCount) * 8);
+
+    scheduler.parallelFor(0, vertexCount, VERTEX_GRAIN, [&](int begin, int end) {
+        for (int v = begin; v < end; v++)
+        {
+            float *out = &vertices[static_cast<size_t>(v) * 8];
+            int t = triangleOf[v];
+            if (t < 0)
+            {
+                std::fill(out, out + 8, 0.0f);
+                continue;
+            }
+
+            const Mass &a = masses[triangles[t * 3]];
+            const Mass &b = masses[triangles[t * 3 + 1]];
+            const Mass &c = masses[triangles[t * 3 + 2]];
+            const glm::vec3 &w = weights[v];
+            const Binding &binding = bindings[v];
+
+            Frame frame = triangleFrame(a, b, c, w);
+            glm::vec3 position = a.position * w.x + b.position * w.y + c.position * w.z + frame.normal * binding.offset;
+            glm::vec3 normal = frame.tangent * binding.localNormal.x + frame.bitangent * binding.localNormal.y +
+                               frame.normal * binding.localNormal.z;
+
+            out[0] = position.x;
+            out[1] = position.y;
+            out[2] = position.z;
+            out[3] = normal.x;
+            out[4] = normal.y;
+            out[5] = normal.z;
+            out[6] = mesh.texCoords[v].x;
+            out[7] = mesh.texCoords[v].y;
+        }
+    });
+}
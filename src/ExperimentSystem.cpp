@@ -1,7 +1,10 @@
 #include "ExperimentSystem.hpp"
+#include "InputJournal.hpp"
+#include "TaskScheduler.hpp"
 #include <chrono>
 #include <filesystem>
 #include <iostream>
+#include <limits>
 #include <thread>
 
 ExperimentLogger::ExperimentLogger()
@@ -36,6 +39,11 @@ void ExperimentLogger::startExperiment(const std::string &name)
                "maxVelocity,height,width,resX,resY,fps\n";
     isOpen = true;
     std::cout << "Started experiment: " << experimentName << "\n";
+
+    // Runs are only reproducible across machines with the deterministic scheduler
+    const TaskScheduler &scheduler = TaskScheduler::instance();
+    std::cout << "Scheduler: " << scheduler.getThreadCount() << " threads"
+              << (scheduler.isDeterministic() ? ", deterministic" : "") << "\n";
 }
 
 void ExperimentLogger::logFrame(const FrameData &data, int runNumber)
@@ -68,8 +76,39 @@ void ExperimentLogger::endExperiment()
     }
 }
 
-ExperimentSystem::ExperimentSystem(Cloth *clothPtr) : cloth(clothPtr)
+ExperimentSystem::ExperimentSystem(Cloth *clothPtr, InputJournal *journalPtr) : cloth(clothPtr), journal(journalPtr)
+{
+}
+
+void ExperimentSystem::journalStep(float dt)
+{
+    // Settings changed by the run since the last frame are flushed ahead of the step
+    if (journal)
+    {
+        journal->beginFrame();
+        journal->recordStep(dt);
+    }
+}
+
+void ExperimentSystem::resetCloth()
 {
+    if (journal)
+        journal->recordReset();
+    cloth->reset();
+}
+
+void ExperimentSystem::resizeCloth(float width, float height, int resX, int resY)
+{
+    if (journal)
+        journal->recordResize(width, height, resX, resY);
+    cloth->resize(width, height, resX, resY);
+}
+
+void ExperimentSystem::freeCloth()
+{
+    if (journal)
+        journal->recordFree();
+    cloth->freeCloth();
 }
 
 FrameData ExperimentSystem::collectFrameData(float time, double fps)
@@ -87,20 +126,25 @@ FrameData ExperimentSystem::collectFrameData(float time, double fps)
     data.avgTension = analysisData.averageSystemTension;
     data.totalMasses = cloth->getMasses().size();
 
-    float sumVelocity = 0.0f;
-    float maxVel = 0.0f;
     const auto &masses = cloth->getMasses();
 
-    for (const auto &mass : masses)
-    {
-        glm::vec3 vel = mass.position - mass.prevPosition;
-        float speed = glm::length(vel);
-        sumVelocity += speed;
-        maxVel = std::max(maxVel, speed);
-    }
-
-    data.avgVelocity = masses.empty() ? 0.0f : sumVelocity / masses.size();
-    data.maxVelocity = maxVel;
+    // x: summed speed, y: max speed
+    glm::vec2 velocity = TaskScheduler::instance().parallelReduce(
+        0, static_cast<int>(masses.size()), 4096, glm::vec2(0.0f),
+        [&](int begin, int end) {
+            glm::vec2 partial(0.0f);
+            for (int i = begin; i < end; ++i)
+            {
+                float speed = glm::length(masses[i].position - masses[i].prevPosition);
+                partial.x += speed;
+                partial.y = std::max(partial.y, speed);
+            }
+            return partial;
+        },
+        [](glm::vec2 a, const glm::vec2 &b) { return glm::vec2(a.x + b.x, std::max(a.y, b.y)); });
+
+    data.avgVelocity = masses.empty() ? 0.0f : velocity.x / masses.size();
+    data.maxVelocity = velocity.y;
 
     data.width = cloth->getClothWidth();
     data.height = cloth->getClothHeight();
@@ -120,6 +164,7 @@ void ExperimentSystem::runSimulation(int runNumber, float duration, int logInter
 
     while (currentTime < duration)
     {
+        journalStep(dt);
         cloth->update(dt);
         currentTime += dt;
         frameCount++;
@@ -149,7 +194,7 @@ void ExperimentSystem::exp1_thresholdImpact()
         float threshold = thresholds[i];
         logger.logEvent("Testing threshold: " + std::to_string(threshold));
 
-        cloth->reset();
+        resetCloth();
         cloth->setEnableTensionBreaking(true);
         cloth->setTensionBreakThreshold(threshold);
 
@@ -178,7 +223,7 @@ void ExperimentSystem::exp2_windStrength()
         float strength = windStrengths[i];
         logger.logEvent("Testing wind strength: " + std::to_string(strength));
 
-        cloth->reset();
+        resetCloth();
         cloth->setEnableTensionBreaking(true);
         cloth->setTensionBreakThreshold(3.5f);
 
@@ -209,7 +254,7 @@ void ExperimentSystem::exp3_windDirection()
     {
         logger.logEvent("Testing wind direction #" + std::to_string(i));
 
-        cloth->reset();
+        resetCloth();
         cloth->setEnableTensionBreaking(true);
 
         auto &fm = cloth->getForceManager();
@@ -238,7 +283,7 @@ void ExperimentSystem::exp4_gravityImpact()
         float gravity = gravityValues[i];
         logger.logEvent("Testing gravity: " + std::to_string(gravity));
 
-        cloth->reset();
+        resetCloth();
         cloth->setEnableTensionBreaking(true);
 
         auto &fm = cloth->getForceManager();
@@ -269,7 +314,7 @@ void ExperimentSystem::exp5_cascadeBreaking()
     {
         logger.logEvent("Cascade test run #" + std::to_string(run));
 
-        cloth->reset();
+        resetCloth();
         cloth->setEnableTensionBreaking(true);
         cloth->setTensionBreakThreshold(3.0f);
 
@@ -298,7 +343,7 @@ void ExperimentSystem::exp6_solverStability()
         int iter = iterations[i];
         logger.logEvent("Testing solver iterations: " + std::to_string(iter));
 
-        cloth->reset();
+        resetCloth();
         cloth->setSolverParameters(iter, 0.15f, 1.2f);
         cloth->setEnableTensionBreaking(true);
 
@@ -334,7 +379,7 @@ void ExperimentSystem::exp7_meshSizePerf()
         auto &config = configs[i];
         logger.logEvent("Testing mesh: " + std::to_string(config.resX) + "x" + std::to_string(config.resY));
 
-        cloth->resize(config.width, config.height, config.resX, config.resY);
+        resizeCloth(config.width, config.height, config.resX, config.resY);
         cloth->setEnableTensionBreaking(true);
 
         auto &fm = cloth->getForceManager();
@@ -347,7 +392,7 @@ void ExperimentSystem::exp7_meshSizePerf()
         runSimulation(i, 8.0f, 10);
     }
 
-    cloth->resize(3.0f, 3.0f, 25, 25);
+    resizeCloth(3.0f, 3.0f, 25, 25);
     logger.endExperiment();
 }
 
@@ -373,7 +418,7 @@ void ExperimentSystem::exp8_springTypes()
         logger.logEvent("Testing material: " + config.name);
 
         cloth->setPhysicalProperties(config.mass, config.structural, 1.5f, config.shear, 1.0f, config.bending, 0.8f);
-        cloth->reset();
+        resetCloth();
         cloth->setEnableTensionBreaking(true);
 
         auto &fm = cloth->getForceManager();
@@ -389,6 +434,162 @@ void ExperimentSystem::exp8_springTypes()
     logger.endExperiment();
 }
 
+void ExperimentSystem::exp9_bendingModels()
+{
+    logger.startExperiment("exp9_bending_models");
+    logger.logEvent("Comparing skip springs with dihedral hinges, iterations until the RMS violation is met");
+
+    struct BendingConfig
+    {
+        std::string name;
+        BendingModel model;
+    };
+
+    // Hanging in the wind keeps the springs under tension, a dropped cloth folds up on the floor under compression
+    struct Scenario
+    {
+        std::string name;
+        bool dropped;
+    };
+
+    std::vector<BendingConfig> configs = {{"skip_springs", BendingModel::SKIP_SPRINGS},
+                                          {"dihedral", BendingModel::DIHEDRAL}};
+    std::vector<Scenario> scenarios = {{"hanging", false}, {"dropped", true}};
+    std::vector<float> tolerances = {0.05f, 0.02f, 0.005f};
+    const int maxIterations = 30;
+    const float dt = 0.016f;
+    const float duration = 8.0f;
+
+    int run = 0;
+    for (const auto &scenario : scenarios)
+    {
+        for (const auto &config : configs)
+        {
+            for (float tolerance : tolerances)
+            {
+                std::string name = scenario.name + " " + config.name + " at tolerance " + std::to_string(tolerance);
+                logger.logEvent("Testing " + name);
+
+                cloth->setBendingModel(config.model);
+                resetCloth();
+                cloth->setSolverParameters(maxIterations, 0.15f, 1.2f);
+                if (scenario.dropped)
+                    freeCloth();
+
+                ConvergenceParams convergence;
+                convergence.enabled = true;
+                convergence.tolerance = tolerance;
+                convergence.useRms = true;
+                cloth->setConvergenceParams(convergence);
+
+                auto &fm = cloth->getForceManager();
+                if (WindForce *wind = fm.getForce<WindForce>())
+                {
+                    wind->setEnabled(!scenario.dropped);
+                    wind->setStrength(10.0f);
+                }
+
+                // The residual curve of the last step holds one entry per iteration it used
+                double iterations = 0.0;
+                double stepMs = 0.0;
+                int frames = 0;
+                for (float time = 0.0f; time < duration; time += dt)
+                {
+                    journalStep(dt);
+                    auto start = std::chrono::steady_clock::now();
+                    cloth->update(dt);
+                    stepMs +=
+                        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    iterations += cloth->getAnalysis().getResidualMax().size();
+                    frames++;
+
+                    if (frames % 10 == 0)
+                        logger.logFrame(collectFrameData(time + dt, 1.0 / dt), run);
+                }
+
+                int constraints =
+                    cloth->getAnalysisDisplayData().totalSprings + cloth->getDihedralBending().getHingeCount();
+                double meanIterations = iterations / std::max(frames, 1);
+                logger.logEvent(name + ": " + std::to_string(meanIterations) + " iterations per step, " +
+                                std::to_string(constraints) + " constraints, " +
+                                std::to_string(meanIterations * constraints) + " evaluations per step, " +
+                                std::to_string(stepMs / std::max(frames, 1)) + " ms per step");
+                run++;
+            }
+        }
+    }
+
+    cloth->setBendingModel(BendingModel::SKIP_SPRINGS);
+    cloth->setConvergenceParams(ConvergenceParams());
+    resetCloth();
+    logger.endExperiment();
+}
+
+void ExperimentSystem::exp10_membraneModels()
+{
+    logger.startExperiment("exp10_membrane_models");
+    logger.logEvent("Comparing a spring grid with triangle elements on a grid with a quarter of the masses");
+
+    struct MembraneConfig
+    {
+        std::string name;
+        MembraneModel model;
+        int resolution;
+    };
+
+    std::vector<MembraneConfig> configs = {{"springs_40", MembraneModel::MASS_SPRING, 40},
+                                           {"membrane_20", MembraneModel::COROTATIONAL, 20},
+                                           {"springs_20", MembraneModel::MASS_SPRING, 20}};
+    const float dt = 0.016f;
+    const float duration = 8.0f;
+
+    for (int i = 0; i < configs.size(); i++)
+    {
+        auto &config = configs[i];
+        logger.logEvent("Testing " + config.name);
+
+        cloth->setMembraneModel(config.model);
+        resizeCloth(4.0f, 4.0f, config.resolution, config.resolution);
+        cloth->setSolverParameters(10, 0.15f, 1.2f);
+
+        auto &fm = cloth->getForceManager();
+        if (WindForce *wind = fm.getForce<WindForce>())
+        {
+            wind->setEnabled(true);
+            wind->setStrength(10.0f);
+        }
+
+        double stepMs = 0.0;
+        float maxTension = 0.0f;
+        int frames = 0;
+        for (float time = 0.0f; time < duration; time += dt)
+        {
+            journalStep(dt);
+            auto start = std::chrono::steady_clock::now();
+            cloth->update(dt);
+            stepMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            maxTension = std::max(maxTension, cloth->getAnalysis().getMaxTension());
+            frames++;
+
+            if (frames % 10 == 0)
+                logger.logFrame(collectFrameData(time + dt, 1.0 / dt), i);
+        }
+
+        // The lowest mass shows how far the cloth stretched under its weight and the wind
+        float lowest = std::numeric_limits<float>::max();
+        for (const auto &mass : cloth->getMasses())
+            lowest = std::min(lowest, mass.position.y);
+
+        logger.logEvent(config.name + ": " + std::to_string(cloth->getMasses().size()) + " masses, largest stretch " +
+                        std::to_string(maxTension) + ", lowest mass at " + std::to_string(lowest) + ", " +
+                        std::to_string(stepMs / std::max(frames, 1)) + " ms per step");
+    }
+
+    cloth->setMembraneModel(MembraneModel::MASS_SPRING);
+    resizeCloth(4.0f, 4.0f, 30, 30);
+    logger.endExperiment();
+}
+
 void ExperimentSystem::runAllExp()
 {
     std::cout << "\n========================================\n";
@@ -403,6 +604,8 @@ void ExperimentSystem::runAllExp()
     exp6_solverStability();
     exp7_meshSizePerf();
     exp8_springTypes();
+    exp9_bendingModels();
+    exp10_membraneModels();
 
     std::cout << "\n========================================\n";
     std::cout << "All experiments completed!\n";
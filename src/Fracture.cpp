@@ -0,0 +1,285 @@
+#include "Fracture.hpp"
+#include "Cloth.hpp"
+#include "Membrane.hpp"
+#include "StructuredGrid.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+// Values of the broken flag
+const uint8_t INTACT = 0;
+const uint8_t BROKEN = 1;
+const uint8_t PENDING_BREAK = 2;
+
+// Grid rows measured per task
+const int ROW_GRAIN = 16;
+} // namespace
+
+void FractureSystem::reset(size_t springCount)
+{
+    strain.assign(springCount, 1.0f);
+    tensionCounter.assign(springCount, 0);
+    damage.assign(springCount, 0.0f);
+    broken.assign(springCount, INTACT);
+
+    overloads.clear();
+    pending.clear();
+    events.clear();
+}
+
+void FractureSystem::grow(size_t springCount)
+{
+    strain.resize(springCount, 1.0f);
+    tensionCounter.resize(springCount, 0);
+    damage.resize(springCount, 0.0f);
+    broken.resize(springCount, INTACT);
+}
+
+template <typename Endpoints>
+void FractureSystem::detect(int begin, int end, const std::vector<Mass> &masses, Endpoints &&endpoints,
+                            const FractureParams &params)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        if (broken[i] != INTACT)
+            continue;
+
+        float stretchRatio = strain[i];
+
+        if (stretchRatio <= params.threshold)
+        {
+            tensionCounter[i] = 0;
+            continue;
+        }
+
+        tensionCounter[i]++;
+        damage[i] += stretchRatio - params.threshold;
+
+        if (tensionCounter[i] < params.framesBeforeBreak && damage[i] < params.fatigueLimit)
+            continue;
+
+        // Springs holding a pinned mass need a bigger overload
+        int a, b;
+        endpoints(i, a, b);
+        if (masses[a].fixed != masses[b].fixed && stretchRatio < params.threshold * 1.5f)
+            continue;
+
+        broken[i] = PENDING_BREAK;
+    }
+}
+
+template <typename Endpoints>
+int FractureSystem::collect(const std::vector<Mass> &masses, Endpoints &&endpoints, float simulationTime)
+{
+    int newBreaks = 0;
+
+    for (int i = 0; i < broken.size(); ++i)
+    {
+        if (broken[i] != PENDING_BREAK)
+            continue;
+
+        broken[i] = BROKEN;
+        pending.push_back(i);
+        newBreaks++;
+
+        int a, b;
+        endpoints(i, a, b);
+        glm::vec3 breakPos = (masses[a].position + masses[b].position) * 0.5f;
+        events.emplace_back(simulationTime, i, breakPos, strain[i]);
+    }
+
+    return newBreaks;
+}
+
+void FractureSystem::detectRange(int begin, int end, const std::vector<Mass> &masses,
+                                 const std::vector<Spring> &springs, const FractureParams &params)
+{
+    detect(begin, end, masses, [&](int i, int &a, int &b) {
+        a = springs[i].a;
+        b = springs[i].b;
+    }, params);
+}
+
+void FractureSystem::detectRange(int begin, int end, const std::vector<Mass> &masses, const MembraneSystem &membrane,
+                                 const FractureParams &params)
+{
+    detect(begin, end, masses, [&](int i, int &a, int &b) { membrane.endpoints(i, a, b); }, params);
+}
+
+int FractureSystem::collectEvents(const std::vector<Mass> &masses, const std::vector<Spring> &springs,
+                                  float simulationTime)
+{
+    return collect(masses, [&](int i, int &a, int &b) {
+        a = springs[i].a;
+        b = springs[i].b;
+    }, simulationTime);
+}
+
+int FractureSystem::collectEvents(const std::vector<Mass> &masses, const MembraneSystem &membrane,
+                                  float simulationTime)
+{
+    return collect(masses, [&](int i, int &a, int &b) { membrane.endpoints(i, a, b); }, simulationTime);
+}
+
+int FractureSystem::checkGrid(const std::vector<Mass> &masses, StructuredGrid &grid, const FractureParams &params,
+                              float simulationTime, TaskScheduler &scheduler)
+{
+    // Row ranges run in parallel, each one lists its overstretched edges
+    const int rows = grid.rowCount();
+    rangeStretches.resize((rows + ROW_GRAIN - 1) / ROW_GRAIN);
+    scheduler.parallelFor(0, rows, ROW_GRAIN, [&](int begin, int end) {
+        std::vector<Stretch> &found = rangeStretches[begin / ROW_GRAIN];
+        found.clear();
+        grid.forEachEdge(begin, end, [&](int edge, int a, int b, float restLength, int) {
+            float stretchRatio = glm::length(masses[b].position - masses[a].position) / restLength;
+            if (stretchRatio > params.threshold)
+                found.push_back({edge, stretchRatio});
+        });
+    });
+
+    stretches.clear();
+    for (const auto &found : rangeStretches)
+        stretches.insert(stretches.end(), found.begin(), found.end());
+    std::sort(stretches.begin(), stretches.end(),
+              [](const Stretch &left, const Stretch &right) { return left.edge < right.edge; });
+
+    // Merge with the edges seen before, both lists are sorted by edge
+    int newBreaks = 0;
+    size_t next = 0;
+    mergedOverloads.clear();
+    for (const Stretch &stretch : stretches)
+    {
+        // Edges that relaxed keep their damage, their counter starts over
+        for (; next < overloads.size() && overloads[next].edge < stretch.edge; ++next)
+            mergedOverloads.push_back({overloads[next].edge, 0, overloads[next].damage});
+
+        Overload load{stretch.edge, 0, 0.0f};
+        if (next < overloads.size() && overloads[next].edge == stretch.edge)
+            load = overloads[next++];
+
+        load.tensionCounter++;
+        load.damage += stretch.stretchRatio - params.threshold;
+
+        int a, b;
+        grid.endpoints(stretch.edge, a, b);
+        bool due = load.tensionCounter >= params.framesBeforeBreak || load.damage >= params.fatigueLimit;
+        // Springs holding a pinned mass need a bigger overload
+        bool anchored = masses[a].fixed != masses[b].fixed && stretch.stretchRatio < params.threshold * 1.5f;
+        if (!due || anchored)
+        {
+            mergedOverloads.push_back(load);
+            continue;
+        }
+
+        grid.breakEdge(stretch.edge);
+        newBreaks++;
+
+        glm::vec3 breakPos = (masses[a].position + masses[b].position) * 0.5f;
+        events.emplace_back(simulationTime, stretch.edge, breakPos, stretch.stretchRatio);
+    }
+    for (; next < overloads.size(); ++next)
+        mergedOverloads.push_back({overloads[next].edge, 0, overloads[next].damage});
+    overloads.swap(mergedOverloads);
+
+    return newBreaks;
+}
+
+void FractureSystem::expandGrid(size_t springCount)
+{
+    strain.assign(springCount, 1.0f);
+    tensionCounter.assign(springCount, 0);
+    damage.assign(springCount, 0.0f);
+    broken.assign(springCount, INTACT);
+
+    for (const Overload &load : overloads)
+    {
+        tensionCounter[load.edge] = load.tensionCounter;
+        damage[load.edge] = load.damage;
+    }
+    overloads.clear();
+}
+
+void FractureSystem::markBroken(int spring)
+{
+    if (broken[spring] == BROKEN)
+        return;
+
+    broken[spring] = BROKEN;
+    pending.push_back(spring);
+}
+
+void FractureSystem::takeBroken(std::vector<int> &items)
+{
+    items.swap(pending);
+    pending.clear();
+    std::sort(items.begin(), items.end(), std::greater<int>());
+}
+
+void FractureSystem::removeSlot(int slot)
+{
+    int last = static_cast<int>(broken.size()) - 1;
+    strain[slot] = strain[last];
+    tensionCounter[slot] = tensionCounter[last];
+    damage[slot] = damage[last];
+    broken[slot] = broken[last];
+
+    strain.pop_back();
+    tensionCounter.pop_back();
+    damage.pop_back();
+    broken.pop_back();
+}
+
+template <typename Move> int FractureSystem::compactWith(int count, Move &&move)
+{
+    int write = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (broken[i] == BROKEN)
+            continue;
+
+        if (write != i)
+        {
+            move(i, write);
+            strain[write] = strain[i];
+            tensionCounter[write] = tensionCounter[i];
+            damage[write] = damage[i];
+            broken[write] = broken[i];
+        }
+        write++;
+    }
+
+    strain.resize(write);
+    tensionCounter.resize(write);
+    damage.resize(write);
+    broken.resize(write);
+
+    pending.clear();
+    return write;
+}
+
+void FractureSystem::compact(std::vector<Spring> &springs)
+{
+    int kept = compactWith(static_cast<int>(springs.size()), [&](int from, int to) { springs[to] = springs[from]; });
+    springs.erase(springs.begin() + kept, springs.end());
+}
+
+template <typename T> static void applyOrder(std::vector<T> &values, const std::vector<int> &order)
+{
+    std::vector<T> reordered;
+    reordered.reserve(values.size());
+    for (int index : order)
+        reordered.push_back(values[index]);
+    values.swap(reordered);
+}
+
+void FractureSystem::permute(std::vector<Spring> &springs, const std::vector<int> &order)
+{
+    applyOrder(springs, order);
+    applyOrder(strain, order);
+    applyOrder(tensionCounter, order);
+    applyOrder(damage, order);
+    applyOrder(broken, order);
+}
@@ -0,0 +1,68 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace
+{
+const std::align_val_t BLOCK_ALIGNMENT{alignof(std::max_align_t)};
+}
+
+FrameArena::FrameArena(size_t initialCapacity) : capacity(initialCapacity)
+{
+    block = static_cast<std::byte *>(::operator new(capacity, BLOCK_ALIGNMENT));
+}
+
+FrameArena::~FrameArena()
+{
+    reset();
+    ::operator delete(block, BLOCK_ALIGNMENT);
+}
+
+void FrameArena::reset()
+{
+    for (const Spill &spill : spills)
+        std::pmr::new_delete_resource()->deallocate(spill.pointer, spill.bytes, spill.alignment);
+
+    // Grow once to fit the whole frame, the spill list keeps its capacity
+    size_t peak = used + spilledBytes;
+    if (!spills.empty() && peak > capacity)
+    {
+        ::operator delete(block, BLOCK_ALIGNMENT);
+        capacity = std::max(peak + peak / 2, capacity * 2);
+        block = static_cast<std::byte *>(::operator new(capacity, BLOCK_ALIGNMENT));
+    }
+
+    spills.clear();
+    spilledBytes = 0;
+    used = 0;
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>(block);
+    uintptr_t start = (base + used + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    size_t end = static_cast<size_t>(start - base) + bytes;
+
+    if (end <= capacity)
+    {
+        used = end;
+        return reinterpret_cast<void *>(start);
+    }
+
+    void *pointer = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    spills.push_back({pointer, bytes, alignment});
+    spilledBytes += bytes;
+    return pointer;
+}
+
+void FrameArena::do_deallocate(void *, size_t, size_t)
+{
+    // Memory is released by reset
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,238 @@
+#include "FrameGovernor.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+// Weight of the newest step in the averaged time
+const float AVERAGE_WEIGHT = 0.1f;
+// Adjustments kept in the log
+const size_t MAX_ADJUSTMENTS = 1000;
+// Longest restore wait as a multiple of restoreFrames
+const int MAX_RESTORE_BACKOFF = 16;
+
+// Iterations move by a quarter, at least one
+int iterationStep(int iterations)
+{
+    return std::max(1, iterations / 4);
+}
+} // namespace
+
+void FrameGovernor::setParams(const GovernorParams &newParams)
+{
+    if (newParams.enabled && !params.enabled)
+    {
+        hasAverage = false;
+        cooldown = 0;
+        underBand = 0;
+        sinceRestore = -1;
+        restoreBackoff = 1;
+        reductions.clear();
+    }
+    params = newParams;
+}
+
+bool FrameGovernor::update(float stepMs, float simulationTime, GovernedSettings &settings)
+{
+    averageMs = hasAverage ? averageMs + (stepMs - averageMs) * AVERAGE_WEIGHT : stepMs;
+    hasAverage = true;
+
+    // Settings pulled outside the bounds by the user are brought back first
+    GovernedSettings clamped = settings;
+    clamped.iterations = std::clamp(settings.iterations, params.minIterations, params.maxIterations);
+    clamped.substeps = std::clamp(settings.substeps, params.minSubsteps, params.maxSubsteps);
+    clamped.analysisInterval = std::clamp(settings.analysisInterval, 1, params.maxAnalysisInterval);
+    if (clamped.iterations != settings.iterations)
+        record(simulationTime, GovernorKnob::ITERATIONS, settings.iterations, clamped.iterations);
+    if (clamped.substeps != settings.substeps)
+        record(simulationTime, GovernorKnob::SUBSTEPS, settings.substeps, clamped.substeps);
+    if (clamped.analysisInterval != settings.analysisInterval)
+        record(simulationTime, GovernorKnob::ANALYSIS_INTERVAL, settings.analysisInterval, clamped.analysisInterval);
+
+    bool changed = clamped.iterations != settings.iterations || clamped.substeps != settings.substeps ||
+                   clamped.analysisInterval != settings.analysisInterval;
+    settings = clamped;
+
+    // A restore that held for a full wait was right, the next one waits the normal time again
+    if (sinceRestore >= 0 && ++sinceRestore > params.cooldownFrames + params.restoreFrames * restoreBackoff)
+    {
+        sinceRestore = -1;
+        restoreBackoff = 1;
+    }
+
+    if (cooldown > 0)
+    {
+        cooldown--;
+        return changed;
+    }
+
+    if (averageMs > params.budgetMs * (1.0f + params.hysteresis))
+    {
+        underBand = 0;
+        changed |= reduce(settings, simulationTime);
+    }
+    else if (averageMs < params.budgetMs * (1.0f - params.hysteresis))
+    {
+        if (++underBand >= params.restoreFrames * restoreBackoff)
+            changed |= restore(settings, simulationTime);
+    }
+    else
+    {
+        underBand = 0;
+    }
+
+    return changed;
+}
+
+bool FrameGovernor::reduce(GovernedSettings &settings, float simulationTime)
+{
+    GovernorKnob knob;
+    int *value;
+    int next;
+    if (settings.analysisInterval < params.maxAnalysisInterval)
+    {
+        knob = GovernorKnob::ANALYSIS_INTERVAL;
+        value = &settings.analysisInterval;
+        next = std::min(settings.analysisInterval * 2, params.maxAnalysisInterval);
+    }
+    else if (settings.iterations > params.minIterations)
+    {
+        knob = GovernorKnob::ITERATIONS;
+        value = &settings.iterations;
+        next = std::max(settings.iterations - iterationStep(settings.iterations), params.minIterations);
+    }
+    else if (settings.substeps > params.minSubsteps)
+    {
+        knob = GovernorKnob::SUBSTEPS;
+        value = &settings.substeps;
+        next = settings.substeps - 1;
+    }
+    else
+    {
+        return false;
+    }
+
+    // Cut again right after a restore, the restore came too early and the next one waits longer
+    if (sinceRestore >= 0)
+        restoreBackoff = std::min(restoreBackoff * 2, MAX_RESTORE_BACKOFF);
+    sinceRestore = -1;
+
+    reductions.push_back({knob, *value});
+    record(simulationTime, knob, *value, next);
+    *value = next;
+    return true;
+}
+
+bool FrameGovernor::restore(GovernedSettings &settings, float simulationTime)
+{
+    while (!reductions.empty())
+    {
+        // Highest priority first, the newest among equals
+        int pick = static_cast<int>(reductions.size()) - 1;
+        for (int i = pick - 1; i >= 0; --i)
+        {
+            if (restorePriority(reductions[i].knob) > restorePriority(reductions[pick].knob))
+                pick = i;
+        }
+        const Reduction reduction = reductions[pick];
+
+        // Statistics are cheap next to the solver, they come back without a prediction
+        // Step time grows about linearly with iterations and substeps, the prediction overestimates the fixed part
+        int *value;
+        int target;
+        bool fits = true;
+        switch (reduction.knob)
+        {
+        case GovernorKnob::ANALYSIS_INTERVAL:
+            value = &settings.analysisInterval;
+            target = std::max(reduction.from, 1);
+            break;
+        case GovernorKnob::ITERATIONS:
+            value = &settings.iterations;
+            target = std::min(reduction.from, params.maxIterations);
+            fits = averageMs * target / settings.iterations < params.budgetMs;
+            break;
+        case GovernorKnob::SUBSTEPS:
+        default:
+            value = &settings.substeps;
+            target = std::min(reduction.from, params.maxSubsteps);
+            fits = averageMs * target / settings.substeps < params.budgetMs;
+            break;
+        }
+
+        // The user already moved the setting past the reduced value
+        bool better = reduction.knob == GovernorKnob::ANALYSIS_INTERVAL ? target < *value : target > *value;
+        if (!better)
+        {
+            reductions.erase(reductions.begin() + pick);
+            continue;
+        }
+
+        // Earlier reductions wait for this one, restoring them first would change the order
+        if (!fits)
+            return false;
+
+        reductions.erase(reductions.begin() + pick);
+        record(simulationTime, reduction.knob, *value, target);
+        *value = target;
+        sinceRestore = 0;
+        return true;
+    }
+
+    return false;
+}
+
+int FrameGovernor::restorePriority(GovernorKnob knob) const
+{
+    switch (knob)
+    {
+    case GovernorKnob::SUBSTEPS:
+        return 2;
+    case GovernorKnob::ITERATIONS:
+        return 1;
+    case GovernorKnob::ANALYSIS_INTERVAL:
+        return params.analysisRestorePriority;
+    }
+    return 0;
+}
+
+void FrameGovernor::record(float simulationTime, GovernorKnob knob, int from, int to)
+{
+    adjustments.push_back({simulationTime, averageMs, params.budgetMs, knob, from, to});
+    if (adjustments.size() > MAX_ADJUSTMENTS)
+        adjustments.pop_front();
+    cooldown = params.cooldownFrames;
+    underBand = 0;
+}
+
+void FrameGovernor::clearAdjustments()
+{
+    adjustments.clear();
+}
+
+const char *FrameGovernor::knobName(GovernorKnob knob)
+{
+    switch (knob)
+    {
+    case GovernorKnob::ITERATIONS:
+        return "Iterations";
+    case GovernorKnob::SUBSTEPS:
+        return "Substeps";
+    case GovernorKnob::ANALYSIS_INTERVAL:
+        return "AnalysisInterval";
+    }
+    return "";
+}
+
+std::string FrameGovernor::exportToCSV() const
+{
+    std::stringstream ss;
+    ss << "Time,StepMs,BudgetMs,Setting,From,To\n";
+    for (const auto &adjustment : adjustments)
+    {
+        ss << adjustment.time << "," << adjustment.stepMs << "," << adjustment.budgetMs << ","
+           << knobName(adjustment.knob) << "," << adjustment.from << "," << adjustment.to << "\n";
+    }
+    return ss.str();
+}
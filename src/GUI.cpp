@@ -4,6 +4,7 @@
 #include "Camera.hpp"
 #include "Cloth.hpp"
 #include "Force.hpp"
+#include "InputJournal.hpp"
 #include <algorithm>
 #include <fstream>
 #include <glm/glm.hpp>
@@ -63,6 +64,7 @@ void ClothGUI::drawClothControls(AppData *appData)
     Camera *camera = appData->camera;
     glm::vec3 *lightPos = appData->lightPos;
     bool *cubeEnabled = appData->cubeEnabled;
+    InputJournal *journal = appData->journal;
 
     if (camera->getCameraBlocked())
         return;
@@ -189,6 +191,35 @@ void ClothGUI::drawClothControls(AppData *appData)
         }
     }
 
+    if (ImGui::CollapsingHeader("Adaptive Refinement"))
+    {
+        RefinementParams params = cloth->getRefinementParams();
+        bool changed = false;
+
+        changed |= ImGui::Checkbox("Enable Refinement", &params.enabled);
+
+        if (params.enabled)
+        {
+            changed |= ImGui::SliderFloat("Split Strain", &params.splitStrain, 1.0f, 1.5f, "%.3fx");
+            changed |= ImGui::SliderFloat("Split Curvature", &params.splitCurvature, 0.5f, 1.0f, "%.3f");
+            changed |= ImGui::SliderFloat("Coarsen Curvature", &params.coarsenCurvature, 0.5f, 1.0f, "%.3f");
+            changed |= ImGui::SliderFloat("Settle Motion", &params.settleMotion, 0.0f, 0.05f, "%.4f");
+            changed |= ImGui::SliderInt("Settle Passes", &params.settlePasses, 1, 60);
+            changed |= ImGui::SliderInt("Mass Budget", &params.massBudget, 500, 20000);
+            changed |= ImGui::Checkbox("Refine Tear Front", &params.splitTearFront);
+            changed |= ImGui::Checkbox("Refine Contacts", &params.splitContacts);
+
+            ImGui::Separator();
+            ImGui::Text("Masses: %zu / %d", cloth->getMasses().size(), params.massBudget);
+            ImGui::Text("Refined Edges: %d", cloth->getRefinedEdgeCount());
+        }
+
+        if (changed)
+        {
+            cloth->setRefinementParams(params);
+        }
+    }
+
     if (ImGui::CollapsingHeader("Physical Properties"))
     {
         ImGui::Text("These settings require cloth reset to apply");
@@ -201,6 +232,8 @@ void ClothGUI::drawClothControls(AppData *appData)
         static float shearDamping = 1.0f;
         static float bendingStiff = 100.0f;
         static float bendingDamping = 0.8f;
+        static bool dihedralBending = false;
+        static bool triangleMembrane = false;
 
         ImGui::Text("Mass Properties:");
         ImGui::SliderFloat("Point Mass", &massValue, 0.0f, 5.0f, "%.2f");
@@ -220,6 +253,23 @@ void ClothGUI::drawClothControls(AppData *appData)
         ImGui::Text("Bending Springs (Folding resistance):");
         ImGui::SliderFloat("Bending Stiffness", &bendingStiff, 10.0f, 500.0f, "%.1f");
         ImGui::SliderFloat("Bending Damping", &bendingDamping, 0.1f, 5.0f, "%.2f");
+        ImGui::Checkbox("Dihedral Bending", &dihedralBending);
+        ImGui::TextWrapped("Angle constraints between neighbouring triangles instead of skip springs, "
+                           "damping only applies to springs");
+        if (cloth->getDihedralBending().active())
+            ImGui::Text("Hinges: %d", cloth->getDihedralBending().getHingeCount());
+
+        ImGui::Separator();
+        ImGui::Checkbox("Triangle Membrane", &triangleMembrane);
+        ImGui::TextWrapped("Co-rotational triangles replace structural and shear springs and bend with hinges, "
+                           "tearing removes triangles");
+        MembraneParams membraneParams = cloth->getMembraneParams();
+        bool membraneChanged = ImGui::SliderFloat("Warp Scale", &membraneParams.warpScale, 0.1f, 2.0f, "%.2f");
+        membraneChanged |= ImGui::SliderFloat("Weft Scale", &membraneParams.weftScale, 0.1f, 2.0f, "%.2f");
+        if (membraneChanged)
+            cloth->setMembraneParams(membraneParams);
+        if (cloth->getMembrane().active())
+            ImGui::Text("Elements: %d", cloth->getMembrane().getElementCount());
 
         ImGui::Separator();
 
@@ -270,9 +320,37 @@ void ClothGUI::drawClothControls(AppData *appData)
         {
             cloth->setPhysicalProperties(massValue, structuralStiff, structuralDamping, shearStiff, shearDamping,
                                          bendingStiff, bendingDamping);
+            cloth->setBendingModel(dihedralBending ? BendingModel::DIHEDRAL : BendingModel::SKIP_SPRINGS);
+            cloth->setMembraneModel(triangleMembrane ? MembraneModel::COROTATIONAL : MembraneModel::MASS_SPRING);
+            journal->recordReset();
             cloth->reset();
             std::cout << "Applied new physical properties and reset cloth\n";
         }
+
+        ImGui::Separator();
+
+        ScheduleParams schedule = cloth->getScheduleParams();
+        bool scheduleChanged = ImGui::Checkbox("Per Family Iterations", &schedule.enabled);
+        ImGui::TextWrapped("Applied at once, counts are capped by the solver iterations");
+        if (schedule.enabled)
+        {
+            static const char *familyNames[SPRING_FAMILY_COUNT] = {"Structural", "Shear", "Bending"};
+            for (int family = 0; family < SPRING_FAMILY_COUNT; family++)
+            {
+                ImGui::PushID(family);
+                ImGui::Text("%s Springs:", familyNames[family]);
+                scheduleChanged |= ImGui::SliderInt("Iterations", &schedule.families[family].iterations, 0, 20);
+                scheduleChanged |=
+                    ImGui::SliderFloat("Relaxation", &schedule.families[family].relaxation, 0.1f, 2.0f, "%.2f");
+                ImGui::PopID();
+            }
+            scheduleChanged |= ImGui::SliderInt("Bending Every Nth Step", &schedule.bendingInterval, 1, 8);
+        }
+
+        if (scheduleChanged)
+        {
+            cloth->setScheduleParams(schedule);
+        }
     }
 
     if (ImGui::CollapsingHeader("Cutting Parameters"))
@@ -303,8 +381,20 @@ void ClothGUI::drawClothControls(AppData *appData)
         static float correctionFactor = 0.15f;
         static float maxStretchRatio = 1.2f;
 
+        // The governor owns iterations and substeps while it runs
+        const bool governed = cloth->getGovernor().getParams().enabled;
+        if (governed)
+            solverIterations = cloth->getSolverIterations();
+
         ImGui::Text("Solver Settings:");
+        ImGui::BeginDisabled(governed);
         ImGui::SliderInt("Iterations", &solverIterations, 1, 20);
+        int substeps = cloth->getSubsteps();
+        if (ImGui::SliderInt("Substeps", &substeps, 1, 8))
+        {
+            cloth->setSubsteps(substeps);
+        }
+        ImGui::EndDisabled();
         ImGui::TextWrapped("More iterations = more stable but slower");
 
         ImGui::SliderFloat("Correction Factor", &correctionFactor, 0.01f, 1.0f, "%.3f");
@@ -315,6 +405,91 @@ void ClothGUI::drawClothControls(AppData *appData)
 
         cloth->setSolverParameters(solverIterations, correctionFactor, maxStretchRatio);
 
+        bool tiled = cloth->getTiledSolver();
+        if (ImGui::Checkbox("Tiled Solver", &tiled))
+        {
+            cloth->setTiledSolver(tiled);
+        }
+        ImGui::TextWrapped("One tile per worker thread, boundary masses are averaged between tiles");
+        if (cloth->getTileSolver().active())
+        {
+            ImGui::Text("Tiles: %d, imbalance %.2f", cloth->getTileSolver().getTileCount(),
+                        cloth->getTileSolver().getImbalance());
+        }
+
+        ImGui::Separator();
+
+        TetherParams tether = cloth->getTetherParams();
+        bool tetherChanged = ImGui::Checkbox("Tethers", &tether.enabled);
+        ImGui::TextWrapped("Limit every free mass to its rest distance from the nearest pin, keeps hanging cloth "
+                           "from stretching with few iterations");
+        if (tether.enabled)
+        {
+            tetherChanged |= ImGui::SliderFloat("Tether Slack", &tether.slack, 1.0f, 1.2f, "%.3fx");
+            ImGui::Text("Tethers: %d, unanchored masses %d", cloth->getTethers().getTetherCount(),
+                        cloth->getTethers().getUnanchoredCount());
+        }
+
+        if (tetherChanged)
+        {
+            cloth->setTetherParams(tether);
+        }
+
+        ImGui::Separator();
+
+        TimestepParams timestep = cloth->getTimestepParams();
+        bool timestepChanged = ImGui::Checkbox("Adaptive Timestep", &timestep.enabled);
+        ImGui::TextWrapped("Split frames into steps bounded by mass speed, stiffness and strain");
+
+        if (timestep.enabled)
+        {
+            timestepChanged |= ImGui::SliderFloat("Safety", &timestep.safety, 0.1f, 1.0f, "%.2f");
+            timestepChanged |= ImGui::SliderFloat("Max Travel", &timestep.maxTravel, 0.05f, 1.0f, "%.2f");
+            timestepChanged |=
+                ImGui::SliderFloat("Strain Rate Limit", &timestep.strainRateLimit, 0.1f, 10.0f, "%.1f/s");
+            timestepChanged |= ImGui::SliderFloat("Tearing Scale", &timestep.tearingScale, 0.1f, 1.0f, "%.2f");
+            timestepChanged |= ImGui::SliderFloat("Max Step", &timestep.maxDt, 0.002f, 0.033f, "%.4f s");
+            ImGui::Text("Step: %.2f ms x %d", cloth->getTimestep() * 1000.0f, cloth->getStepCount());
+        }
+
+        if (timestepChanged)
+        {
+            cloth->setTimestepParams(timestep);
+        }
+
+        ImGui::Separator();
+
+        ConvergenceParams convergence = cloth->getConvergenceParams();
+        bool convergenceChanged = ImGui::Checkbox("Early Termination", &convergence.enabled);
+        ImGui::TextWrapped("Stop iterating once the constraint violation is below the tolerance");
+
+        if (convergence.enabled)
+        {
+            convergenceChanged |= ImGui::SliderFloat("Tolerance", &convergence.tolerance, 0.0f, 0.1f, "%.4f");
+            convergenceChanged |= ImGui::Checkbox("RMS Criterion", &convergence.useRms);
+            convergenceChanged |=
+                ImGui::SliderFloat("Min Improvement", &convergence.minImprovement, 0.0f, 0.1f, "%.3f");
+            convergenceChanged |= ImGui::SliderInt("Min Iterations", &convergence.minIterations, 1, solverIterations);
+
+            const std::vector<float> &residualMax = cloth->getAnalysis().getResidualMax();
+            const std::vector<float> &residualRms = cloth->getAnalysis().getResidualRms();
+            ImGui::Text("Iterations used: %zu / %d", residualMax.size(), solverIterations);
+
+            if (!residualMax.empty())
+            {
+                ImGui::Text("Last residual: max %.5f, rms %.5f", residualMax.back(), residualRms.back());
+                ImGui::PlotLines("Max Residual", residualMax.data(), static_cast<int>(residualMax.size()), 0,
+                                 nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+                ImGui::PlotLines("RMS Residual", residualRms.data(), static_cast<int>(residualRms.size()), 0,
+                                 nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+            }
+        }
+
+        if (convergenceChanged)
+        {
+            cloth->setConvergenceParams(convergence);
+        }
+
         ImGui::Separator();
 
         if (ImGui::Button("Stable (10 iter)"))
@@ -336,6 +511,103 @@ void ClothGUI::drawClothControls(AppData *appData)
         }
     }
 
+    if (ImGui::CollapsingHeader("Frame Budget"))
+    {
+        FrameGovernor &governor = cloth->getGovernor();
+        GovernorParams params = governor.getParams();
+        bool changed = false;
+
+        changed |= ImGui::Checkbox("Enable Governor", &params.enabled);
+        ImGui::TextWrapped("Adjusts iterations, substeps and statistics cadence to keep the step time on budget");
+
+        if (params.enabled)
+        {
+            changed |= ImGui::SliderFloat("Budget", &params.budgetMs, 1.0f, 33.0f, "%.1f ms");
+            changed |= ImGui::SliderFloat("Hysteresis", &params.hysteresis, 0.05f, 0.5f, "%.2f");
+            changed |= ImGui::DragIntRange2("Iteration Range", &params.minIterations, &params.maxIterations, 0.1f, 1,
+                                            20);
+            changed |= ImGui::DragIntRange2("Substep Range", &params.minSubsteps, &params.maxSubsteps, 0.1f, 1, 8);
+            changed |= ImGui::SliderInt("Max Stats Interval", &params.maxAnalysisInterval, 1, 32);
+            changed |= ImGui::SliderInt("Cooldown Frames", &params.cooldownFrames, 1, 120);
+            changed |= ImGui::SliderInt("Restore Frames", &params.restoreFrames, 1, 240);
+            changed |= ImGui::SliderInt("Stats Restore Priority", &params.analysisRestorePriority, 0, 3);
+
+            ImGui::Separator();
+            ImGui::Text("Step: %.2f ms / %.1f ms", governor.getAverageMs(), params.budgetMs);
+            ImGui::Text("Iterations %d, substeps %d, stats every %d frames", cloth->getSolverIterations(),
+                        cloth->getSubsteps(), cloth->getAnalysisInterval());
+        }
+
+        if (changed)
+        {
+            governor.setParams(params);
+        }
+
+        const auto &adjustments = governor.getAdjustments();
+        ImGui::Text("Adjustments: %zu", adjustments.size());
+        ImGui::BeginChild("GovernorLog", ImVec2(0, 100), true);
+        for (size_t i = adjustments.size() > 50 ? adjustments.size() - 50 : 0; i < adjustments.size(); i++)
+        {
+            const GovernorAdjustment &adjustment = adjustments[i];
+            ImGui::Text("%.2fs  %.2f ms  %s %d -> %d", adjustment.time, adjustment.stepMs,
+                        FrameGovernor::knobName(adjustment.knob), adjustment.from, adjustment.to);
+        }
+        ImGui::EndChild();
+
+        if (ImGui::Button("Clear Log", ImVec2(150, 0)))
+        {
+            governor.clearAdjustments();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export Log", ImVec2(150, 0)))
+        {
+            std::ofstream file("governor_log.csv");
+            if (file.is_open())
+            {
+                file << governor.exportToCSV();
+                std::cout << "Governor log exported to governor_log.csv\n";
+            }
+            else
+            {
+                std::cout << "Failed to export governor log\n";
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Subspace Preview"))
+    {
+        PreviewParams params = cloth->getPreviewParams();
+        const SubspacePreview &preview = cloth->getPreview();
+        bool changed = false;
+
+        changed |= ImGui::Checkbox("Enable Preview", &params.enabled);
+        ImGui::TextWrapped("Replaces the solver with a reduced model trained on the current cloth, for tuning forces "
+                           "quickly. Cutting, tearing or pinning falls back to the full solver.");
+        changed |= ImGui::SliderInt("Training Frames", &params.trainingFrames, 30, 600);
+        changed |= ImGui::SliderInt("Max Modes", &params.maxModes, 1, 64);
+        changed |= ImGui::SliderFloat("Energy", &params.energy, 0.9f, 0.99999f, "%.5f");
+
+        if (changed)
+        {
+            cloth->setPreviewParams(params);
+        }
+
+        if (ImGui::Button("Train", ImVec2(150, 0)))
+        {
+            journal->recordPreviewTraining();
+            cloth->startPreviewTraining();
+        }
+
+        if (preview.isTraining())
+            ImGui::Text("Recording %d / %d frames", preview.getRecordedFrames(), params.trainingFrames);
+        else if (preview.ready())
+            ImGui::Text("%d modes, %.4f of the variance", preview.getModeCount(), preview.getExplainedVariance());
+        else
+            ImGui::Text("Not trained");
+        if (params.enabled && preview.ready())
+            ImGui::Text(cloth->isPreviewRunning() ? "Running reduced" : "Stale, full solver");
+    }
+
     if (ImGui::CollapsingHeader("Lighting"))
     {
         ImGui::Text("Light Source Position");
@@ -397,6 +669,43 @@ void ClothGUI::drawClothControls(AppData *appData)
         ImGui::Text("Current Position: (%.1f, %.1f, %.1f)", lightPos->x, lightPos->y, lightPos->z);
     }
 
+    if (ImGui::CollapsingHeader("Render Mesh"))
+    {
+        SubdivisionParams params = cloth->getSubdivisionParams();
+        bool changed = false;
+
+        changed |= ImGui::Checkbox("Smooth Subdivision", &params.enabled);
+        ImGui::TextWrapped("Draws every simulated triangle as a curved patch, the physics resolution stays the same");
+        changed |= ImGui::SliderInt("Segments", &params.segments, 1, SurfaceSubdivision::MAX_SEGMENTS);
+
+        if (changed)
+        {
+            cloth->setSubdivisionParams(params);
+        }
+
+        ImGui::Separator();
+        static char meshPath[256] = "../models/cloth.obj";
+        ImGui::InputText("OBJ File", meshPath, sizeof(meshPath));
+        if (ImGui::Button("Load Mesh", ImVec2(150, 0)))
+        {
+            cloth->loadRenderMesh(meshPath);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Mesh", ImVec2(150, 0)))
+        {
+            cloth->clearRenderMesh();
+        }
+
+        const EmbeddedMesh &renderMesh = cloth->getRenderMesh();
+        if (renderMesh.active())
+        {
+            ImGui::Text("%d vertices, %d hidden, bindings %s", renderMesh.getVertexCount(),
+                        renderMesh.getHiddenCount(), renderMesh.boundFromCache() ? "cached" : "computed");
+        }
+
+        ImGui::Text("Rendered triangles: %d", cloth->getRenderedTriangleCount());
+    }
+
     if (ImGui::CollapsingHeader("Cloth Dimensions"))
     {
         static float newWidth = cloth->getClothWidth();
@@ -445,12 +754,54 @@ void ClothGUI::drawClothControls(AppData *appData)
 
         ImGui::Separator();
 
+        bool structured = cloth->getStructuredGrid();
+        if (ImGui::Checkbox("Structured Grid Storage", &structured))
+        {
+            cloth->setStructuredGrid(structured);
+        }
+        ImGui::TextWrapped("Springs stay implicit in the grid until tearing or refinement needs explicit ones");
+        bool rowPasses = cloth->getGridRowPasses();
+        if (ImGui::Checkbox("Grid Row Passes", &rowPasses))
+        {
+            cloth->setGridRowPasses(rowPasses);
+        }
+        ImGui::TextWrapped("Solves the grid row by row on separate coordinate arrays, faster on large cloths but "
+                           "in a different order than the springs");
+
+        if (ImGui::Button("Reorder Masses for Locality"))
+        {
+            journal->recordReorder();
+            cloth->reorderForLocality();
+        }
+        ImGui::TextWrapped("Renumbers masses along a Z-order curve, useful after heavy tearing or refinement");
+
+        ImGui::Separator();
+
         if (ImGui::Button("Apply New Size", ImVec2(-1, 40)))
         {
+            journal->recordResize(newWidth, newHeight, newResX, newResY);
             cloth->resize(newWidth, newHeight, newResX, newResY);
             std::cout << "Cloth resized to " << newWidth << "x" << newHeight << " with " << newResX << "x" << newResY
                       << " masses" << std::endl;
         }
+
+        ImGui::Separator();
+        static char clothMeshPath[256] = "../models/cloth.obj";
+        static char pinGroup[64] = "pin";
+        ImGui::InputText("Cloth OBJ", clothMeshPath, sizeof(clothMeshPath));
+        ImGui::InputText("Pin Group", pinGroup, sizeof(pinGroup));
+        if (ImGui::Button("Import Mesh as Cloth", ImVec2(-1, 0)))
+        {
+            MeshImportParams params;
+            params.pinGroup = pinGroup;
+            journal->recordClothMesh(clothMeshPath, params);
+            cloth->loadClothMesh(clothMeshPath, params);
+        }
+        ImGui::TextWrapped("Any triangle mesh becomes springs along its edges, Apply New Size returns to the grid");
+        if (cloth->hasClothMesh())
+        {
+            ImGui::Text("Imported: %zu masses, %d springs", cloth->getMasses().size(), cloth->getSpringCount());
+        }
     }
 
     if (ImGui::CollapsingHeader("Forces", ImGuiTreeNodeFlags_DefaultOpen))
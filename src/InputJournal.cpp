@@ -0,0 +1,903 @@
+#include "InputJournal.hpp"
+#include "Object.hpp"
+#include "Ray.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <type_traits>
+
+namespace
+{
+const uint32_t JOURNAL_MAGIC = 0x4e524a43;
+const uint32_t JOURNAL_VERSION = 1;
+const int SLOWEST_FRAMES = 10;
+// Larger payloads can only come from a damaged file
+const uint32_t MAX_PAYLOAD = 1 << 20;
+
+// Appends plain values to a payload
+struct PayloadWriter
+{
+    static const bool READS = false;
+
+    template <typename T> void field(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "payload fields are copied bytewise");
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+    void field(const std::string &value)
+    {
+        field(static_cast<uint32_t>(value.size()));
+        bytes.append(value);
+    }
+
+    std::string bytes;
+};
+
+// Reads the values back in the order they were written, ok turns false at the end of the payload
+struct PayloadReader
+{
+    static const bool READS = true;
+
+    explicit PayloadReader(const std::string &bytes) : bytes(bytes)
+    {
+    }
+
+    template <typename T> void field(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "payload fields are copied bytewise");
+        if (!ok || offset + sizeof(T) > bytes.size())
+        {
+            ok = false;
+            return;
+        }
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        offset += sizeof(T);
+    }
+    void field(std::string &value)
+    {
+        uint32_t size = 0;
+        field(size);
+        if (!ok || offset + size > bytes.size())
+        {
+            ok = false;
+            return;
+        }
+        value.assign(bytes.data() + offset, size);
+        offset += size;
+    }
+
+    const std::string &bytes;
+    size_t offset = 0;
+    bool ok = true;
+};
+
+template <typename Archive> void transferSetup(Archive &archive, JournalSetup &setup)
+{
+    archive.field(setup.width);
+    archive.field(setup.height);
+    archive.field(setup.resX);
+    archive.field(setup.resY);
+    archive.field(setup.floorY);
+    archive.field(setup.cubeCenter);
+    archive.field(setup.cubeSize);
+    archive.field(setup.clothMesh);
+    archive.field(setup.meshImport.pinGroup);
+    archive.field(setup.meshImport.scale);
+    archive.field(setup.meshImport.offset);
+    archive.field(setup.threadCount);
+    archive.field(setup.deterministic);
+}
+
+// Params structs go field by field, their padding would make equal settings compare unequal
+template <typename Archive> void transferFields(Archive &archive, PhysicalProperties &properties)
+{
+    archive.field(properties.mass);
+    archive.field(properties.structuralStiffness);
+    archive.field(properties.structuralDamping);
+    archive.field(properties.shearStiffness);
+    archive.field(properties.shearDamping);
+    archive.field(properties.bendingStiffness);
+    archive.field(properties.bendingDamping);
+}
+
+template <typename Archive> void transferFields(Archive &archive, TimestepParams &params)
+{
+    archive.field(params.enabled);
+    archive.field(params.safety);
+    archive.field(params.minDt);
+    archive.field(params.maxDt);
+    archive.field(params.maxFrameDt);
+    archive.field(params.maxTravel);
+    archive.field(params.strainRateLimit);
+    archive.field(params.tearingScale);
+    archive.field(params.maxGrowth);
+}
+
+template <typename Archive> void transferFields(Archive &archive, ConvergenceParams &params)
+{
+    archive.field(params.enabled);
+    archive.field(params.tolerance);
+    archive.field(params.useRms);
+    archive.field(params.minImprovement);
+    archive.field(params.minIterations);
+}
+
+template <typename Archive> void transferFields(Archive &archive, ScheduleParams &params)
+{
+    archive.field(params.enabled);
+    for (FamilySchedule &family : params.families)
+    {
+        archive.field(family.iterations);
+        archive.field(family.relaxation);
+    }
+    archive.field(params.bendingInterval);
+}
+
+template <typename Archive> void transferFields(Archive &archive, MembraneParams &params)
+{
+    archive.field(params.warpScale);
+    archive.field(params.weftScale);
+}
+
+template <typename Archive> void transferFields(Archive &archive, TetherParams &params)
+{
+    archive.field(params.enabled);
+    archive.field(params.slack);
+}
+
+template <typename Archive> void transferFields(Archive &archive, PreviewParams &params)
+{
+    archive.field(params.enabled);
+    archive.field(params.trainingFrames);
+    archive.field(params.maxModes);
+    archive.field(params.energy);
+    archive.field(params.ridge);
+    archive.field(params.margin);
+}
+
+template <typename Archive> void transferFields(Archive &archive, RefinementParams &params)
+{
+    archive.field(params.enabled);
+    archive.field(params.interval);
+    archive.field(params.splitStrain);
+    archive.field(params.splitCurvature);
+    archive.field(params.settleMotion);
+    archive.field(params.coarsenCurvature);
+    archive.field(params.settlePasses);
+    archive.field(params.minEdgeFraction);
+    archive.field(params.massBudget);
+    archive.field(params.splitTearFront);
+    archive.field(params.splitContacts);
+}
+
+template <typename Archive> void transferFields(Archive &archive, GovernorParams &params)
+{
+    archive.field(params.enabled);
+    archive.field(params.budgetMs);
+    archive.field(params.hysteresis);
+    archive.field(params.minIterations);
+    archive.field(params.maxIterations);
+    archive.field(params.minSubsteps);
+    archive.field(params.maxSubsteps);
+    archive.field(params.maxAnalysisInterval);
+    archive.field(params.cooldownFrames);
+    archive.field(params.restoreFrames);
+    archive.field(params.analysisRestorePriority);
+}
+
+template <typename Archive> void transferForces(Archive &archive, ForceManager &forces)
+{
+    // Reset puts gravity and wind back, the oscillating force is added on demand
+    if (GravityForce *gravity = forces.getForce<GravityForce>())
+    {
+        bool enabled = gravity->isEnabled();
+        float g = gravity->getGravity();
+        archive.field(enabled);
+        archive.field(g);
+        if (Archive::READS)
+        {
+            gravity->setEnabled(enabled);
+            gravity->setGravity(g);
+        }
+    }
+    if (WindForce *wind = forces.getForce<WindForce>())
+    {
+        bool enabled = wind->isEnabled();
+        glm::vec3 direction = wind->getDirection();
+        float strength = wind->getStrength();
+        archive.field(enabled);
+        archive.field(direction);
+        archive.field(strength);
+        if (Archive::READS)
+        {
+            wind->setEnabled(enabled);
+            wind->setDirection(direction);
+            wind->setStrength(strength);
+        }
+    }
+
+    std::vector<OscillatingForce *> oscillations = forces.getForces<OscillatingForce>();
+    int count = static_cast<int>(oscillations.size());
+    archive.field(count);
+    if (Archive::READS)
+    {
+        while (static_cast<int>(oscillations.size()) < count)
+            oscillations.push_back(forces.addForce<OscillatingForce>(glm::vec3(1.0f, 0.0f, 0.0f), 3.0f, 2.0f));
+    }
+    for (int i = 0; i < count && i < static_cast<int>(oscillations.size()); i++)
+    {
+        OscillatingForce *oscillation = oscillations[i];
+        bool enabled = oscillation->isEnabled();
+        glm::vec3 direction = oscillation->getDirection();
+        float amplitude = oscillation->getAmplitude();
+        float frequency = oscillation->getFrequency();
+        archive.field(enabled);
+        archive.field(direction);
+        archive.field(amplitude);
+        archive.field(frequency);
+        if (Archive::READS)
+        {
+            oscillation->setEnabled(enabled);
+            oscillation->setDirection(direction);
+            oscillation->setAmplitude(amplitude);
+            oscillation->setFrequency(frequency);
+        }
+    }
+}
+
+// Copies one block of settings from the cloth into a writer, or from a reader into the cloth
+template <typename Archive> void transferSettings(Archive &archive, Cloth &cloth, SettingsBlock block)
+{
+    switch (block)
+    {
+    case SettingsBlock::SOLVER: {
+        int iterations = cloth.getSolverIterations();
+        float correction = cloth.getCorrectionFactor();
+        float maxStretch = cloth.getMaxStretchRatio();
+        int substeps = cloth.getSubsteps();
+        int analysisInterval = cloth.getAnalysisInterval();
+        archive.field(iterations);
+        archive.field(correction);
+        archive.field(maxStretch);
+        archive.field(substeps);
+        archive.field(analysisInterval);
+        if (Archive::READS)
+        {
+            cloth.setSolverParameters(iterations, correction, maxStretch);
+            cloth.setSubsteps(substeps);
+            cloth.setAnalysisInterval(analysisInterval);
+        }
+        break;
+    }
+    case SettingsBlock::PHYSICAL: {
+        PhysicalProperties properties = cloth.getPhysicalProperties();
+        transferFields(archive, properties);
+        if (Archive::READS)
+        {
+            cloth.setPhysicalProperties(properties.mass, properties.structuralStiffness,
+                                        properties.structuralDamping, properties.shearStiffness,
+                                        properties.shearDamping, properties.bendingStiffness,
+                                        properties.bendingDamping);
+        }
+        break;
+    }
+    case SettingsBlock::INTERACTION: {
+        bool tensionBreaking = cloth.getEnableTensionBreaking();
+        float breakThreshold = cloth.getTensionBreakThreshold();
+        float cutThreshold = cloth.getCutThreshold();
+        bool collisions = cloth.getEnableCollisions();
+        archive.field(tensionBreaking);
+        archive.field(breakThreshold);
+        archive.field(cutThreshold);
+        archive.field(collisions);
+        if (Archive::READS)
+        {
+            cloth.setEnableTensionBreaking(tensionBreaking);
+            cloth.setTensionBreakThreshold(breakThreshold);
+            cloth.setCutThreshold(cutThreshold);
+            cloth.setEnableCollisions(collisions);
+        }
+        break;
+    }
+    case SettingsBlock::TOPOLOGY: {
+        bool structured = cloth.getStructuredGrid();
+        BendingModel bending = cloth.getBendingModel();
+        MembraneModel membrane = cloth.getMembraneModel();
+        bool tiled = cloth.getTiledSolver();
+        bool rowPasses = cloth.getGridRowPasses();
+        archive.field(structured);
+        archive.field(bending);
+        archive.field(membrane);
+        archive.field(tiled);
+        archive.field(rowPasses);
+        if (Archive::READS)
+        {
+            cloth.setStructuredGrid(structured);
+            cloth.setBendingModel(bending);
+            cloth.setMembraneModel(membrane);
+            cloth.setTiledSolver(tiled);
+            cloth.setGridRowPasses(rowPasses);
+        }
+        break;
+    }
+    case SettingsBlock::TIMESTEP: {
+        TimestepParams params = cloth.getTimestepParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setTimestepParams(params);
+        break;
+    }
+    case SettingsBlock::CONVERGENCE: {
+        ConvergenceParams params = cloth.getConvergenceParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setConvergenceParams(params);
+        break;
+    }
+    case SettingsBlock::SCHEDULE: {
+        ScheduleParams params = cloth.getScheduleParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setScheduleParams(params);
+        break;
+    }
+    case SettingsBlock::MEMBRANE: {
+        MembraneParams params = cloth.getMembraneParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setMembraneParams(params);
+        break;
+    }
+    case SettingsBlock::TETHER: {
+        TetherParams params = cloth.getTetherParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setTetherParams(params);
+        break;
+    }
+    case SettingsBlock::PREVIEW: {
+        PreviewParams params = cloth.getPreviewParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setPreviewParams(params);
+        break;
+    }
+    case SettingsBlock::REFINEMENT: {
+        RefinementParams params = cloth.getRefinementParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+            cloth.setRefinementParams(params);
+        break;
+    }
+    case SettingsBlock::GOVERNOR: {
+        // The adjustments of the governor arrive as solver settings, a replay must not make its own
+        GovernorParams params = cloth.getGovernor().getParams();
+        transferFields(archive, params);
+        if (Archive::READS)
+        {
+            params.enabled = false;
+            cloth.getGovernor().setParams(params);
+        }
+        break;
+    }
+    case SettingsBlock::FORCES:
+        transferForces(archive, cloth.getForceManager());
+        break;
+    case SettingsBlock::COUNT:
+        break;
+    }
+}
+
+std::string captureSettings(Cloth &cloth, SettingsBlock block)
+{
+    PayloadWriter writer;
+    transferSettings(writer, cloth, block);
+    return writer.bytes;
+}
+
+// Repeats one recorded input, false when the payload does not fit the event
+bool replayEvent(Cloth &cloth, JournalEvent event, const std::string &bytes)
+{
+    PayloadReader payload(bytes);
+    switch (event)
+    {
+    case JournalEvent::STEP: {
+        float dt = 0.0f;
+        payload.field(dt);
+        cloth.update(dt);
+        break;
+    }
+    case JournalEvent::PICK: {
+        glm::vec3 origin, direction;
+        payload.field(origin);
+        payload.field(direction);
+        cloth.pickMassPoint(Ray(origin, direction));
+        break;
+    }
+    case JournalEvent::DRAG: {
+        int index = -1;
+        glm::vec3 position;
+        payload.field(index);
+        payload.field(position);
+        cloth.setMassPosition(index, position);
+        break;
+    }
+    case JournalEvent::RELEASE: {
+        int index = -1;
+        payload.field(index);
+        cloth.releaseMassPoint(index);
+        break;
+    }
+    case JournalEvent::CUT: {
+        glm::vec3 origin, direction, previousMousePos;
+        glm::mat4 view, projection;
+        int screenWidth = 0, screenHeight = 0;
+        payload.field(origin);
+        payload.field(direction);
+        payload.field(previousMousePos);
+        payload.field(view);
+        payload.field(projection);
+        payload.field(screenWidth);
+        payload.field(screenHeight);
+        cloth.cutSpringsWithRay(Ray(origin, direction), previousMousePos, view, projection, screenWidth,
+                                screenHeight);
+        break;
+    }
+    case JournalEvent::SETTINGS: {
+        // Applied only when they differ, setters with side effects then run as often as they did live
+        SettingsBlock block = SettingsBlock::COUNT;
+        payload.field(block);
+        if (payload.ok && block < SettingsBlock::COUNT &&
+            bytes.compare(payload.offset, std::string::npos, captureSettings(cloth, block)) != 0)
+        {
+            transferSettings(payload, cloth, block);
+        }
+        break;
+    }
+    case JournalEvent::RESET:
+        cloth.reset();
+        break;
+    case JournalEvent::FREE:
+        cloth.freeCloth();
+        break;
+    case JournalEvent::ORIENTATION: {
+        Cloth::ClothOrientation orientation = Cloth::ClothOrientation::VERTICAL;
+        payload.field(orientation);
+        cloth.setOrientation(orientation);
+        break;
+    }
+    case JournalEvent::RESIZE: {
+        float width = 0.0f, height = 0.0f;
+        int resX = 0, resY = 0;
+        payload.field(width);
+        payload.field(height);
+        payload.field(resX);
+        payload.field(resY);
+        cloth.resize(width, height, resX, resY);
+        break;
+    }
+    case JournalEvent::REORDER:
+        cloth.reorderForLocality();
+        break;
+    case JournalEvent::PREVIEW_TRAINING:
+        cloth.startPreviewTraining();
+        break;
+    case JournalEvent::CLOTH_MESH: {
+        std::string meshPath;
+        MeshImportParams params;
+        payload.field(meshPath);
+        payload.field(params.pinGroup);
+        payload.field(params.scale);
+        payload.field(params.offset);
+        cloth.loadClothMesh(meshPath, params);
+        break;
+    }
+    default:
+        payload.ok = false;
+        break;
+    }
+    return payload.ok;
+}
+
+void fnv(uint64_t &hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+}
+} // namespace
+
+InputJournal::~InputJournal()
+{
+    close();
+}
+
+bool InputJournal::open(const std::string &path, Cloth &target, const JournalSetup &setup)
+{
+    close();
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open journal: " << path << "\n";
+        return false;
+    }
+
+    PayloadWriter header;
+    JournalSetup copy = setup;
+    transferSetup(header, copy);
+    uint32_t size = static_cast<uint32_t>(header.bytes.size());
+    file.write(reinterpret_cast<const char *>(&JOURNAL_MAGIC), sizeof(JOURNAL_MAGIC));
+    file.write(reinterpret_cast<const char *>(&JOURNAL_VERSION), sizeof(JOURNAL_VERSION));
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(header.bytes.data(), header.bytes.size());
+
+    cloth = &target;
+    frame = 0;
+    for (std::string &settings : lastSettings)
+        settings.clear();
+    // Every block goes in once, the replay starts from the same settings whatever the defaults are then
+    flushSettings();
+    return true;
+}
+
+void InputJournal::close()
+{
+    if (!cloth)
+        return;
+
+    PayloadWriter payload;
+    payload.field(checksum(*cloth));
+    write(JournalEvent::CHECKSUM, payload.bytes);
+    file.close();
+    cloth = nullptr;
+    std::cout << "Journal closed after " << frame << " frames\n";
+}
+
+void InputJournal::beginFrame()
+{
+    if (!cloth)
+        return;
+
+    frame++;
+    if (frame % CHECKSUM_INTERVAL == 0)
+    {
+        PayloadWriter payload;
+        payload.field(checksum(*cloth));
+        write(JournalEvent::CHECKSUM, payload.bytes);
+        file.flush();
+    }
+    flushSettings();
+}
+
+void InputJournal::recordStep(float dt)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(dt);
+    write(JournalEvent::STEP, payload.bytes);
+}
+
+void InputJournal::recordPick(const Ray &ray)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(ray.Origin());
+    payload.field(ray.Direction());
+    write(JournalEvent::PICK, payload.bytes);
+}
+
+void InputJournal::recordDrag(int index, const glm::vec3 &position)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(index);
+    payload.field(position);
+    write(JournalEvent::DRAG, payload.bytes);
+}
+
+void InputJournal::recordRelease(int index)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(index);
+    write(JournalEvent::RELEASE, payload.bytes);
+}
+
+void InputJournal::recordCut(const Ray &ray, const glm::vec3 &previousMousePos, const glm::mat4 &view,
+                             const glm::mat4 &projection, int screenWidth, int screenHeight)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(ray.Origin());
+    payload.field(ray.Direction());
+    payload.field(previousMousePos);
+    payload.field(view);
+    payload.field(projection);
+    payload.field(screenWidth);
+    payload.field(screenHeight);
+    write(JournalEvent::CUT, payload.bytes);
+}
+
+void InputJournal::recordReset()
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    write(JournalEvent::RESET, std::string());
+}
+
+void InputJournal::recordFree()
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    write(JournalEvent::FREE, std::string());
+}
+
+void InputJournal::recordOrientation(Cloth::ClothOrientation orientation)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(orientation);
+    write(JournalEvent::ORIENTATION, payload.bytes);
+}
+
+void InputJournal::recordResize(float width, float height, int resX, int resY)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(width);
+    payload.field(height);
+    payload.field(resX);
+    payload.field(resY);
+    write(JournalEvent::RESIZE, payload.bytes);
+}
+
+void InputJournal::recordReorder()
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    write(JournalEvent::REORDER, std::string());
+}
+
+void InputJournal::recordPreviewTraining()
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    write(JournalEvent::PREVIEW_TRAINING, std::string());
+}
+
+void InputJournal::recordClothMesh(const std::string &path, const MeshImportParams &params)
+{
+    if (!cloth)
+        return;
+    flushSettings();
+    PayloadWriter payload;
+    payload.field(path);
+    payload.field(params.pinGroup);
+    payload.field(params.scale);
+    payload.field(params.offset);
+    write(JournalEvent::CLOTH_MESH, payload.bytes);
+}
+
+uint64_t InputJournal::checksum(const Cloth &cloth)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const std::vector<Mass> &masses = cloth.getMasses();
+    uint64_t count = masses.size();
+    fnv(hash, &count, sizeof(count));
+    for (const Mass &mass : masses)
+        fnv(hash, &mass.position, sizeof(mass.position));
+    int springs = cloth.getSpringCount();
+    fnv(hash, &springs, sizeof(springs));
+    return hash;
+}
+
+void InputJournal::flushSettings()
+{
+    for (int b = 0; b < static_cast<int>(SettingsBlock::COUNT); b++)
+    {
+        SettingsBlock block = static_cast<SettingsBlock>(b);
+        std::string settings = captureSettings(*cloth, block);
+        if (settings == lastSettings[b])
+            continue;
+
+        PayloadWriter payload;
+        payload.field(block);
+        payload.bytes += settings;
+        write(JournalEvent::SETTINGS, payload.bytes);
+        lastSettings[b] = std::move(settings);
+    }
+}
+
+void InputJournal::write(JournalEvent event, const std::string &payload)
+{
+    // Type, frame and payload size ahead of the payload
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    file.write(reinterpret_cast<const char *>(&event), sizeof(event));
+    file.write(reinterpret_cast<const char *>(&frame), sizeof(frame));
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(payload.data(), payload.size());
+}
+
+JournalReplay::JournalReplay(const std::string &path, int threadCount, bool deterministic)
+    : path(path), threadCount(threadCount), deterministic(deterministic)
+{
+}
+
+int JournalReplay::run()
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open journal: " << path << "\n";
+        return 1;
+    }
+
+    uint32_t magic = 0, version = 0, size = 0;
+    file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    file.read(reinterpret_cast<char *>(&size), sizeof(size));
+    std::string headerBytes(file ? size : 0, '\0');
+    file.read(&headerBytes[0], headerBytes.size());
+    JournalSetup setup;
+    PayloadReader header(headerBytes);
+    transferSetup(header, setup);
+    if (!file || magic != JOURNAL_MAGIC || version != JOURNAL_VERSION || !header.ok)
+    {
+        std::cerr << "Not a journal of this version: " << path << "\n";
+        return 1;
+    }
+
+    TaskScheduler::instance().setThreadCount(threadCount >= 0 ? threadCount : setup.threadCount);
+    TaskScheduler::instance().setDeterministic(deterministic || setup.deterministic);
+
+    Cloth cloth(setup.width, setup.height, setup.resX, setup.resY, setup.floorY, true);
+    if (!setup.clothMesh.empty() && !cloth.loadClothMesh(setup.clothMesh, setup.meshImport))
+        return 1;
+    Cube cube(setup.cubeCenter, setup.cubeSize, nullptr);
+    cloth.addCollisionObject(&cube);
+
+    std::cout << "Replaying " << path << " on " << TaskScheduler::instance().getThreadCount() << " threads"
+              << (TaskScheduler::instance().isDeterministic() ? ", deterministic" : "") << "\n";
+
+    frames.clear();
+    checksums = 0;
+    divergedFrame = -1;
+    bool truncated = false;
+    std::string payloadBytes;
+    while (true)
+    {
+        JournalEvent event;
+        int frame = 0;
+        uint32_t payloadSize = 0;
+        if (!file.read(reinterpret_cast<char *>(&event), sizeof(event)))
+            break;
+        file.read(reinterpret_cast<char *>(&frame), sizeof(frame));
+        file.read(reinterpret_cast<char *>(&payloadSize), sizeof(payloadSize));
+        if (payloadSize > MAX_PAYLOAD)
+        {
+            truncated = true;
+            break;
+        }
+        payloadBytes.resize(file ? payloadSize : 0);
+        file.read(&payloadBytes[0], payloadBytes.size());
+        if (!file)
+        {
+            truncated = true;
+            break;
+        }
+
+        if (event == JournalEvent::CHECKSUM)
+        {
+            uint64_t expected = 0;
+            PayloadReader payload(payloadBytes);
+            payload.field(expected);
+            checksums++;
+            if (payload.ok && expected != InputJournal::checksum(cloth) && divergedFrame < 0)
+                divergedFrame = frame;
+            continue;
+        }
+
+        if (frames.empty() || frames.back().frame != frame)
+            frames.push_back({frame, 0.0, 0});
+        auto start = std::chrono::steady_clock::now();
+
+        bool ok = replayEvent(cloth, event, payloadBytes);
+        frames.back().ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        frames.back().events++;
+        if (!ok)
+        {
+            std::cerr << "Malformed journal record at frame " << frame << "\n";
+            cloth.clearCollisionObjects();
+            return 1;
+        }
+    }
+    cloth.clearCollisionObjects();
+
+    if (truncated)
+        std::cerr << "Journal ends inside a record, it was not closed or is damaged\n";
+    printSummary();
+    writeCSV(path + ".csv");
+    return divergedFrame < 0 ? 0 : 2;
+}
+
+void JournalReplay::printSummary() const
+{
+    if (frames.empty())
+    {
+        std::cout << "Journal holds no frames\n";
+        return;
+    }
+
+    std::vector<double> times;
+    double total = 0.0;
+    for (const ReplayFrame &frame : frames)
+    {
+        times.push_back(frame.ms);
+        total += frame.ms;
+    }
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](double p) {
+        return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))];
+    };
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Frames: " << frames.size() << ", total " << total << " ms, mean " << total / frames.size()
+              << " ms\n";
+    std::cout << "Median " << percentile(0.5) << " ms, p95 " << percentile(0.95) << " ms, max " << times.back()
+              << " ms\n";
+
+    std::vector<ReplayFrame> slowest = frames;
+    std::sort(slowest.begin(), slowest.end(), [](const ReplayFrame &a, const ReplayFrame &b) { return a.ms > b.ms; });
+    slowest.resize(std::min<size_t>(slowest.size(), SLOWEST_FRAMES));
+    std::cout << "Slowest frames:\n";
+    for (const ReplayFrame &frame : slowest)
+        std::cout << "  frame " << frame.frame << ": " << frame.ms << " ms, " << frame.events << " events\n";
+
+    if (divergedFrame >= 0)
+        std::cout << "Replay DIVERGED, first checksum mismatch at frame " << divergedFrame << "\n";
+    else
+        std::cout << "Replay exact, " << checksums << " checksums matched\n";
+    std::cout << std::defaultfloat;
+}
+
+bool JournalReplay::writeCSV(const std::string &csvPath) const
+{
+    std::ofstream csv(csvPath);
+    if (!csv.is_open())
+    {
+        std::cerr << "Failed to write " << csvPath << "\n";
+        return false;
+    }
+
+    csv << "frame,ms,events\n";
+    for (const ReplayFrame &frame : frames)
+        csv << frame.frame << "," << frame.ms << "," << frame.events << "\n";
+    std::cout << "Frame times written to " << csvPath << "\n";
+    return true;
+}
@@ -0,0 +1,244 @@
+#include "Membrane.hpp"
+#include "Cloth.hpp"
+#include "Fracture.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace
+{
+const int ELEMENT_GRAIN = 1024;
+
+// Deformation of one element split into a rotation and a symmetric stretch
+// The frame spans the deformed plane, its first axis follows the deformed warp direction and the second
+// one the deformed weft, so the in plane gradient is upper triangular with a positive diagonal.
+struct ElementStretch
+{
+    glm::vec3 axisU, axisV;
+    // Rotation in the frame
+    float cosine, sine;
+    // Stretch along warp and weft and the shear between them, all 1, 1, 0 at rest
+    float warp, weft, shear;
+
+    float largest() const
+    {
+        float mean = (warp + weft) * 0.5f;
+        float half = (warp - weft) * 0.5f;
+        return mean + std::sqrt(half * half + shear * shear);
+    }
+};
+
+bool elementStretch(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::mat2 &restInverse,
+                    ElementStretch &out)
+{
+    // Columns of the deformation gradient, the deformed images of the rest warp and weft directions
+    glm::vec3 edgeB = b - a;
+    glm::vec3 edgeC = c - a;
+    glm::vec3 gradientU = edgeB * restInverse[0][0] + edgeC * restInverse[0][1];
+    glm::vec3 gradientV = edgeB * restInverse[1][0] + edgeC * restInverse[1][1];
+
+    float lengthU = glm::length(gradientU);
+    if (lengthU < 1e-6f)
+        return false;
+    out.axisU = gradientU / lengthU;
+
+    float along = glm::dot(out.axisU, gradientV);
+    glm::vec3 across = gradientV - out.axisU * along;
+    float lengthV = glm::length(across);
+
+    // Collapsed triangles have no plane to rotate in
+    if (lengthV < 1e-6f)
+        return false;
+    out.axisV = across / lengthV;
+
+    // Closed form polar decomposition of [[lengthU, along], [0, lengthV]]
+    float cosine = lengthU + lengthV;
+    float sine = -along;
+    float scale = std::sqrt(cosine * cosine + sine * sine);
+    out.cosine = cosine / scale;
+    out.sine = sine / scale;
+    out.warp = lengthU * out.cosine;
+    out.weft = (along * along + (lengthU + lengthV) * lengthV) / scale;
+    out.shear = lengthU * along / scale;
+    return true;
+}
+} // namespace
+
+void MembraneSystem::clear()
+{
+    elements.clear();
+    coloring.clear();
+}
+
+void MembraneSystem::build(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                           const glm::vec2 &restSize)
+{
+    elements.clear();
+    elements.reserve(triangles.size() / 3);
+    for (int t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        Element element;
+        element.a = triangles[t];
+        element.b = triangles[t + 1];
+        element.c = triangles[t + 2];
+
+        glm::vec2 restA = masses[element.a].texCoord * restSize;
+        element.restB = masses[element.b].texCoord * restSize - restA;
+        element.restC = masses[element.c].texCoord * restSize - restA;
+
+        glm::mat2 rest(element.restB, element.restC);
+        float area = 0.5f * std::abs(glm::determinant(rest));
+        element.valid = area > 1e-10f;
+        element.restInverse = element.valid ? glm::inverse(rest) : glm::mat2(1.0f);
+        elements.push_back(element);
+    }
+
+    // The solver walks the elements by color, the element list itself keeps the triangle order
+    coloring.build(static_cast<int>(elements.size()), static_cast<int>(masses.size()), [&](int e, auto &&visit) {
+        visit(elements[e].a);
+        visit(elements[e].b);
+        visit(elements[e].c);
+    });
+}
+
+void MembraneSystem::removeElement(int element)
+{
+    coloring.remove(element);
+    elements[element] = elements.back();
+    elements.pop_back();
+}
+
+void MembraneSystem::replaceCorner(int element, int from, int to)
+{
+    Element &target = elements[element];
+    if (target.a == from)
+        target.a = to;
+    else if (target.b == from)
+        target.b = to;
+    else if (target.c == from)
+        target.c = to;
+}
+
+void MembraneSystem::solveIteration(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                                    const SolverPass &pass, const MembraneParams &params, float maxStretchRatio,
+                                    FractureSystem *fracture, bool pinned, TaskScheduler &scheduler,
+                                    SolverResidual *residualOut) const
+{
+    const int structural = static_cast<int>(SpringFamily::STRUCTURAL);
+    const int shear = static_cast<int>(SpringFamily::SHEAR);
+
+    // Same fraction of the error per projection as a spring of the family would remove
+    Relaxation relaxation{0.0f, 0.0f, 0.0f};
+    float stretchLimit = std::numeric_limits<float>::max();
+    if (pass.includes(SpringFamily::STRUCTURAL))
+    {
+        float stiffness = pass.correction[structural] * (materials[structural].stiffness / 100.0f);
+        relaxation.warp = std::min(stiffness * params.warpScale, 1.0f);
+        relaxation.weft = std::min(stiffness * params.weftScale, 1.0f);
+        stretchLimit = maxStretchRatio;
+    }
+    if (pass.includes(SpringFamily::SHEAR))
+        relaxation.shear = std::min(pass.correction[shear] * (materials[shear].stiffness / 100.0f), 1.0f);
+
+    // Partial residuals of the chunks are merged as they finish
+    std::mutex residualMutex;
+    coloring.run(scheduler, ELEMENT_GRAIN, [&](int begin, int end) {
+        SolverResidual residual;
+        SolverResidual *measured = residualOut ? &residual : nullptr;
+        if (pinned && fracture)
+            solve<true, true>(masses, relaxation, stretchLimit, fracture, measured, begin, end);
+        else if (pinned)
+            solve<true, false>(masses, relaxation, stretchLimit, fracture, measured, begin, end);
+        else if (fracture)
+            solve<false, true>(masses, relaxation, stretchLimit, fracture, measured, begin, end);
+        else
+            solve<false, false>(masses, relaxation, stretchLimit, fracture, measured, begin, end);
+
+        if (residualOut)
+        {
+            std::lock_guard<std::mutex> lock(residualMutex);
+            residualOut->merge(residual);
+        }
+    });
+}
+
+template <bool Pinned, bool Record>
+void MembraneSystem::solve(std::vector<Mass> &masses, const Relaxation &relaxation, float maxStretchRatio,
+                           FractureSystem *fracture, SolverResidual *residual, int begin, int end) const
+{
+    const std::vector<int> &order = coloring.getOrder();
+    ElementStretch stretch;
+    for (int position = begin; position < end; position++)
+    {
+        int e = order[position];
+        const Element &element = elements[e];
+        if (!element.valid)
+            continue;
+
+        Mass *corners[3] = {&masses[element.a], &masses[element.b], &masses[element.c]};
+        if (!elementStretch(corners[0]->position, corners[1]->position, corners[2]->position, element.restInverse,
+                            stretch))
+            continue;
+
+        if constexpr (Record)
+            fracture->setStrain(e, stretch.largest());
+        if (residual)
+        {
+            residual->add(stretch.warp);
+            residual->add(stretch.weft);
+        }
+
+        // Target stretch, overstretched threads are pulled back to the limit at once like the springs
+        float warp = std::min(stretch.warp + relaxation.warp * (1.0f - stretch.warp), maxStretchRatio);
+        float weft = std::min(stretch.weft + relaxation.weft * (1.0f - stretch.weft), maxStretchRatio);
+        float shear = stretch.shear * (1.0f - relaxation.shear);
+
+        // Target gradient, the rotation of the element applied to the target stretch
+        glm::vec3 targetU = stretch.axisU * (stretch.cosine * warp - stretch.sine * shear) +
+                            stretch.axisV * (stretch.sine * warp + stretch.cosine * shear);
+        glm::vec3 targetV = stretch.axisU * (stretch.cosine * shear - stretch.sine * weft) +
+                            stretch.axisV * (stretch.sine * shear + stretch.cosine * weft);
+        glm::vec3 offsets[3] = {glm::vec3(0.0f), targetU * element.restB.x + targetV * element.restB.y,
+                                targetU * element.restC.x + targetV * element.restC.y};
+
+        // Unit weights like the springs, the target shape keeps the centroid of the masses that may not move
+        glm::vec3 anchor(0.0f);
+        int anchored = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (Pinned && corners[k]->fixed)
+            {
+                anchor += corners[k]->position - offsets[k];
+                anchored++;
+            }
+        }
+        if (anchored == 3)
+            continue;
+        if (anchored == 0)
+        {
+            for (int k = 0; k < 3; k++)
+                anchor += corners[k]->position - offsets[k];
+            anchored = 3;
+        }
+        anchor /= static_cast<float>(anchored);
+
+        for (int k = 0; k < 3; k++)
+        {
+            if (!Pinned || !corners[k]->fixed)
+                corners[k]->position = anchor + offsets[k];
+        }
+    }
+}
+
+float MembraneSystem::principalStretch(const std::vector<Mass> &masses, int element) const
+{
+    const Element &e = elements[element];
+    ElementStretch stretch;
+    if (!e.valid || !elementStretch(masses[e.a].position, masses[e.b].position, masses[e.c].position, e.restInverse,
+                                    stretch))
+        return 1.0f;
+    return stretch.largest();
+}
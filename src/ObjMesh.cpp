@@ -0,0 +1,289 @@
+#include "ObjMesh.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+const char *lineEnd(const char *p, const char *end)
+{
+    while (p < end && *p != '\n')
+        p++;
+    return p;
+}
+
+// Plain decimal numbers are read directly, anything else goes through strtof
+const char *parseFloat(const char *p, const char *end, float &out)
+{
+    static const double POWERS[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+                                    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *start = p;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    uint64_t mantissa = 0;
+    int digits = 0, scale = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+        mantissa = mantissa * 10 + (*p - '0');
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++, scale--)
+            mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *exponentStart = ++p;
+        bool negativeExponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p++;
+        int exponent = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            exponent = std::min(exponent * 10 + (*p - '0'), 1000);
+        if (p == exponentStart)
+            digits = 0;
+        scale += negativeExponent ? -exponent : exponent;
+    }
+
+    if (digits == 0 || digits > 18 || scale < -22 || scale > 22)
+    {
+        char *next = nullptr;
+        out = std::strtof(start, &next);
+        return next > end ? start : next;
+    }
+
+    double value = scale < 0 ? mantissa / POWERS[-scale] : mantissa * POWERS[scale];
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+// Floats of a v, vt or vn line, missing ones stay zero
+template <int Count> void readFloats(const char *p, const char *end, float *out)
+{
+    for (int i = 0; i < Count; i++)
+    {
+        p = skipBlanks(p, end);
+        const char *next = parseFloat(p, end, out[i]);
+        if (next == p)
+            return;
+        p = next;
+    }
+}
+
+// One based OBJ index, negative ones count back from the last element read so far
+// Returns -1 for an empty field and -2 for one that is not a number
+int readIndex(const char *&p, const char *end, int count)
+{
+    if (p >= end || *p == '/' || isBlank(*p) || *p == '\n')
+        return -1;
+    bool negative = *p == '-';
+    const char *digits = negative ? p + 1 : p;
+    long index = 0;
+    const char *q = digits;
+    for (; q < end && *q >= '0' && *q <= '9' && index < INT32_MAX; q++)
+        index = index * 10 + (*q - '0');
+    if (q == digits)
+        return -2;
+    p = q;
+    return static_cast<int>(negative ? count - index : index - 1);
+}
+} // namespace
+
+void ObjMesh::clear()
+{
+    positions.clear();
+    texCoords.clear();
+    normals.clear();
+    indices.clear();
+    positionIndex.clear();
+    positionCount = 0;
+    groups.clear();
+    triangleGroups.clear();
+}
+
+int ObjMesh::findGroup(const std::string &name) const
+{
+    for (int g = 0; g < groups.size(); g++)
+    {
+        if (groups[g] == name)
+            return g;
+    }
+    return -1;
+}
+
+bool ObjMesh::load(const std::string &path)
+{
+    clear();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open mesh: " << path << "\n";
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    std::string text(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&text[0], text.size());
+
+    std::vector<glm::vec3> filePositions;
+    std::vector<glm::vec2> fileTexCoords;
+    std::vector<glm::vec3> fileNormals;
+    // Vertices of one position line are chained, usually there is one per position
+    std::vector<int> firstOfPosition;
+    std::vector<int> nextOfPosition;
+    std::vector<int> texCoordOf;
+    std::vector<int> normalOf;
+    std::vector<unsigned int> face;
+    bool missingNormals = false;
+    int group = -1;
+
+    const char *p = text.data();
+    const char *end = p + text.size();
+    int lineNumber = 0;
+    while (p < end)
+    {
+        lineNumber++;
+        const char *next = lineEnd(p, end);
+        p = skipBlanks(p, next);
+
+        if (next - p > 2 && p[0] == 'v' && isBlank(p[1]))
+        {
+            float value[3] = {0.0f, 0.0f, 0.0f};
+            readFloats<3>(p + 2, next, value);
+            filePositions.emplace_back(value[0], value[1], value[2]);
+        }
+        else if (next - p > 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+        {
+            float value[2] = {0.0f, 0.0f};
+            readFloats<2>(p + 3, next, value);
+            fileTexCoords.emplace_back(value[0], value[1]);
+        }
+        else if (next - p > 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+        {
+            float value[3] = {0.0f, 0.0f, 0.0f};
+            readFloats<3>(p + 3, next, value);
+            fileNormals.emplace_back(value[0], value[1], value[2]);
+        }
+        else if (next - p > 2 && p[0] == 'g' && isBlank(p[1]))
+        {
+            // Only the first name counts, faces belong to one group here
+            const char *name = skipBlanks(p + 2, next);
+            const char *nameEnd = name;
+            while (nameEnd < next && !isBlank(*nameEnd))
+                nameEnd++;
+            std::string groupName(name, nameEnd);
+            group = findGroup(groupName);
+            if (group < 0)
+            {
+                group = static_cast<int>(groups.size());
+                groups.push_back(groupName);
+            }
+        }
+        else if (next - p > 2 && p[0] == 'f' && isBlank(p[1]))
+        {
+            face.clear();
+            const char *corner = skipBlanks(p + 2, next);
+            while (corner < next)
+            {
+                // v, v/vt, v//vn or v/vt/vn
+                int v = readIndex(corner, next, static_cast<int>(filePositions.size()));
+                int vt = -1, vn = -1;
+                if (corner < next && *corner == '/')
+                {
+                    corner++;
+                    vt = readIndex(corner, next, static_cast<int>(fileTexCoords.size()));
+                    if (corner < next && *corner == '/')
+                    {
+                        corner++;
+                        vn = readIndex(corner, next, static_cast<int>(fileNormals.size()));
+                    }
+                }
+
+                if (v < 0 || v >= static_cast<int>(filePositions.size()) || vt < -1 ||
+                    vt >= static_cast<int>(fileTexCoords.size()) || vn < -1 ||
+                    vn >= static_cast<int>(fileNormals.size()))
+                {
+                    std::cerr << "Bad face index in " << path << " line " << lineNumber << "\n";
+                    clear();
+                    return false;
+                }
+
+                if (v >= firstOfPosition.size())
+                    firstOfPosition.resize(filePositions.size(), -1);
+                int vertex = firstOfPosition[v];
+                while (vertex >= 0 && (texCoordOf[vertex] != vt || normalOf[vertex] != vn))
+                    vertex = nextOfPosition[vertex];
+                if (vertex < 0)
+                {
+                    vertex = static_cast<int>(positions.size());
+                    positions.push_back(filePositions[v]);
+                    texCoords.push_back(vt >= 0 ? fileTexCoords[vt] : glm::vec2(0.0f));
+                    normals.push_back(vn >= 0 ? fileNormals[vn] : glm::vec3(0.0f));
+                    positionIndex.push_back(v);
+                    texCoordOf.push_back(vt);
+                    normalOf.push_back(vn);
+                    nextOfPosition.push_back(firstOfPosition[v]);
+                    firstOfPosition[v] = vertex;
+                    missingNormals |= vn < 0;
+                }
+                face.push_back(vertex);
+                corner = skipBlanks(corner, next);
+            }
+
+            for (size_t i = 1; i + 1 < face.size(); i++)
+            {
+                indices.insert(indices.end(), {face[0], face[i], face[i + 1]});
+                triangleGroups.push_back(group);
+            }
+        }
+
+        p = next + 1;
+    }
+    positionCount = static_cast<int>(filePositions.size());
+
+    if (indices.empty())
+    {
+        std::cerr << "No faces in mesh: " << path << "\n";
+        clear();
+        return false;
+    }
+
+    // Area weighted face normals where the file gave none
+    if (missingNormals)
+    {
+        std::vector<glm::vec3> averaged(positions.size(), glm::vec3(0.0f));
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            glm::vec3 normal = glm::cross(positions[indices[t + 1]] - positions[indices[t]],
+                                          positions[indices[t + 2]] - positions[indices[t]]);
+            for (int k = 0; k < 3; k++)
+                averaged[indices[t + k]] += normal;
+        }
+        for (size_t i = 0; i < normals.size(); i++)
+        {
+            if (glm::length(normals[i]) < 1e-6f)
+                normals[i] = glm::length(averaged[i]) > 1e-12f ? averaged[i] : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    }
+    for (glm::vec3 &normal : normals)
+        normal = glm::normalize(normal);
+
+    return true;
+}
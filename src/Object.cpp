@@ -10,6 +10,9 @@
 Cube::Cube(const glm::vec3 &center, const glm::vec3 &size, const char *texturePath)
     : center(center), size(size), rotation(0.0f), VAO(0), VBO(0), textureID(0)
 {
+    if (!texturePath)
+        return;
+
     setupCube();
     loadTexture(texturePath);
 }
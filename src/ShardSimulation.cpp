@@ -0,0 +1,405 @@
+#include "ShardSimulation.hpp"
+#include "Cloth.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <climits>
+#include <csignal>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Bending springs reach two rows, so a shard needs two rows of every neighbour
+const int HALO_ROWS = 2;
+const int MAX_SHARDS = 64;
+const uint32_t SEGMENT_MAGIC = 0x434c5348;
+
+// Written by the shard after every frame, read by the coordinator for progress
+struct ShardStatus
+{
+    std::atomic<int> frame{0};
+};
+
+// State of one grid point in a slot
+struct ShardMassState
+{
+    glm::vec3 position;
+    glm::vec3 prevPosition;
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32 bit integers");
+} // namespace
+
+// Header of the shared segment, followed by two slots of one ShardMassState per grid point
+struct ShardSegment
+{
+    uint32_t magic = SEGMENT_MAGIC;
+    int shardCount = 0;
+    int pointCount = 0;
+    // Frame barrier, waiters sleep on the generation word
+    std::atomic<uint32_t> arrived{0};
+    std::atomic<uint32_t> generation{0};
+    std::atomic<uint32_t> aborted{0};
+    ShardStatus status[MAX_SHARDS];
+
+    ShardMassState *slot(int frame)
+    {
+        return reinterpret_cast<ShardMassState *>(this + 1) + static_cast<size_t>(frame % 2) * pointCount;
+    }
+};
+
+#ifdef __linux__
+
+namespace
+{
+// The segment is mapped by several processes, so the futex calls are not process private
+void futexWait(std::atomic<uint32_t> &word, uint32_t expected)
+{
+    timespec timeout{0, 100 * 1000 * 1000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+void futexWakeAll(std::atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Returns false once the run was aborted, the timeout lets waiters notice a coordinator abort
+bool frameBarrier(ShardSegment &segment)
+{
+    uint32_t generation = segment.generation.load(std::memory_order_acquire);
+    if (segment.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == segment.shardCount)
+    {
+        segment.arrived.store(0, std::memory_order_relaxed);
+        segment.generation.fetch_add(1, std::memory_order_release);
+        futexWakeAll(segment.generation);
+    }
+    else
+    {
+        while (segment.generation.load(std::memory_order_acquire) == generation)
+        {
+            if (segment.aborted.load(std::memory_order_acquire))
+                return false;
+            futexWait(segment.generation, generation);
+        }
+    }
+    return segment.aborted.load(std::memory_order_acquire) == 0;
+}
+} // namespace
+
+ShardCoordinator::ShardCoordinator(const ShardSettings &settings) : settings(settings)
+{
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+    destroySegment();
+}
+
+int ShardCoordinator::run()
+{
+    if (settings.shardCount < 1 || settings.shardCount > std::min(MAX_SHARDS, settings.resY))
+    {
+        std::cerr << "Shard count must be between 1 and " << std::min(MAX_SHARDS, settings.resY) << "\n";
+        return 1;
+    }
+
+    if (!createSegment())
+        return 1;
+
+    std::cout << "Sharded run: " << settings.shardCount << " shards, " << settings.resX << "x" << settings.resY
+              << " masses, " << settings.frames << " frames, " << settings.threadsPerShard
+              << " threads per shard\n";
+
+    auto start = std::chrono::steady_clock::now();
+    bool finished = launchShards() && monitor();
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    if (!finished)
+    {
+        std::cerr << "Sharded run aborted\n";
+        return 1;
+    }
+
+    std::cout << "Finished in " << seconds << " s, " << settings.frames / std::max(seconds, 1e-6f)
+              << " frames/s\n";
+    printSummary();
+    return 0;
+}
+
+bool ShardCoordinator::createSegment()
+{
+    const size_t pointCount = static_cast<size_t>(settings.resX) * settings.resY;
+    segmentBytes = sizeof(ShardSegment) + 2 * pointCount * sizeof(ShardMassState);
+    segmentName = "/clothSim-" + std::to_string(getpid());
+
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to create shared memory " << segmentName << "\n";
+        return false;
+    }
+
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(segmentBytes)) == 0)
+        memory = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    // Shards inherit the mapping through fork, the name is not needed afterwards and cannot leak
+    shm_unlink(segmentName.c_str());
+
+    if (memory == MAP_FAILED)
+    {
+        std::cerr << "Failed to map shared memory " << segmentName << "\n";
+        return false;
+    }
+
+    segment = new (memory) ShardSegment();
+    segment->shardCount = settings.shardCount;
+    segment->pointCount = static_cast<int>(pointCount);
+    return true;
+}
+
+void ShardCoordinator::destroySegment()
+{
+    if (!segment)
+        return;
+
+    segment->~ShardSegment();
+    munmap(segment, segmentBytes);
+    segment = nullptr;
+}
+
+bool ShardCoordinator::launchShards()
+{
+    // Buffered output would be written again by every child
+    std::cout.flush();
+    std::cerr.flush();
+
+    shardPids.assign(settings.shardCount, -1);
+    for (int shard = 0; shard < settings.shardCount; shard++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int code = runShard(shard);
+            std::cout.flush();
+            _exit(code);
+        }
+
+        if (pid < 0)
+        {
+            std::cerr << "Failed to start shard " << shard << "\n";
+            abortShards();
+            monitor();
+            return false;
+        }
+        shardPids[shard] = pid;
+    }
+    return true;
+}
+
+bool ShardCoordinator::monitor()
+{
+    bool failed = false;
+    auto lastReport = std::chrono::steady_clock::now();
+    auto abortTime = lastReport;
+
+    while (std::any_of(shardPids.begin(), shardPids.end(), [](int pid) { return pid > 0; }))
+    {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0)
+        {
+            auto it = std::find(shardPids.begin(), shardPids.end(), pid);
+            if (it == shardPids.end())
+                continue;
+
+            int shard = static_cast<int>(it - shardPids.begin());
+            *it = -1;
+
+            bool success = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if (!success && !failed)
+            {
+                std::cerr << "Shard " << shard << " failed at frame " << segment->status[shard].frame.load() << "\n";
+                failed = true;
+                abortTime = std::chrono::steady_clock::now();
+                abortShards();
+            }
+            continue;
+        }
+        if (pid < 0)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto now = std::chrono::steady_clock::now();
+
+        // Shards stuck outside the barrier get a grace period before they are killed
+        if (failed && now - abortTime > std::chrono::seconds(2))
+        {
+            for (int remaining : shardPids)
+            {
+                if (remaining > 0)
+                    kill(remaining, SIGKILL);
+            }
+            abortTime = now;
+        }
+
+        if (!failed && now - lastReport > std::chrono::seconds(1))
+        {
+            int slowest = std::numeric_limits<int>::max();
+            for (int shard = 0; shard < settings.shardCount; shard++)
+                slowest = std::min(slowest, segment->status[shard].frame.load(std::memory_order_relaxed));
+            std::cout << "Frame " << slowest << " / " << settings.frames << "\n";
+            lastReport = now;
+        }
+    }
+
+    return !failed;
+}
+
+void ShardCoordinator::abortShards()
+{
+    if (!segment)
+        return;
+
+    segment->aborted.store(1, std::memory_order_release);
+    futexWakeAll(segment->generation);
+}
+
+void ShardCoordinator::printSummary() const
+{
+    const ShardMassState *states = segment->slot(settings.frames);
+    glm::vec3 lower(std::numeric_limits<float>::max());
+    glm::vec3 upper(std::numeric_limits<float>::lowest());
+    int invalid = 0;
+
+    for (int i = 0; i < segment->pointCount; i++)
+    {
+        const glm::vec3 &position = states[i].position;
+        if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z))
+        {
+            invalid++;
+            continue;
+        }
+        lower = glm::min(lower, position);
+        upper = glm::max(upper, position);
+    }
+
+    std::cout << "Cloth bounds: (" << lower.x << ", " << lower.y << ", " << lower.z << ") - (" << upper.x << ", "
+              << upper.y << ", " << upper.z << ")\n";
+    if (invalid > 0)
+        std::cout << "Invalid positions: " << invalid << "\n";
+}
+
+int ShardCoordinator::runShard(int shard)
+{
+    ShardSegment &shared = *segment;
+    ShardStatus &status = shared.status[shard];
+
+    // The child starts with only the forking thread, the scheduler is created here
+    TaskScheduler::instance().setThreadCount(settings.threadsPerShard);
+
+    const int resX = settings.resX;
+    const int resY = settings.resY;
+    const int firstRow = shard * resY / settings.shardCount;
+    const int lastRow = (shard + 1) * resY / settings.shardCount;
+
+    Cloth cloth(settings.width, settings.height, resX, resY, settings.floorY, true);
+    cloth.setTiledSolver(settings.tiledSolver);
+    cloth.keepRows(firstRow, lastRow, HALO_ROWS);
+
+    // (grid point, mass) pairs read from and written to the slots
+    std::vector<std::pair<int, int>> halo;
+    std::vector<std::pair<int, int>> boundary;
+    std::vector<std::pair<int, int>> owned;
+    for (int y = std::max(firstRow - HALO_ROWS, 0); y < std::min(lastRow + HALO_ROWS, resY); y++)
+    {
+        for (int x = 0; x < resX; x++)
+        {
+            int mass = cloth.getGridMassIndex(x, y);
+            if (mass < 0)
+                continue;
+
+            if (y < firstRow || y >= lastRow)
+            {
+                halo.emplace_back(y * resX + x, mass);
+                continue;
+            }
+
+            owned.emplace_back(y * resX + x, mass);
+            if ((firstRow > 0 && y < firstRow + HALO_ROWS) || (lastRow < resY && y >= lastRow - HALO_ROWS))
+                boundary.emplace_back(y * resX + x, mass);
+        }
+    }
+
+    auto publish = [&](const std::vector<std::pair<int, int>> &points, int frame) {
+        ShardMassState *states = shared.slot(frame);
+        for (const auto &[point, mass] : points)
+        {
+            const Mass &source = cloth.getMass(mass);
+            states[point] = {source.position, source.prevPosition};
+        }
+    };
+
+    publish(boundary, 0);
+    if (!frameBarrier(shared))
+        return 1;
+
+    for (int frame = 0; frame < settings.frames; frame++)
+    {
+        const ShardMassState *states = shared.slot(frame);
+        for (const auto &[point, mass] : halo)
+        {
+            Mass &target = cloth.getMass(mass);
+            target.position = states[point].position;
+            target.prevPosition = states[point].prevPosition;
+        }
+
+        cloth.update(settings.timeStep);
+
+        publish(boundary, frame + 1);
+        status.frame.store(frame + 1, std::memory_order_relaxed);
+
+        if (!frameBarrier(shared))
+            return 1;
+    }
+
+    // Whole strip for the coordinator, nobody reads the slots any more
+    publish(owned, settings.frames);
+    return 0;
+}
+
+#else
+
+ShardCoordinator::ShardCoordinator(const ShardSettings &settings) : settings(settings)
+{
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+}
+
+int ShardCoordinator::run()
+{
+    std::cerr << "Sharded runs need Linux shared memory and futexes\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,415 @@
+#include "StructuredGrid.hpp"
+#include "Cloth.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace
+{
+// Coordinates of the first or second endpoints of a run of edges
+struct RunEnds
+{
+    float *__restrict x;
+    float *__restrict y;
+    float *__restrict z;
+    const float *__restrict weight;
+};
+
+// Edge k of the run joins element k * Stride of a and of b. No two edges of a run share a mass, so the loop
+// carries no dependency and the endpoint arrays never overlap. Same projection as projectSpring, fixed masses
+// have zero weight.
+template <int Stride, bool Measure>
+void projectRun(RunEnds a, RunEnds b, int count, float restLength, float relax, float maxLength,
+                SolverResidual *residualOut)
+{
+    float maxViolation = 0.0f;
+    float sumSquares = 0.0f;
+
+    for (int k = 0; k < count; k++)
+    {
+        const int i = k * Stride;
+        float dx = b.x[i] - a.x[i];
+        float dy = b.y[i] - a.y[i];
+        float dz = b.z[i] - a.z[i];
+        float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+        // Both sides are computed and selected, so the loop has no branches
+        float clamped = (length - maxLength) * 0.5f;
+        float relaxed = (length - restLength) * relax;
+        float amount = length > maxLength ? clamped : relaxed;
+        float scale = amount / std::max(length, 0.0001f);
+        scale = length < 0.0001f ? 0.0f : scale;
+        float scaleA = scale * a.weight[i];
+        float scaleB = scale * b.weight[i];
+
+        a.x[i] += dx * scaleA;
+        a.y[i] += dy * scaleA;
+        a.z[i] += dz * scaleA;
+        b.x[i] -= dx * scaleB;
+        b.y[i] -= dy * scaleB;
+        b.z[i] -= dz * scaleB;
+
+        if constexpr (Measure)
+        {
+            float violation = std::abs(length / restLength - 1.0f);
+            maxViolation = std::max(maxViolation, violation);
+            sumSquares += violation * violation;
+        }
+    }
+
+    if constexpr (Measure)
+    {
+        SolverResidual runResidual;
+        runResidual.maxViolation = maxViolation;
+        runResidual.sumSquares = sumSquares;
+        runResidual.count = count;
+        residualOut->merge(runResidual);
+    }
+}
+} // namespace
+
+void StructuredGrid::clear()
+{
+    resX = 0;
+    resY = 0;
+    totalEdges = 0;
+    brokenEdges = 0;
+    brokenBits.clear();
+}
+
+void StructuredGrid::build(int newResX, int newResY, const std::vector<Spring> &springs, bool skipSprings)
+{
+    resX = newResX;
+    resY = newResY;
+
+    // columns, rows, start offset, mass offset
+    const int bendingRows = skipSprings ? 1 : 0;
+    const int layout[STENCIL_COUNT][4] = {
+        {resX - 1, resY, 0, 1},
+        {resX, resY - 1, 0, resX},
+        {resX - 1, resY - 1, 0, resX + 1},
+        {resX - 1, resY - 1, 1, resX - 1},
+        {resX - 2, resY * bendingRows, 0, 2},
+        {resX, (resY - 2) * bendingRows, 0, 2 * resX},
+    };
+
+    int firstEdge = 0;
+    for (int s = 0; s < STENCIL_COUNT; s++)
+    {
+        Block &block = blocks[s];
+        block.columns = std::max(layout[s][0], 0);
+        block.rows = std::max(layout[s][1], 0);
+        block.startOffset = layout[s][2];
+        block.offset = layout[s][3];
+
+        if (s == ANTI_DIAGONAL)
+        {
+            // Shares the id range of the diagonal block
+            block.firstEdge = blocks[DIAGONAL].firstEdge;
+            continue;
+        }
+
+        block.firstEdge = firstEdge;
+        int count = block.columns * block.rows;
+        firstEdge += (s == DIAGONAL) ? count * 2 : count;
+    }
+
+    totalEdges = firstEdge;
+    brokenEdges = 0;
+    brokenBits.assign((totalEdges + 63) / 64, 0);
+
+    // The grid is uniform, one rest length per stencil
+    for (int s = 0; s < STENCIL_COUNT; s++)
+    {
+        Block &block = blocks[s];
+        if (block.columns * block.rows == 0)
+            continue;
+
+        const Spring &first = springs[edgeId(s, 0, 0)];
+        block.restLength = first.restLength;
+        block.material = first.material;
+    }
+}
+
+int StructuredGrid::stencilOf(int edge) const
+{
+    int stencil = DOWN_2;
+    while (stencil > RIGHT && (stencil == ANTI_DIAGONAL || edge < blocks[stencil].firstEdge))
+        stencil--;
+
+    // Odd ids of the shear range are anti-diagonals
+    if (stencil == DIAGONAL)
+        stencil += (edge - blocks[DIAGONAL].firstEdge) & 1;
+    return stencil;
+}
+
+void StructuredGrid::endpoints(int edge, int &a, int &b) const
+{
+    int stencil = stencilOf(edge);
+    const Block &block = blocks[stencil];
+
+    int local = edge - block.firstEdge;
+    if (stencil == DIAGONAL || stencil == ANTI_DIAGONAL)
+        local >>= 1;
+
+    int x = local % block.columns;
+    int y = local / block.columns;
+
+    a = y * resX + x + block.startOffset;
+    b = a + block.offset;
+}
+
+int StructuredGrid::edgeBetween(int a, int b) const
+{
+    if (a > b)
+        std::swap(a, b);
+
+    int ax = a % resX, ay = a / resX;
+    int bx = b % resX, by = b / resX;
+    int dx = bx - ax, dy = by - ay;
+
+    if (dy == 0 && dx == 1)
+        return edgeId(RIGHT, ax, ay);
+    if (dy == 1 && dx == 0)
+        return edgeId(DOWN, ax, ay);
+    if (dy == 1 && dx == 1)
+        return edgeId(DIAGONAL, ax, ay);
+    if (dy == 1 && dx == -1)
+        return edgeId(ANTI_DIAGONAL, bx, ay);
+    if (dy == 0 && dx == 2 && ay < blocks[RIGHT_2].rows)
+        return edgeId(RIGHT_2, ax, ay);
+    if (dy == 2 && dx == 0 && ay < blocks[DOWN_2].rows)
+        return edgeId(DOWN_2, ax, ay);
+    return -1;
+}
+
+float StructuredGrid::restLength(int edge) const
+{
+    return blocks[stencilOf(edge)].restLength;
+}
+
+void StructuredGrid::breakEdge(int edge)
+{
+    if (isBroken(edge))
+        return;
+
+    brokenBits[edge >> 6] |= uint64_t(1) << (edge & 63);
+    brokenEdges++;
+}
+
+template <typename Kernel>
+void StructuredGrid::sweep(std::vector<Mass> &masses, Kernel &&kernel, unsigned stencils) const
+{
+    // Same order as the explicit spring list, so both storage modes give the same result
+    for (int s = 0; s < STENCIL_COUNT; s++)
+    {
+        if (s == ANTI_DIAGONAL || !((stencils >> s) & 1u))
+            continue;
+
+        // Locals, stores into masses could otherwise alias the block fields
+        const bool shear = (s == DIAGONAL);
+        const int columns = blocks[s].columns;
+        const int offset = blocks[s].offset;
+        const float restLength = blocks[s].restLength;
+        const int material = blocks[s].material;
+        const int secondStart = blocks[ANTI_DIAGONAL].startOffset;
+        const int secondOffset = blocks[ANTI_DIAGONAL].offset;
+        const float secondRest = blocks[ANTI_DIAGONAL].restLength;
+        const int secondMaterial = blocks[ANTI_DIAGONAL].material;
+        const int step = shear ? 2 : 1;
+        const uint64_t *bits = brokenBits.data();
+        auto broken = [bits](int edge) { return (bits[edge >> 6] >> (edge & 63)) & 1u; };
+
+        for (int y = 0; y < blocks[s].rows; y++)
+        {
+            // Both endpoints walk their rows with unit stride, no index loads
+            Mass *row = masses.data() + y * resX + blocks[s].startOffset;
+            int edge = edgeId(s, 0, y);
+
+            for (int x = 0; x < columns; x++, edge += step)
+            {
+                if (!broken(edge))
+                    kernel(edge, row[x], row[x + offset], restLength, material);
+
+                if (shear && !broken(edge + 1))
+                    kernel(edge + 1, row[x + secondStart], row[x + secondStart + secondOffset], secondRest,
+                           secondMaterial);
+            }
+        }
+    }
+}
+
+void StructuredGrid::applyForces(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                                 bool pinned) const
+{
+    if (pinned)
+    {
+        sweep(masses, [&](int, Mass &massA, Mass &massB, float restLength, int material) {
+            applySpringForce<true>(massA, massB, restLength, materials[material]);
+        });
+    }
+    else
+    {
+        sweep(masses, [&](int, Mass &massA, Mass &massB, float restLength, int material) {
+            applySpringForce<false>(massA, massB, restLength, materials[material]);
+        });
+    }
+}
+
+void StructuredGrid::solveIteration(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                                    const SolverPass &pass, float maxStretchRatio, bool pinned,
+                                    SolverResidual *residualOut) const
+{
+    // Runs assume every edge is intact, a torn grid is converted to springs before the next step anyway
+    if (rowPasses && brokenEdges == 0)
+    {
+        if (pinned)
+            solveRows<true>(masses, materials, pass, maxStretchRatio, residualOut);
+        else
+            solveRows<false>(masses, materials, pass, maxStretchRatio, residualOut);
+        return;
+    }
+
+    if (pinned)
+        solve<true>(masses, materials, pass, maxStretchRatio, residualOut);
+    else
+        solve<false>(masses, materials, pass, maxStretchRatio, residualOut);
+}
+
+template <bool Pinned>
+void StructuredGrid::solve(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                           const SolverPass &pass, float maxStretchRatio, SolverResidual *residualOut) const
+{
+    unsigned stencils = 0;
+    for (int s = 0; s < STENCIL_COUNT; s++)
+    {
+        if (pass.includes(materials[blocks[s].material].family))
+            stencils |= 1u << s;
+    }
+
+    // Measure: std::bool_constant, resolved before the sweep
+    auto project = [&](auto measure) {
+        sweep(
+            masses,
+            [&](int, Mass &massA, Mass &massB, float restLength, int material) {
+                const SpringMaterial &spring = materials[material];
+                float length = projectSpring<Pinned>(massA, massB, restLength, spring.stiffness,
+                                                     pass.correction[static_cast<int>(spring.family)],
+                                                     maxStretchRatio);
+                if constexpr (decltype(measure)::value)
+                    residualOut->add(length / restLength);
+            },
+            stencils);
+    };
+
+    if (residualOut)
+        project(std::true_type());
+    else
+        project(std::false_type());
+}
+
+template <bool Pinned>
+void StructuredGrid::solveRows(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                               const SolverPass &pass, float maxStretchRatio, SolverResidual *residualOut) const
+{
+    const int count = static_cast<int>(masses.size());
+    rowX.resize(count);
+    rowY.resize(count);
+    rowZ.resize(count);
+    rowWeight.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        rowX[i] = masses[i].position.x;
+        rowY[i] = masses[i].position.y;
+        rowZ[i] = masses[i].position.z;
+        rowWeight[i] = (Pinned && masses[i].fixed) ? 0.0f : 1.0f;
+    }
+
+    for (int s = 0; s < STENCIL_COUNT; s++)
+    {
+        const Block &block = blocks[s];
+        const SpringMaterial &spring = materials[block.material];
+        const int family = static_cast<int>(spring.family);
+        if (!pass.includes(spring.family) || block.columns * block.rows == 0)
+            continue;
+
+        const float relax = 0.5f * (pass.correction[family] * (spring.stiffness / 100.0f));
+        const float maxLength = block.restLength * maxStretchRatio;
+        // Stride: std::integral_constant, edges of the run are that many masses apart
+        auto project = [&](auto stride, int first, int edges, int offset) {
+            RunEnds a{rowX.data() + first, rowY.data() + first, rowZ.data() + first, rowWeight.data() + first};
+            RunEnds b{a.x + offset, a.y + offset, a.z + offset, a.weight + offset};
+            if (residualOut)
+                projectRun<decltype(stride)::value, true>(a, b, edges, block.restLength, relax, maxLength,
+                                                          residualOut);
+            else
+                projectRun<decltype(stride)::value, false>(a, b, edges, block.restLength, relax, maxLength,
+                                                           nullptr);
+        };
+
+        for (int y = 0; y < block.rows; y++)
+        {
+            const int first = y * resX + block.startOffset;
+            if (s == RIGHT)
+            {
+                // Neighbours share a mass, even and odd edges take turns
+                project(std::integral_constant<int, 2>(), first, (block.columns + 1) / 2, 1);
+                project(std::integral_constant<int, 2>(), first + 1, block.columns / 2, 1);
+            }
+            else if (s == RIGHT_2)
+            {
+                // Edges x and x + 2 share a mass, four runs of every fourth edge
+                for (int phase = 0; phase < 4; phase++)
+                    project(std::integral_constant<int, 4>(), first + phase, (block.columns - phase + 3) / 4, 2);
+            }
+            else
+            {
+                // Both endpoints walk a whole row with unit stride
+                project(std::integral_constant<int, 1>(), first, block.columns, block.offset);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+        masses[i].position = glm::vec3(rowX[i], rowY[i], rowZ[i]);
+}
+
+void StructuredGrid::toSprings(std::vector<Spring> &springs) const
+{
+    springs.clear();
+    springs.reserve(totalEdges);
+
+    for (int edge = 0; edge < totalEdges; ++edge)
+    {
+        int a, b;
+        endpoints(edge, a, b);
+        springs.emplace_back(a, b, restLength(edge), blocks[stencilOf(edge)].material);
+    }
+}
+
+void StructuredGrid::springsAround(int mass, std::vector<Spring> &springs) const
+{
+    static const int offsets[12][2] = {{1, 0},  {-1, 0}, {0, 1},  {0, -1}, {1, 1},  {-1, -1},
+                                       {-1, 1}, {1, -1}, {2, 0},  {-2, 0}, {0, 2},  {0, -2}};
+
+    int x = mass % resX;
+    int y = mass / resX;
+
+    for (const auto &offset : offsets)
+    {
+        int nx = x + offset[0];
+        int ny = y + offset[1];
+        if (nx < 0 || nx >= resX || ny < 0 || ny >= resY)
+            continue;
+
+        int other = ny * resX + nx;
+        int edge = edgeBetween(mass, other);
+        if (edge < 0 || isBroken(edge))
+            continue;
+
+        int a, b;
+        endpoints(edge, a, b);
+        springs.emplace_back(a, b, restLength(edge), blocks[stencilOf(edge)].material);
+    }
+}
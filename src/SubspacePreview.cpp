@@ -0,0 +1,434 @@
+#include "SubspacePreview.hpp"
+#include "Cloth.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+const int RECONSTRUCT_GRAIN = 1024;
+const int JACOBI_SWEEPS = 50;
+
+// Eigen decomposition of a symmetric matrix by cyclic Jacobi rotations, row major, size n
+// Eigenvalues end up on the diagonal, eigenvectors in the columns of vectors
+void jacobiEigen(std::vector<double> &matrix, std::vector<double> &vectors, int n)
+{
+    vectors.assign(n * n, 0.0);
+    for (int i = 0; i < n; i++)
+        vectors[i * n + i] = 1.0;
+
+    for (int sweep = 0; sweep < JACOBI_SWEEPS; sweep++)
+    {
+        double off = 0.0;
+        double diagonal = 0.0;
+        for (int i = 0; i < n; i++)
+        {
+            diagonal += matrix[i * n + i] * matrix[i * n + i];
+            for (int j = i + 1; j < n; j++)
+                off += matrix[i * n + j] * matrix[i * n + j];
+        }
+        if (off <= 1e-22 * diagonal)
+            return;
+
+        for (int p = 0; p < n; p++)
+        {
+            for (int q = p + 1; q < n; q++)
+            {
+                double apq = matrix[p * n + q];
+                if (std::abs(apq) < 1e-300)
+                    continue;
+
+                double theta = (matrix[q * n + q] - matrix[p * n + p]) / (2.0 * apq);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0);
+                double s = t * c;
+
+                for (int k = 0; k < n; k++)
+                {
+                    double akp = matrix[k * n + p];
+                    double akq = matrix[k * n + q];
+                    matrix[k * n + p] = c * akp - s * akq;
+                    matrix[k * n + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; k++)
+                {
+                    double apk = matrix[p * n + k];
+                    double aqk = matrix[q * n + k];
+                    matrix[p * n + k] = c * apk - s * aqk;
+                    matrix[q * n + k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; k++)
+                {
+                    double vkp = vectors[k * n + p];
+                    double vkq = vectors[k * n + q];
+                    vectors[k * n + p] = c * vkp - s * vkq;
+                    vectors[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+// Solve the symmetric positive definite system matrix * x = rhs for columns right hand sides, in place
+bool choleskySolve(std::vector<double> &matrix, std::vector<double> &rhs, int n, int columns)
+{
+    for (int j = 0; j < n; j++)
+    {
+        double sum = matrix[j * n + j];
+        for (int k = 0; k < j; k++)
+            sum -= matrix[j * n + k] * matrix[j * n + k];
+        if (sum <= 0.0)
+            return false;
+        matrix[j * n + j] = std::sqrt(sum);
+
+        for (int i = j + 1; i < n; i++)
+        {
+            double value = matrix[i * n + j];
+            for (int k = 0; k < j; k++)
+                value -= matrix[i * n + k] * matrix[j * n + k];
+            matrix[i * n + j] = value / matrix[j * n + j];
+        }
+    }
+
+    for (int column = 0; column < columns; column++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            double value = rhs[i * columns + column];
+            for (int k = 0; k < i; k++)
+                value -= matrix[i * n + k] * rhs[k * columns + column];
+            rhs[i * columns + column] = value / matrix[i * n + i];
+        }
+        for (int i = n - 1; i >= 0; i--)
+        {
+            double value = rhs[i * columns + column];
+            for (int k = i + 1; k < n; k++)
+                value -= matrix[k * n + i] * rhs[k * columns + column];
+            rhs[i * columns + column] = value / matrix[i * n + i];
+        }
+    }
+    return true;
+}
+} // namespace
+
+void SubspacePreview::clear()
+{
+    training = false;
+    recorded = 0;
+    modeCount = 0;
+    snapshots.clear();
+    snapshots.shrink_to_fit();
+    accelerations.clear();
+    stepSizes.clear();
+    mean.clear();
+    basis.clear();
+    basis.shrink_to_fit();
+}
+
+void SubspacePreview::startTraining(const std::vector<Mass> &masses, int topology, int pins,
+                                    const PreviewParams &newParams)
+{
+    clear();
+    params = newParams;
+    training = true;
+    trainedTopology = topology;
+    trainedPins = pins;
+    trainedMassCount = static_cast<int>(masses.size());
+    snapshots.reserve(static_cast<size_t>(params.trainingFrames) * masses.size() * 3);
+}
+
+bool SubspacePreview::record(const std::vector<Mass> &masses, const glm::vec3 &acceleration, float dt,
+                             TaskScheduler &scheduler)
+{
+    if (!training)
+        return false;
+
+    // Anything that renumbered the masses makes the recording useless
+    if (masses.size() != trainedMassCount)
+    {
+        clear();
+        return false;
+    }
+
+    for (const Mass &mass : masses)
+    {
+        snapshots.push_back(mass.position.x);
+        snapshots.push_back(mass.position.y);
+        snapshots.push_back(mass.position.z);
+    }
+    accelerations.push_back(acceleration);
+    stepSizes.push_back(dt);
+    recorded++;
+
+    if (recorded < params.trainingFrames)
+        return false;
+
+    training = false;
+    build(scheduler);
+    snapshots.clear();
+    snapshots.shrink_to_fit();
+    accelerations.clear();
+    stepSizes.clear();
+    return ready();
+}
+
+void SubspacePreview::build(TaskScheduler &scheduler)
+{
+    const int frames = recorded;
+    const size_t size = static_cast<size_t>(trainedMassCount) * 3;
+    modeCount = 0;
+    if (frames < 4)
+        return;
+
+    // Mean shape, the snapshots are centered in place
+    mean.assign(size, 0.0f);
+    for (int s = 0; s < frames; s++)
+    {
+        const float *snapshot = &snapshots[s * size];
+        for (size_t c = 0; c < size; c++)
+            mean[c] += snapshot[c];
+    }
+    for (float &value : mean)
+        value /= frames;
+    scheduler.parallelFor(0, frames, 1, [&](int begin, int end) {
+        for (int s = begin; s < end; s++)
+        {
+            float *snapshot = &snapshots[s * size];
+            for (size_t c = 0; c < size; c++)
+                snapshot[c] -= mean[c];
+        }
+    });
+
+    // Snapshot method, the eigenvectors of the small Gram matrix give the modes
+    std::vector<double> gram(frames * frames);
+    scheduler.parallelFor(0, frames, 1, [&](int begin, int end) {
+        for (int s = begin; s < end; s++)
+        {
+            for (int t = 0; t <= s; t++)
+            {
+                const float *a = &snapshots[s * size];
+                const float *b = &snapshots[t * size];
+                double dot = 0.0;
+                for (size_t c = 0; c < size; c++)
+                    dot += a[c] * b[c];
+                gram[s * frames + t] = dot;
+                gram[t * frames + s] = dot;
+            }
+        }
+    });
+
+    std::vector<double> vectors;
+    jacobiEigen(gram, vectors, frames);
+
+    std::vector<int> order(frames);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&](int lhs, int rhs) { return gram[lhs * frames + lhs] > gram[rhs * frames + rhs]; });
+
+    double total = 0.0;
+    for (int s = 0; s < frames; s++)
+        total += std::max(gram[s * frames + s], 0.0);
+    if (total <= 0.0)
+        return;
+
+    // A still cloth has no variance to learn from, modes below the noise floor are dropped as well
+    double kept = 0.0;
+    const double largest = gram[order[0] * frames + order[0]];
+    for (int m = 0; m < std::min(params.maxModes, frames); m++)
+    {
+        double eigenvalue = gram[order[m] * frames + order[m]];
+        if (eigenvalue <= largest * 1e-10)
+            break;
+        kept += eigenvalue;
+        modeCount++;
+        if (kept >= params.energy * total)
+            break;
+    }
+    explainedVariance = static_cast<float>(kept / total);
+    const int k = modeCount;
+
+    // Modes and the modal coordinates of every snapshot
+    basis.assign(k * size, 0.0f);
+    std::vector<float> history(frames * k);
+    for (int m = 0; m < k; m++)
+    {
+        int e = order[m];
+        double root = std::sqrt(gram[e * frames + e]);
+        for (int s = 0; s < frames; s++)
+            history[s * k + m] = static_cast<float>(root * vectors[s * frames + e]);
+    }
+    scheduler.parallelFor(0, k, 1, [&](int begin, int end) {
+        for (int m = begin; m < end; m++)
+        {
+            int e = order[m];
+            double root = std::sqrt(gram[e * frames + e]);
+            float *mode = &basis[m * size];
+            for (int s = 0; s < frames; s++)
+            {
+                float weight = static_cast<float>(vectors[s * frames + e] / root);
+                const float *snapshot = &snapshots[s * size];
+                for (size_t c = 0; c < size; c++)
+                    mode[c] += weight * snapshot[c];
+            }
+        }
+    });
+
+    // Pinned masses never move, so their entries are zero and a uniform acceleration projects like this
+    forceResponse.assign(k, glm::vec3(0.0f));
+    for (int m = 0; m < k; m++)
+    {
+        const float *mode = &basis[m * size];
+        for (size_t c = 0; c < size; c += 3)
+            forceResponse[m] += glm::vec3(mode[c], mode[c + 1], mode[c + 2]);
+    }
+
+    // Least squares fit of the internal dynamics, the known response to the external forces is removed first
+    const int unknowns = 2 * k + 1;
+    std::vector<double> normal(unknowns * unknowns, 0.0);
+    std::vector<double> rhs(unknowns * k, 0.0);
+    std::vector<double> regressor(unknowns);
+    for (int s = 2; s < frames; s++)
+    {
+        const float *current = &history[(s - 1) * k];
+        const float *previous = &history[(s - 2) * k];
+        for (int m = 0; m < k; m++)
+        {
+            regressor[m] = current[m];
+            regressor[k + m] = current[m] - previous[m];
+        }
+        regressor[2 * k] = 1.0;
+
+        float dt2 = stepSizes[s] * stepSizes[s];
+        for (int i = 0; i < unknowns; i++)
+        {
+            for (int j = 0; j < unknowns; j++)
+                normal[i * unknowns + j] += regressor[i] * regressor[j];
+            for (int m = 0; m < k; m++)
+            {
+                double target = history[s * k + m] - current[m] - dt2 * glm::dot(forceResponse[m], accelerations[s]);
+                rhs[i * k + m] += regressor[i] * target;
+            }
+        }
+    }
+
+    double trace = 0.0;
+    for (int i = 0; i < unknowns; i++)
+        trace += normal[i * unknowns + i];
+    double ridge = params.ridge * trace / unknowns + 1e-12;
+    for (int i = 0; i < unknowns; i++)
+        normal[i * unknowns + i] += ridge;
+
+    if (!choleskySolve(normal, rhs, unknowns, k))
+    {
+        modeCount = 0;
+        return;
+    }
+
+    stiffness.assign(k * k, 0.0f);
+    damping.assign(k * k, 0.0f);
+    offset.assign(k, 0.0f);
+    for (int m = 0; m < k; m++)
+    {
+        for (int j = 0; j < k; j++)
+        {
+            stiffness[m * k + j] = static_cast<float>(rhs[j * k + m]);
+            damping[m * k + j] = static_cast<float>(rhs[(k + j) * k + m]);
+        }
+        offset[m] = static_cast<float>(rhs[2 * k * k + m]);
+    }
+
+    lower.assign(k, 0.0f);
+    upper.assign(k, 0.0f);
+    for (int m = 0; m < k; m++)
+    {
+        float low = history[m];
+        float high = history[m];
+        for (int s = 1; s < frames; s++)
+        {
+            low = std::min(low, history[s * k + m]);
+            high = std::max(high, history[s * k + m]);
+        }
+        float widen = (high - low) * params.margin;
+        lower[m] = low - widen;
+        upper[m] = high + widen;
+    }
+
+    trainingDt = std::accumulate(stepSizes.begin(), stepSizes.end(), 0.0f) / frames;
+}
+
+void SubspacePreview::project(const std::vector<Mass> &masses, bool previous, std::vector<float> &out) const
+{
+    const size_t size = static_cast<size_t>(trainedMassCount) * 3;
+    out.assign(modeCount, 0.0f);
+    for (int m = 0; m < modeCount; m++)
+    {
+        const float *mode = &basis[m * size];
+        double sum = 0.0;
+        for (int i = 0; i < trainedMassCount; i++)
+        {
+            const glm::vec3 &position = previous ? masses[i].prevPosition : masses[i].position;
+            sum += mode[3 * i] * (position.x - mean[3 * i]) + mode[3 * i + 1] * (position.y - mean[3 * i + 1]) +
+                   mode[3 * i + 2] * (position.z - mean[3 * i + 2]);
+        }
+        out[m] = static_cast<float>(sum);
+    }
+}
+
+void SubspacePreview::begin(const std::vector<Mass> &masses)
+{
+    project(masses, false, coordinates);
+    project(masses, true, previousCoordinates);
+}
+
+void SubspacePreview::step(const glm::vec3 &acceleration)
+{
+    const int k = modeCount;
+    const float dt2 = trainingDt * trainingDt;
+    nextCoordinates.resize(k);
+    for (int m = 0; m < k; m++)
+    {
+        float value = coordinates[m] + offset[m] + dt2 * glm::dot(forceResponse[m], acceleration);
+        for (int j = 0; j < k; j++)
+            value += stiffness[m * k + j] * coordinates[j] +
+                     damping[m * k + j] * (coordinates[j] - previousCoordinates[j]);
+
+        // The fit only holds near the shapes it saw
+        nextCoordinates[m] = std::clamp(value, lower[m], upper[m]);
+    }
+    previousCoordinates.swap(coordinates);
+    coordinates.swap(nextCoordinates);
+}
+
+void SubspacePreview::reconstruct(std::vector<Mass> &masses, TaskScheduler &scheduler) const
+{
+    const size_t size = static_cast<size_t>(trainedMassCount) * 3;
+
+    // Mean plus the weighted modes, block by block so the accumulation stays in cache and vectorizes
+    scheduler.parallelFor(0, trainedMassCount, RECONSTRUCT_GRAIN, [&](int begin, int end) {
+        float block[RECONSTRUCT_GRAIN * 3];
+        const size_t first = static_cast<size_t>(begin) * 3;
+        const int count = (end - begin) * 3;
+
+        std::copy(mean.begin() + first, mean.begin() + first + count, block);
+        for (int m = 0; m < modeCount; m++)
+        {
+            const float weight = coordinates[m];
+            const float *mode = &basis[m * size + first];
+            for (int c = 0; c < count; c++)
+                block[c] += weight * mode[c];
+        }
+
+        for (int i = begin; i < end; i++)
+        {
+            Mass &mass = masses[i];
+            if (mass.fixed)
+                continue;
+
+            const float *position = &block[(i - begin) * 3];
+            mass.prevPosition = mass.position;
+            mass.position = glm::vec3(position[0], position[1], position[2]);
+        }
+    });
+}
@@ -0,0 +1,197 @@
+#include "SurfaceSubdivision.hpp"
+#include "Cloth.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const int PATCH_GRAIN = 256;
+const int MAX_PATCH_VERTICES = (SurfaceSubdivision::MAX_SEGMENTS + 1) * (SurfaceSubdivision::MAX_SEGMENTS + 2) / 2;
+
+// Vertex i steps toward the second corner and j toward the third one, rows of constant j are stored in order
+int patchIndex(int i, int j, int segments)
+{
+    return j * (segments + 1) - j * (j - 1) / 2 + i;
+}
+
+// Edge control point near from, the corner projected onto its own tangent plane
+glm::vec3 edgePoint(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &normal)
+{
+    return (2.0f * from + to - glm::dot(to - from, normal) * normal) / 3.0f;
+}
+
+// Edge normal, the average of the corner normals mirrored across the plane normal to the edge
+glm::vec3 edgeNormal(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &normalFrom,
+                     const glm::vec3 &normalTo)
+{
+    glm::vec3 edge = to - from;
+    float lengthSquared = glm::dot(edge, edge);
+    glm::vec3 sum = normalFrom + normalTo;
+    if (lengthSquared > 1e-12f)
+        sum -= (2.0f * glm::dot(edge, sum) / lengthSquared) * edge;
+    float length = glm::length(sum);
+    return length > 1e-6f ? sum / length : normalFrom;
+}
+} // namespace
+
+void SurfaceSubdivision::clear()
+{
+    segments = 0;
+    patchVertices = 0;
+    indices.clear();
+    positionWeights.clear();
+    normalWeights.clear();
+    towardB.clear();
+    towardC.clear();
+}
+
+void SurfaceSubdivision::build(int triangleCount, int newSegments)
+{
+    clear();
+    segments = std::clamp(newSegments, 1, MAX_SEGMENTS);
+    patchVertices = (segments + 1) * (segments + 2) / 2;
+
+    positionWeights.resize(CUBIC_POINTS * patchVertices);
+    normalWeights.resize(QUADRATIC_POINTS * patchVertices);
+    towardB.resize(patchVertices);
+    towardC.resize(patchVertices);
+    for (int j = 0; j <= segments; j++)
+    {
+        for (int i = 0; i + j <= segments; i++)
+        {
+            int v = patchIndex(i, j, segments);
+            float u = static_cast<float>(i) / segments;
+            float w = static_cast<float>(j) / segments;
+            float t = 1.0f - u - w;
+            towardB[v] = u;
+            towardC[v] = w;
+
+            // Corners, edge points from a to b, b to c, c to a, then the center
+            const float cubic[CUBIC_POINTS] = {t * t * t,        u * u * u,        w * w * w,
+                                               3.0f * t * t * u, 3.0f * t * u * u, 3.0f * u * u * w,
+                                               3.0f * u * w * w, 3.0f * t * w * w, 3.0f * t * t * w,
+                                               6.0f * t * u * w};
+            // Corners, then the middles of the edges a b, b c and c a
+            const float quadratic[QUADRATIC_POINTS] = {t * t, u * u, w * w, t * u, u * w, t * w};
+            for (int k = 0; k < CUBIC_POINTS; k++)
+                positionWeights[k * patchVertices + v] = cubic[k];
+            for (int k = 0; k < QUADRATIC_POINTS; k++)
+                normalWeights[k * patchVertices + v] = quadratic[k];
+        }
+    }
+
+    // Fine triangles keep the winding of the simulated triangle
+    std::vector<unsigned int> patch;
+    for (int j = 0; j < segments; j++)
+    {
+        for (int i = 0; i + j < segments; i++)
+        {
+            unsigned int a = patchIndex(i, j, segments);
+            unsigned int b = patchIndex(i + 1, j, segments);
+            unsigned int c = patchIndex(i, j + 1, segments);
+            patch.insert(patch.end(), {a, b, c});
+            if (i + j + 1 < segments)
+            {
+                unsigned int d = patchIndex(i + 1, j + 1, segments);
+                patch.insert(patch.end(), {b, d, c});
+            }
+        }
+    }
+
+    indices.resize(patch.size() * triangleCount);
+    for (int t = 0; t < triangleCount; t++)
+    {
+        unsigned int base = t * patchVertices;
+        unsigned int *out = &indices[t * patch.size()];
+        for (size_t k = 0; k < patch.size(); k++)
+            out[k] = base + patch[k];
+    }
+}
+
+void SurfaceSubdivision::evaluate(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                                  std::vector<float> &vertices, TaskScheduler &scheduler) const
+{
+    const int triangleCount = static_cast<int>(triangles.size() / 3);
+    vertices.resize(static_cast<size_t>(triangleCount) * patchVertices * 8);
+
+    scheduler.parallelFor(0, triangleCount, PATCH_GRAIN, [&](int begin, int end) {
+        float lanes[6][MAX_PATCH_VERTICES];
+        for (int t = begin; t < end; t++)
+        {
+            const Mass &a = masses[triangles[t * 3]];
+            const Mass &b = masses[triangles[t * 3 + 1]];
+            const Mass &c = masses[triangles[t * 3 + 2]];
+
+            glm::vec3 cubic[CUBIC_POINTS] = {a.position,
+                                             b.position,
+                                             c.position,
+                                             edgePoint(a.position, b.position, a.normal),
+                                             edgePoint(b.position, a.position, b.normal),
+                                             edgePoint(b.position, c.position, b.normal),
+                                             edgePoint(c.position, b.position, c.normal),
+                                             edgePoint(c.position, a.position, c.normal),
+                                             edgePoint(a.position, c.position, a.normal),
+                                             glm::vec3(0.0f)};
+            glm::vec3 edges = (cubic[3] + cubic[4] + cubic[5] + cubic[6] + cubic[7] + cubic[8]) / 6.0f;
+            glm::vec3 center = (a.position + b.position + c.position) / 3.0f;
+            cubic[9] = edges + (edges - center) * 0.5f;
+
+            glm::vec3 quadratic[QUADRATIC_POINTS] = {a.normal,
+                                                     b.normal,
+                                                     c.normal,
+                                                     edgeNormal(a.position, b.position, a.normal, b.normal),
+                                                     edgeNormal(b.position, c.position, b.normal, c.normal),
+                                                     edgeNormal(c.position, a.position, c.normal, a.normal)};
+
+            // Blend in lanes, one control point at a time into every vertex of the patch
+            for (int lane = 0; lane < 6; lane++)
+                std::fill(lanes[lane], lanes[lane] + patchVertices, 0.0f);
+            for (int k = 0; k < CUBIC_POINTS; k++)
+            {
+                const float *weight = &positionWeights[k * patchVertices];
+                const glm::vec3 point = cubic[k];
+                for (int v = 0; v < patchVertices; v++)
+                {
+                    lanes[0][v] += weight[v] * point.x;
+                    lanes[1][v] += weight[v] * point.y;
+                    lanes[2][v] += weight[v] * point.z;
+                }
+            }
+            for (int k = 0; k < QUADRATIC_POINTS; k++)
+            {
+                const float *weight = &normalWeights[k * patchVertices];
+                const glm::vec3 normal = quadratic[k];
+                for (int v = 0; v < patchVertices; v++)
+                {
+                    lanes[3][v] += weight[v] * normal.x;
+                    lanes[4][v] += weight[v] * normal.y;
+                    lanes[5][v] += weight[v] * normal.z;
+                }
+            }
+
+            glm::vec2 texA = a.texCoord;
+            glm::vec2 texB = b.texCoord - a.texCoord;
+            glm::vec2 texC = c.texCoord - a.texCoord;
+            float *out = &vertices[static_cast<size_t>(t) * patchVertices * 8];
+            for (int v = 0; v < patchVertices; v++, out += 8)
+            {
+                glm::vec3 normal(lanes[3][v], lanes[4][v], lanes[5][v]);
+                float length = glm::length(normal);
+                if (length > 1e-6f)
+                    normal /= length;
+                glm::vec2 tex = texA + texB * towardB[v] + texC * towardC[v];
+
+                out[0] = lanes[0][v];
+                out[1] = lanes[1][v];
+                out[2] = lanes[2][v];
+                out[3] = normal.x;
+                out[4] = normal.y;
+                out[5] = normal.z;
+                out[6] = tex.x;
+                out[7] = tex.y;
+            }
+        }
+    });
+}
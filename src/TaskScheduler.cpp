@@ -0,0 +1,258 @@
+#include "TaskScheduler.hpp"
+
+#include <new>
+
+namespace
+{
+// Queue owned by the current thread, threads outside the scheduler share queue 0
+thread_local int workerIndex = 0;
+thread_local const TaskScheduler *workerOwner = nullptr;
+} // namespace
+
+TaskScheduler &TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler(int threadCount)
+{
+    start(threadCount);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    stop();
+}
+
+void TaskScheduler::setThreadCount(int threadCount)
+{
+    stop();
+    start(threadCount);
+}
+
+void TaskScheduler::start(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    queues.clear();
+    for (int i = 0; i < threadCount; i++)
+        queues.push_back(std::make_unique<WorkQueue>());
+
+    stopping = false;
+    for (int i = 1; i < threadCount; i++)
+        workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+}
+
+void TaskScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for (auto &worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+int TaskScheduler::currentQueue() const
+{
+    return workerOwner == this ? workerIndex : 0;
+}
+
+void TaskScheduler::submit(TaskGroup &group, const Task &task)
+{
+    Task queuedTask = task;
+    queuedTask.group = &group;
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (deterministic || queues.size() == 1)
+    {
+        execute(queuedTask);
+        return;
+    }
+
+    queues[currentQueue()]->push(queuedTask);
+    queued.fetch_add(1, std::memory_order_release);
+
+    // Sleeping workers check the counter under the mutex, taking it here avoids a lost wake up
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeUp.notify_one();
+}
+
+void TaskScheduler::wait(TaskGroup &group)
+{
+    int index = currentQueue();
+    Task task;
+    while (!group.done())
+    {
+        if (findTask(index, task))
+            execute(task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void TaskScheduler::execute(const Task &task)
+{
+    task.run(task.context, task.begin, task.end);
+    task.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+bool TaskScheduler::findTask(int index, Task &task)
+{
+    if (queues[index]->popBack(task))
+    {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Steal the oldest task, it is usually the biggest piece of remaining work
+    int count = static_cast<int>(queues.size());
+    for (int offset = 1; offset < count; offset++)
+    {
+        if (queues[(index + offset) % count]->popFront(task))
+        {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::workerLoop(int index)
+{
+    workerIndex = index;
+    workerOwner = this;
+
+    Task task;
+    while (true)
+    {
+        if (findTask(index, task))
+        {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+void TaskScheduler::WorkQueue::push(const Task &task)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == tasks.size())
+    {
+        // Unroll the ring into a bigger buffer
+        std::vector<Task> grown(std::max<size_t>(64, tasks.size() * 2));
+        for (size_t i = 0; i < count; i++)
+            grown[i] = tasks[(head + i) % tasks.size()];
+        tasks.swap(grown);
+        head = 0;
+    }
+
+    tasks[(head + count) % tasks.size()] = task;
+    count++;
+}
+
+bool TaskScheduler::WorkQueue::popBack(Task &task)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+        return false;
+
+    count--;
+    task = tasks[(head + count) % tasks.size()];
+    return true;
+}
+
+bool TaskScheduler::WorkQueue::popFront(Task &task)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+        return false;
+
+    task = tasks[head];
+    head = (head + 1) % tasks.size();
+    count--;
+    return true;
+}
+
+TaskGraph::TaskGraph(std::pmr::memory_resource *memory)
+    : memory(memory), nodes(memory), edges(memory), firstEdge(memory)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    if (remaining)
+        memory->deallocate(remaining, remainingCount * sizeof(std::atomic<int>), alignof(std::atomic<int>));
+}
+
+void TaskGraph::precede(int before, int after)
+{
+    edges.emplace_back(before, after);
+    nodes[after].predecessors++;
+}
+
+void TaskGraph::run(TaskScheduler &runScheduler)
+{
+    scheduler = &runScheduler;
+
+    // Successor lists in compressed form
+    std::sort(edges.begin(), edges.end());
+    firstEdge.assign(nodes.size() + 1, 0);
+    for (const auto &edge : edges)
+        firstEdge[edge.first + 1]++;
+    for (size_t i = 0; i < nodes.size(); i++)
+        firstEdge[i + 1] += firstEdge[i];
+
+    if (remainingCount < nodes.size())
+    {
+        if (remaining)
+            memory->deallocate(remaining, remainingCount * sizeof(std::atomic<int>), alignof(std::atomic<int>));
+        remainingCount = nodes.size();
+        remaining = static_cast<std::atomic<int> *>(
+            memory->allocate(remainingCount * sizeof(std::atomic<int>), alignof(std::atomic<int>)));
+    }
+    for (size_t i = 0; i < nodes.size(); i++)
+        new (&remaining[i]) std::atomic<int>(nodes[i].predecessors);
+
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].predecessors == 0)
+            release(i);
+    }
+    scheduler->wait(group);
+}
+
+void TaskGraph::release(int node)
+{
+    Task task;
+    task.run = &TaskGraph::runNode;
+    task.context = this;
+    task.begin = node;
+    task.end = node + 1;
+    scheduler->submit(group, task);
+}
+
+void TaskGraph::runNode(void *context, int node, int)
+{
+    TaskGraph &graph = *static_cast<TaskGraph *>(context);
+    graph.nodes[node].run(graph.nodes[node].context, 0, 0);
+
+    for (int e = graph.firstEdge[node]; e < graph.firstEdge[node + 1]; e++)
+    {
+        int successor = graph.edges[e].second;
+        if (graph.remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            graph.release(successor);
+    }
+}
@@ -0,0 +1,140 @@
+#include "Tether.hpp"
+#include "Cloth.hpp"
+#include "StructuredGrid.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace
+{
+const int TETHER_GRAIN = 2048;
+} // namespace
+
+void TetherSystem::clear()
+{
+    tethers.clear();
+    unanchored = 0;
+}
+
+void TetherSystem::build(const std::vector<Mass> &masses, const std::vector<Spring> &springs)
+{
+    buildFrom(masses, [&](auto &&emit) {
+        for (int i = 0; i < springs.size(); ++i)
+            emit(i, springs[i].a, springs[i].b, springs[i].restLength, springs[i].material);
+    });
+}
+
+void TetherSystem::build(const std::vector<Mass> &masses, const StructuredGrid &grid)
+{
+    buildFrom(masses, [&](auto &&emit) { grid.forEachEdge(emit); });
+}
+
+void TetherSystem::build(const std::vector<Mass> &masses, const std::vector<unsigned int> &triangles,
+                         const glm::vec2 &restSize)
+{
+    // Interior edges are seen from both triangles, the duplicate never shortens a path
+    buildFrom(masses, [&](auto &&emit) {
+        for (int t = 0; t + 2 < triangles.size(); t += 3)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                int a = triangles[t + corner];
+                int b = triangles[t + (corner + 1) % 3];
+                float restLength = glm::length((masses[b].texCoord - masses[a].texCoord) * restSize);
+                emit(t / 3, a, b, restLength, 0);
+            }
+        }
+    });
+}
+
+template <typename ForEach> void TetherSystem::buildFrom(const std::vector<Mass> &masses, ForEach &&forEach)
+{
+    const int massCount = static_cast<int>(masses.size());
+
+    // Adjacency of the rest mesh in compressed form
+    edgeStart.assign(massCount + 1, 0);
+    forEach([&](int, int a, int b, float, int) {
+        edgeStart[a + 1]++;
+        edgeStart[b + 1]++;
+    });
+    for (int m = 0; m < massCount; ++m)
+        edgeStart[m + 1] += edgeStart[m];
+
+    edges.resize(edgeStart[massCount]);
+    nearestAnchor.assign(edgeStart.begin(), edgeStart.end() - 1);
+    forEach([&](int, int a, int b, float restLength, int) {
+        edges[nearestAnchor[a]++] = {b, restLength};
+        edges[nearestAnchor[b]++] = {a, restLength};
+    });
+
+    // Dijkstra from all pins at once, every mass ends up with the pin of the shortest path
+    distance.assign(massCount, std::numeric_limits<float>::max());
+    nearestAnchor.assign(massCount, -1);
+    heap.clear();
+    for (int m = 0; m < massCount; ++m)
+    {
+        if (masses[m].fixed)
+        {
+            distance[m] = 0.0f;
+            nearestAnchor[m] = m;
+            heap.emplace_back(0.0f, m);
+        }
+    }
+
+    auto closerFirst = std::greater<std::pair<float, int>>();
+    std::make_heap(heap.begin(), heap.end(), closerFirst);
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), closerFirst);
+        auto [pathLength, m] = heap.back();
+        heap.pop_back();
+        if (pathLength > distance[m])
+            continue;
+
+        for (int e = edgeStart[m]; e < edgeStart[m + 1]; ++e)
+        {
+            auto [next, restLength] = edges[e];
+            float candidate = pathLength + restLength;
+            if (candidate < distance[next])
+            {
+                distance[next] = candidate;
+                nearestAnchor[next] = nearestAnchor[m];
+                heap.emplace_back(candidate, next);
+                std::push_heap(heap.begin(), heap.end(), closerFirst);
+            }
+        }
+    }
+
+    tethers.clear();
+    unanchored = 0;
+    for (int m = 0; m < massCount; ++m)
+    {
+        if (masses[m].fixed)
+            continue;
+
+        if (nearestAnchor[m] < 0)
+            unanchored++;
+        else
+            tethers.push_back({m, nearestAnchor[m], distance[m]});
+    }
+}
+
+void TetherSystem::project(std::vector<Mass> &masses, float slack, TaskScheduler &scheduler) const
+{
+    // Every tether moves only its own mass, anchors are pinned, so chunks never overlap
+    scheduler.parallelFor(0, static_cast<int>(tethers.size()), TETHER_GRAIN, [&](int begin, int end) {
+        for (int t = begin; t < end; ++t)
+        {
+            const Tether &tether = tethers[t];
+            Mass &mass = masses[tether.mass];
+            glm::vec3 delta = mass.position - masses[tether.anchor].position;
+            float currentLength = glm::length(delta);
+            float maxLength = tether.length * slack;
+
+            if (currentLength > maxLength)
+                mass.position -= delta * ((currentLength - maxLength) / currentLength);
+        }
+    });
+}
@@ -0,0 +1,281 @@
+#include "TileSolver.hpp"
+#include "Cloth.hpp"
+#include "Fracture.hpp"
+#include "StructuredGrid.hpp"
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Histogram resolution of the load balanced cuts
+const int CUT_BINS = 1024;
+
+int binOf(float coordinate)
+{
+    return std::clamp(static_cast<int>(coordinate * CUT_BINS), 0, CUT_BINS - 1);
+}
+
+// Bin -> slot so every slot gets about the same share of the histogram
+void cutHistogram(const std::vector<float> &histogram, int slots, std::vector<int> &slotOfBin)
+{
+    float total = 0.0f;
+    for (float value : histogram)
+        total += value;
+
+    slotOfBin.resize(histogram.size());
+    float cumulative = 0.0f;
+    for (int bin = 0; bin < histogram.size(); bin++)
+    {
+        // Middle of the bin decides, a heavy bin goes to the slot that holds most of it
+        float middle = cumulative + histogram[bin] * 0.5f;
+        slotOfBin[bin] = total > 0.0f ? std::min(static_cast<int>(middle / total * slots), slots - 1) : 0;
+        cumulative += histogram[bin];
+    }
+}
+} // namespace
+
+void TileSolver::clear()
+{
+    tiles.clear();
+}
+
+void TileSolver::build(const std::vector<Mass> &masses, const std::vector<Spring> &springs, int tileCount)
+{
+    partition(masses, tileCount, [&](auto &&emit) {
+        for (int i = 0; i < springs.size(); ++i)
+            emit(i, springs[i].a, springs[i].b, springs[i].restLength, springs[i].material);
+    });
+}
+
+void TileSolver::build(const std::vector<Mass> &masses, const StructuredGrid &grid, int tileCount)
+{
+    partition(masses, tileCount, [&](auto &&emit) { grid.forEachEdge(emit); });
+}
+
+template <typename ForEach>
+void TileSolver::partition(const std::vector<Mass> &masses, int tileCount, ForEach &&forEach)
+{
+    const int massCount = static_cast<int>(masses.size());
+    const int tilesX = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(tileCount))));
+    const int tilesY = std::max(1, tileCount / tilesX);
+
+    // A spring belongs to the tile of its first mass, the load of a mass is its springs plus its own copy
+    load.assign(massCount, 1.0f);
+    forEach([&](int, int a, int, float, int) { load[a] += 1.0f; });
+
+    // Columns over u, then rows over v inside every column
+    std::vector<float> histogram(CUT_BINS, 0.0f);
+    std::vector<int> columnOfBin;
+    for (int m = 0; m < massCount; ++m)
+        histogram[binOf(masses[m].texCoord.x)] += load[m];
+    cutHistogram(histogram, tilesX, columnOfBin);
+
+    std::vector<std::vector<float>> rowHistograms(tilesX, std::vector<float>(CUT_BINS, 0.0f));
+    for (int m = 0; m < massCount; ++m)
+        rowHistograms[columnOfBin[binOf(masses[m].texCoord.x)]][binOf(masses[m].texCoord.y)] += load[m];
+
+    std::vector<std::vector<int>> rowOfBin(tilesX);
+    for (int column = 0; column < tilesX; column++)
+        cutHistogram(rowHistograms[column], tilesY, rowOfBin[column]);
+
+    tiles.assign(tilesX * tilesY, Tile());
+    owner.resize(massCount);
+    ownedIndex.resize(massCount);
+    for (int m = 0; m < massCount; ++m)
+    {
+        int column = columnOfBin[binOf(masses[m].texCoord.x)];
+        int tile = column * tilesY + rowOfBin[column][binOf(masses[m].texCoord.y)];
+        owner[m] = tile;
+        ownedIndex[m] = static_cast<int>(tiles[tile].massIds.size());
+        tiles[tile].massIds.push_back(m);
+    }
+
+    for (Tile &tile : tiles)
+        tile.ownedCount = static_cast<int>(tile.massIds.size());
+
+    // Springs keep their global order inside a tile, endpoints still use global indices here
+    forEach([&](int id, int a, int b, float restLength, int material) {
+        tiles[owner[a]].springs.push_back({a, b, restLength, material, id});
+    });
+
+    // One batch per material, so a pass can skip a whole family
+    for (Tile &tile : tiles)
+    {
+        std::stable_sort(tile.springs.begin(), tile.springs.end(),
+                         [](const LocalSpring &lhs, const LocalSpring &rhs) { return lhs.material < rhs.material; });
+        tile.batchEnd.clear();
+        for (int i = 0; i < tile.springs.size(); i++)
+        {
+            // Materials without springs get empty batches
+            int material = tile.springs[i].material;
+            tile.batchEnd.resize(std::max<size_t>(tile.batchEnd.size(), material + 1), i);
+            tile.batchEnd[material] = i + 1;
+        }
+    }
+
+    // Local numbering, masses of other tiles become halo copies
+    stamp.assign(massCount, -1);
+    localIndex.resize(massCount);
+    for (int t = 0; t < tiles.size(); t++)
+    {
+        Tile &tile = tiles[t];
+        for (int i = 0; i < tile.ownedCount; i++)
+        {
+            stamp[tile.massIds[i]] = t;
+            localIndex[tile.massIds[i]] = i;
+        }
+
+        auto toLocal = [&](int m) {
+            if (stamp[m] != t)
+            {
+                stamp[m] = t;
+                localIndex[m] = static_cast<int>(tile.massIds.size());
+                tile.massIds.push_back(m);
+            }
+            return localIndex[m];
+        };
+
+        for (LocalSpring &spring : tile.springs)
+        {
+            spring.a = toLocal(spring.a);
+            spring.b = toLocal(spring.b);
+        }
+
+        tile.local.clear();
+        tile.local.reserve(tile.massIds.size());
+        for (int m : tile.massIds)
+            tile.local.push_back(masses[m]);
+        tile.start.resize(tile.massIds.size());
+
+        for (int j = tile.ownedCount; j < tile.massIds.size(); j++)
+        {
+            int m = tile.massIds[j];
+            tiles[owner[m]].incoming.push_back({ownedIndex[m], t, j});
+        }
+    }
+
+    for (Tile &tile : tiles)
+    {
+        std::sort(tile.incoming.begin(), tile.incoming.end(),
+                  [](const HaloLink &lhs, const HaloLink &rhs) { return lhs.owned < rhs.owned; });
+    }
+}
+
+float TileSolver::getImbalance() const
+{
+    if (tiles.empty())
+        return 1.0f;
+
+    size_t total = 0, busiest = 0;
+    for (const Tile &tile : tiles)
+    {
+        total += tile.springs.size();
+        busiest = std::max(busiest, tile.springs.size());
+    }
+    return total > 0 ? busiest * tiles.size() / static_cast<float>(total) : 1.0f;
+}
+
+void TileSolver::solveIteration(std::vector<Mass> &masses, const std::vector<SpringMaterial> &materials,
+                                const SolverPass &pass, float maxStretchRatio, FractureSystem *strainOut,
+                                bool pinned, TaskScheduler &scheduler, SolverResidual *residualOut)
+{
+    // Tiles read the shared masses and write only their own copies
+    scheduler.parallelFor(0, static_cast<int>(tiles.size()), 1, [&](int begin, int end) {
+        for (int t = begin; t < end; t++)
+        {
+            Tile &tile = tiles[t];
+            for (int i = 0; i < tile.massIds.size(); i++)
+            {
+                const Mass &mass = masses[tile.massIds[i]];
+                tile.local[i].position = mass.position;
+                tile.local[i].fixed = mass.fixed;
+                tile.start[i] = mass.position;
+            }
+
+            if (pinned && residualOut)
+                solveTile<true, true>(tile, materials, pass, maxStretchRatio, strainOut);
+            else if (pinned)
+                solveTile<true, false>(tile, materials, pass, maxStretchRatio, strainOut);
+            else if (residualOut)
+                solveTile<false, true>(tile, materials, pass, maxStretchRatio, strainOut);
+            else
+                solveTile<false, false>(tile, materials, pass, maxStretchRatio, strainOut);
+        }
+    });
+
+    if (residualOut)
+    {
+        for (const Tile &tile : tiles)
+        {
+            SolverResidual residual;
+            residual.maxViolation = tile.maxViolation;
+            residual.sumSquares = tile.sumSquares;
+            residual.count = tile.projected;
+            residualOut->merge(residual);
+        }
+    }
+
+    // Every tile writes back the masses it owns
+    scheduler.parallelFor(0, static_cast<int>(tiles.size()), 1, [&](int begin, int end) {
+        for (int t = begin; t < end; t++)
+            reconcileTile(tiles[t], masses);
+    });
+}
+
+template <bool Pinned, bool Measure>
+void TileSolver::solveTile(Tile &tile, const std::vector<SpringMaterial> &materials, const SolverPass &pass,
+                           float maxStretchRatio, FractureSystem *strainOut)
+{
+    SolverResidual residual;
+    Mass *local = tile.local.data();
+    tile.projected = 0;
+    for (int material = 0, begin = 0; material < tile.batchEnd.size(); begin = tile.batchEnd[material++])
+    {
+        const SpringMaterial &batch = materials[material];
+        if (!pass.includes(batch.family))
+            continue;
+
+        const float correction = pass.correction[static_cast<int>(batch.family)];
+        const float stiffness = batch.stiffness;
+        tile.projected += tile.batchEnd[material] - begin;
+        for (int i = begin; i < tile.batchEnd[material]; i++)
+        {
+            const LocalSpring &spring = tile.springs[i];
+            float currentLength = projectSpring<Pinned>(local[spring.a], local[spring.b], spring.restLength,
+                                                        stiffness, correction, maxStretchRatio);
+            if (strainOut)
+                strainOut->setStrain(spring.id, currentLength / spring.restLength);
+            if constexpr (Measure)
+                residual.add(currentLength / spring.restLength);
+        }
+    }
+
+    tile.maxViolation = residual.maxViolation;
+    tile.sumSquares = residual.sumSquares;
+}
+
+void TileSolver::reconcileTile(Tile &tile, std::vector<Mass> &masses) const
+{
+    for (int i = 0; i < tile.ownedCount; i++)
+        masses[tile.massIds[i]].position = tile.local[i].position;
+
+    // Boundary masses move by the average correction of the owner and every halo copy
+    for (size_t link = 0; link < tile.incoming.size();)
+    {
+        int i = tile.incoming[link].owned;
+        glm::vec3 correction = tile.local[i].position - tile.start[i];
+        int copies = 1;
+
+        for (; link < tile.incoming.size() && tile.incoming[link].owned == i; link++)
+        {
+            const Tile &other = tiles[tile.incoming[link].tile];
+            int j = tile.incoming[link].local;
+            correction += other.local[j].position - other.start[j];
+            copies++;
+        }
+
+        masses[tile.massIds[i]].position = tile.start[i] + correction / static_cast<float>(copies);
+    }
+}
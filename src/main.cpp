@@ -6,8 +6,10 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -18,9 +20,12 @@
 #include "Cloth.hpp"
 #include "ExperimentSystem.hpp"
 #include "GUI.hpp"
+#include "InputJournal.hpp"
 #include "Ray.hpp"
 #include "Shader.hpp"
+#include "ShardSimulation.hpp"
 #include "Skybox.hpp"
+#include "TaskScheduler.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -99,24 +104,108 @@ int main(int argc, char **argv)
     bool experimentMode = false;
     std::string experimentName = "";
 
-    if (argc > 1)
+    int threadCount = 0;
+    bool threadsGiven = false;
+    bool deterministic = false;
+
+    bool shardMode = false;
+    ShardSettings shardSettings;
+
+    std::string renderMeshPath;
+    std::string clothMeshPath;
+    std::string recordPath;
+    std::string replayPath;
+
+    for (int i = 1; i < argc; i++)
     {
-        std::string arg = argv[1];
+        std::string arg = argv[i];
         if (arg == "--experiment" or arg == "-e")
         {
             experimentMode = true;
-            if (argc > 2)
+            if (i + 1 < argc && argv[i + 1][0] != '-')
             {
-                experimentName = argv[2];
+                experimentName = argv[++i];
             }
         }
+        else if ((arg == "--threads" or arg == "-t") && i + 1 < argc)
+        {
+            threadCount = std::atoi(argv[++i]);
+            threadsGiven = true;
+        }
+        else if (arg == "--deterministic")
+        {
+            deterministic = true;
+        }
+        else if (arg == "--shards" && i + 1 < argc)
+        {
+            shardMode = true;
+            shardSettings.shardCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            shardSettings.frames = std::atoi(argv[++i]);
+        }
+        else if (arg == "--resolution" && i + 1 < argc)
+        {
+            shardSettings.resX = shardSettings.resY = std::atoi(argv[++i]);
+        }
+        else if (arg == "--tiled")
+        {
+            shardSettings.tiledSolver = true;
+        }
+        else if (arg == "--render-mesh" && i + 1 < argc)
+        {
+            renderMeshPath = argv[++i];
+        }
+        else if (arg == "--cloth-mesh" && i + 1 < argc)
+        {
+            clothMeshPath = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
         else if (arg == "--help" or arg == "-h")
         {
             std::cout << "help\n";
+            std::cout << "  -e, --experiment <name>  run an experiment (exp1 .. exp10, all)\n";
+            std::cout << "  -t, --threads <count>    worker threads, 0 uses every core\n";
+            std::cout << "  --deterministic          run all tasks in order on the main thread\n";
+            std::cout << "  --shards <count>         run headless, one process per strip of rows\n";
+            std::cout << "  --frames <count>         frames of a sharded run\n";
+            std::cout << "  --resolution <count>     masses per side of a sharded run\n";
+            std::cout << "  --tiled                  tiled constraint solver inside every shard\n";
+            std::cout << "  --render-mesh <file>     draw an OBJ mesh bound to the cloth instead of the grid\n";
+            std::cout << "  --cloth-mesh <file>      simulate an OBJ triangle mesh, faces of group pin are fixed\n";
+            std::cout << "  --record <file>          write every input that changes the cloth to a journal\n";
+            std::cout << "  --replay <file>          run a journal headless and report the time of every frame\n";
             return 0;
         }
     }
 
+    // Shards are forked before this process starts any scheduler thread
+    if (shardMode)
+    {
+        shardSettings.threadsPerShard = std::max(threadCount, 1);
+        ShardCoordinator coordinator(shardSettings);
+        return coordinator.run();
+    }
+
+    // Replays build their own headless scene and scheduler from the journal
+    if (!replayPath.empty())
+    {
+        JournalReplay replay(replayPath, threadsGiven ? threadCount : -1, deterministic);
+        return replay.run();
+    }
+
+    // One scheduler for the whole program, sized before anything submits work
+    TaskScheduler::instance().setThreadCount(threadCount);
+    TaskScheduler::instance().setDeterministic(deterministic);
+
     GLFWwindow *window = initializeWindow();
     if (!window)
         return -1;
@@ -131,16 +220,34 @@ int main(int argc, char **argv)
                                       "../img/skybox/bottom.jpg", "../img/skybox/front.jpg", "../img/skybox/back.jpg"};
     Skybox skybox(faces);
 
-    Cloth cloth(4.0f, 4.0f, 30, 30, -10.0f);
+    JournalSetup setup;
+    setup.clothMesh = clothMeshPath;
+    setup.threadCount = threadCount;
+    setup.deterministic = deterministic;
 
-    Cube *cube = new Cube(glm::vec3(0, -2, 0), glm::vec3(2, 2, 2), "../img/textures/krem.png");
+    Cloth cloth(setup.width, setup.height, setup.resX, setup.resY, setup.floorY);
+    if (!setup.clothMesh.empty())
+        cloth.loadClothMesh(setup.clothMesh, setup.meshImport);
+    if (!renderMeshPath.empty())
+        cloth.loadRenderMesh(renderMeshPath);
+
+    Cube *cube = new Cube(setup.cubeCenter, setup.cubeSize, "../img/textures/krem.png");
     cloth.addCollisionObject(cube);
 
+    // Opened before the experiments so a recording also covers their runs
+    InputJournal journal;
+    if (!recordPath.empty() && !journal.open(recordPath, cloth, setup))
+    {
+        delete cube;
+        glfwTerminate();
+        return -1;
+    }
+
     if (experimentMode)
     {
         std::cout << "Welcome to experiment mode\n";
 
-        ExperimentSystem experimentSystem(&cloth);
+        ExperimentSystem experimentSystem(&cloth, &journal);
 
         if (experimentName == "all")
         {
@@ -178,12 +285,22 @@ int main(int argc, char **argv)
         {
             experimentSystem.exp8_springTypes();
         }
+        else if (experimentName == "exp9")
+        {
+            experimentSystem.exp9_bendingModels();
+        }
+        else if (experimentName == "exp10")
+        {
+            experimentSystem.exp10_membraneModels();
+        }
         else
         {
             std::cout << "unknown experiment " << experimentName << "\n";
+            journal.close();
             return 1;
         }
 
+        journal.close();
         glfwTerminate();
         return 0;
     }
@@ -199,6 +316,7 @@ int main(int argc, char **argv)
     appData.lightPos = &lightPos;
     appData.cube = cube;
     appData.cubeEnabled = &cubeEnabled;
+    appData.journal = &journal;
     appData.fps = 0.0;
 
     glfwSetWindowUserPointer(window, &appData);
@@ -230,6 +348,7 @@ int main(int argc, char **argv)
 
     while (!glfwWindowShouldClose(window))
     {
+        journal.beginFrame();
         glfwPollEvents();
 
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -237,7 +356,10 @@ int main(int argc, char **argv)
         lastFrame = currentFrame;
 
         processInput(window);
-        float clampedDt = glm::min(deltaTime, 0.016f);
+        // The adaptive step splits long frames itself, the fixed step keeps the old clamp
+        const TimestepParams &timestep = cloth.getTimestepParams();
+        float clampedDt = glm::min(deltaTime, timestep.enabled ? timestep.maxFrameDt : 0.016f);
+        journal.recordStep(clampedDt);
         cloth.update(clampedDt);
         updateGrabbedMass(window);
 
@@ -308,6 +430,7 @@ int main(int argc, char **argv)
         glfwSwapBuffers(window);
     }
 
+    journal.close();
     delete cube;
     cloth.clearCollisionObjects();
     gui.shutdown();
@@ -424,6 +547,7 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
     AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
     Cloth *cloth = appData->cloth;
     Skybox *skybox = appData->skybox;
+    InputJournal *journal = appData->journal;
     ForceManager &forceManager = cloth->getForceManager();
 
     switch (key)
@@ -466,13 +590,16 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
         break;
 
     case GLFW_KEY_R:
+        journal->recordReset();
         cloth->reset();
         std::cout << "Cloth reset" << std::endl;
         break;
     case GLFW_KEY_V:
+        journal->recordOrientation(Cloth::ClothOrientation::VERTICAL);
         cloth->setOrientation(Cloth::ClothOrientation::VERTICAL);
         break;
     case GLFW_KEY_H:
+        journal->recordOrientation(Cloth::ClothOrientation::HORIZONTAL);
         cloth->setOrientation(Cloth::ClothOrientation::HORIZONTAL);
         break;
     case GLFW_KEY_M:
@@ -481,6 +608,7 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
         break;
 
     case GLFW_KEY_F:
+        journal->recordFree();
         cloth->freeCloth();
         break;
 
@@ -509,6 +637,7 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
         firstMouse = true;
         if (massSelected)
         {
+            journal->recordRelease(selectedMassIndex);
             cloth->releaseMassPoint(selectedMassIndex);
             massSelected = false;
             selectedMassIndex = -1;
@@ -697,6 +826,7 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
 
     AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
     Cloth *cloth = appData->cloth;
+    InputJournal *journal = appData->journal;
 
     if (button == GLFW_MOUSE_BUTTON_LEFT)
     {
@@ -708,6 +838,7 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
             Ray ray = createRayFromMouse(window);
             mousePressed = true;
 
+            journal->recordPick(ray);
             selectedMassIndex = cloth->pickMassPoint(ray);
             massSelected = (selectedMassIndex != -1);
 
@@ -736,6 +867,7 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
             mousePressed = false;
             if (massSelected)
             {
+                journal->recordRelease(selectedMassIndex);
                 cloth->releaseMassPoint(selectedMassIndex);
                 massSelected = false;
                 selectedMassIndex = -1;
@@ -753,6 +885,7 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
 
             Ray ray = createRayFromMouse(window);
 
+            journal->recordPick(ray);
             int clickedIndex = cloth->pickMassPoint(ray);
 
             if (clickedIndex != -1)
@@ -862,6 +995,8 @@ void updateGrabbedMass(GLFWwindow *window)
     if (massSelected)
     {
         glm::vec3 currentMouseWorldPos = getWorldPosFromRay(ray, interactionDistance);
+        selectedMassIndex = cloth->getSelectedMassIndex();
+        appData->journal->recordDrag(selectedMassIndex, currentMouseWorldPos);
         cloth->setMassPosition(selectedMassIndex, currentMouseWorldPos);
         lastMouseWorldPos = currentMouseWorldPos;
     }
@@ -871,6 +1006,7 @@ void updateGrabbedMass(GLFWwindow *window)
             glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
 
+        appData->journal->recordCut(ray, lastMouseWorldPos, view, projection, SCR_WIDTH, SCR_HEIGHT);
         cloth->cutSpringsWithRay(ray, lastMouseWorldPos, view, projection, SCR_WIDTH, SCR_HEIGHT);
 
         glm::vec3 planeNormal = glm::vec3(0.0f, 0.0f, 1.0f);